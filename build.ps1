@@ -28,6 +28,15 @@ cp -r -Force shaders Debug/
 cp -r -Force ../models Debug/
 cp -r -Force ../textures Debug/
 
+# cook textures into BC1/BC7 .ktx2 next to the pngs, the game loads those when they exist
+echo "\n---COOKING TEXTURES---\n"
+$pngs = Get-ChildItem -Recurse -Path Debug/models, Debug/textures -Filter *.png | ForEach-Object { $_.FullName }
+.\Debug\texture_cooker.exe @pngs
+
+# everything the game loads goes into one assets.pack, loose files are only the fallback
+echo "\n---PACKING ASSETS---\n"
+cmake.exe --build . --target asset_pack
+
 if ($args[0] -eq "run") {
    cd Debug
    .\orc_horde.exe
@@ -27,6 +27,14 @@ cd build
 cmake -DCMAKE_BUILD_TYPE=Debug ..
 cmake --build .
 
+# cook textures into BC1/BC7 .ktx2 next to the pngs, the game loads those when they exist
+echo "\n---COOKING TEXTURES---\n"
+./texture_cooker $(find ../models ../textures -name "*.png")
+
+# everything the game loads goes into one assets.pack, loose files are only the fallback
+echo "\n---PACKING ASSETS---\n"
+cmake --build . --target asset_pack
+
 if [ "$1" = 'run' ]; then
 	./orc_horde
 fi
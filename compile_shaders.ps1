@@ -14,7 +14,8 @@ if (-not (Test-Path -Path ".\build\shaders\")) {
 
 # TODO(caleb): replace this with a for loop over all shaders
 # in shaders directory
-glslc.exe .\shaders\triangle.vert -o .\build\shaders\triangle_vert.spv
-glslc.exe .\shaders\triangle.frag -o .\build\shaders\triangle_frag.spv
-glslc.exe .\shaders\base.vert -o .\build\shaders\base_vert.spv
-glslc.exe .\shaders\base.frag -o .\build\shaders\base_frag.spv
+glslc.exe --target-env=vulkan1.2 .\shaders\triangle.vert -o .\build\shaders\triangle_vert.spv
+glslc.exe --target-env=vulkan1.2 .\shaders\triangle.frag -o .\build\shaders\triangle_frag.spv
+glslc.exe --target-env=vulkan1.2 .\shaders\base.vert -o .\build\shaders\base_vert.spv
+glslc.exe --target-env=vulkan1.2 -DPACKED_INSTANCES .\shaders\base.vert -o .\build\shaders\base_packed_vert.spv
+glslc.exe --target-env=vulkan1.2 .\shaders\base.frag -o .\build\shaders\base_frag.spv
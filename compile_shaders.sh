@@ -19,7 +19,8 @@ fi
 
 # TODO(caleb): replace this with a for loop over all shaders
 # in shaders directory
-glslc shaders/triangle.vert -o build/shaders/triangle_vert.spv
-glslc shaders/triangle.frag -o build/shaders/triangle_frag.spv
-glslc shaders/base.vert -o build/shaders/base_vert.spv
-glslc shaders/base.frag -o build/shaders/base_frag.spv
+glslc --target-env=vulkan1.2 shaders/triangle.vert -o build/shaders/triangle_vert.spv
+glslc --target-env=vulkan1.2 shaders/triangle.frag -o build/shaders/triangle_frag.spv
+glslc --target-env=vulkan1.2 shaders/base.vert -o build/shaders/base_vert.spv
+glslc --target-env=vulkan1.2 -DPACKED_INSTANCES shaders/base.vert -o build/shaders/base_packed_vert.spv
+glslc --target-env=vulkan1.2 shaders/base.frag -o build/shaders/base_frag.spv
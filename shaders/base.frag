@@ -1,16 +1,60 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 #define MAX_TEXTURES_LOADED 1024
 
 
-layout(location=0) in vec3 fragColor;
 layout(location=1) in vec2 fragTexCoord;
 layout(location=2) flat in int  fragTexLayer;
 
 layout(location=0) out vec4 outColor;
 
+// slots nothing has been uploaded to are left unwritten (PARTIALLY_BOUND), and instances
+// in one draw can use different slots, hence the nonuniformEXT on every index
 layout(binding=1) uniform sampler2D texSampler[MAX_TEXTURES_LOADED];
 
+// see TEXTURE_INFO_* in renderer.hh: the low 8 bits are the bits per palette index
+// (0 for ordinary textures), the rest is the slot holding the palette
+layout(std430, binding=2) readonly buffer TextureInfo {
+  uint textureInfo[MAX_TEXTURES_LOADED];
+};
+
+// Palette textures store indices (two per texel in r and g for 4 bit, see TexturePalette4)
+// and are fetched from the nearest texel of the nearest mip, since blending indices is
+// meaningless. The palette is an Nx1 sRGB image so the fetch gives back linear color.
+vec4 samplePalette(int layer, uint info, vec2 uvDx, vec2 uvDy) {
+  int indexBits = int(info & 0xFFu);
+  int paletteLayer = int(info >> 8);
+  ivec2 texelsPerImageTexel = ivec2(indexBits == 4 ? 2 : 1, 1);
+
+  vec2 size = vec2(textureSize(texSampler[nonuniformEXT(layer)], 0) * texelsPerImageTexel);
+  vec2 dx = uvDx * size;
+  vec2 dy = uvDy * size;
+  float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+  int level = clamp(int(lod + 0.5), 0, textureQueryLevels(texSampler[nonuniformEXT(layer)]) - 1);
+
+  ivec2 levelSize = textureSize(texSampler[nonuniformEXT(layer)], level) * texelsPerImageTexel;
+  ivec2 texel = clamp(ivec2(fract(fragTexCoord) * vec2(levelSize)), ivec2(0), levelSize - 1);
+  vec4 indices = texelFetch(texSampler[nonuniformEXT(layer)], texel / texelsPerImageTexel, level);
+
+  uint index;
+  if (indexBits == 4) {
+	index = uint(round(((texel.x & 1) == 0 ? indices.r : indices.g) * 15.0));
+  } else {
+	index = uint(round(indices.r * 255.0));
+  }
+  return texelFetch(texSampler[nonuniformEXT(paletteLayer)], ivec2(index, 0), 0);
+}
+
 void main() {
-  outColor = texture(texSampler[fragTexLayer], fragTexCoord);
+  // derivatives before any branching
+  vec2 uvDx = dFdx(fragTexCoord);
+  vec2 uvDy = dFdy(fragTexCoord);
+
+  uint info = textureInfo[fragTexLayer];
+  if ((info & 0xFFu) == 0u) {
+	outColor = textureGrad(texSampler[nonuniformEXT(fragTexLayer)], fragTexCoord, uvDx, uvDy);
+  } else {
+	outColor = samplePalette(fragTexLayer, info, uvDx, uvDy);
+  }
 }
@@ -1,21 +1,37 @@
 #version 450
 
+// compiled twice, once with -DPACKED_INSTANCES (see PackedInstance in renderer.hh)
+
+#define INSTANCE_POSITION_RANGE 16.0
+
 layout(binding = 0) uniform UniformBufferObject {
   mat4 view;
   mat4 proj;
 } ubo;
 
 
+// see MeshConstants in renderer.hh, quantized meshes store positions as unorm16
+// within their bounds, full meshes get the identity transform
+layout(push_constant) uniform MeshConstants {
+  vec4 boundsMin;
+  vec4 boundsExtent;
+} mesh;
+
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
+#ifdef PACKED_INSTANCES
+layout(location = 3) in vec2 instPositionXY;
+layout(location = 4) in vec2 instPositionZScale;
+layout(location = 5) in uint instRotation;
+layout(location = 6) in uint instTexture;
+#else
 layout(location = 3) in vec3 instPosition;
 layout(location = 4) in vec4 instRotation;
 layout(location = 5) in float instScale;
 layout(location = 6) in int instTexture;
+#endif
 
-layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 layout(location = 2) out int fragTexLayer;
 
@@ -24,7 +40,7 @@ mat4 rotationFromQuaternion(vec3 position, vec4 quat) {
 	 float x = quat.y;
 	 float y = quat.z;
 	 float z = quat.w;
-	 
+
 	 vec4 v0 = vec4(1 - 2*(y*y + z*z), 2*(x*y + z*w), 2*(x*z - y*w), 0.0);
 	 vec4 v1 = vec4(2*(x*y - z*w), 1 - 2*(x*x + z*z), 2*(y*z + x*w), 0.0);
 	 vec4 v2 = vec4(2*(x*z + y*w), 2*(y*z - x*w), 1 - 2*(x*x + y*y), 0.0);
@@ -33,10 +49,32 @@ mat4 rotationFromQuaternion(vec3 position, vec4 quat) {
 	 return mat4(v0, v1, v2, v3);
 }
 
+#ifdef PACKED_INSTANCES
+// inverse of packQuaternion in vulkan_renderer.cpp
+vec4 unpackQuaternion(uint packed) {
+	 uint largest = packed >> 30;
+	 vec3 v = vec3((packed >> 20) & 1023u, (packed >> 10) & 1023u, packed & 1023u) / 1023.0;
+	 v = (v * 2.0 - 1.0) * 0.70710678;
+	 float l = sqrt(max(0.0, 1.0 - dot(v, v)));
+
+	 if (largest == 0u) return vec4(l, v.x, v.y, v.z);
+	 if (largest == 1u) return vec4(v.x, l, v.y, v.z);
+	 if (largest == 2u) return vec4(v.x, v.y, l, v.z);
+	 return vec4(v.x, v.y, v.z, l);
+}
+#endif
+
 void main() {
+#ifdef PACKED_INSTANCES
+  vec3 instPosition = vec3(instPositionXY * INSTANCE_POSITION_RANGE, instPositionZScale.x);
+  float instScale = instPositionZScale.y;
+  mat4 instTransform = rotationFromQuaternion(instPosition, unpackQuaternion(instRotation));
+  fragTexLayer = int(instTexture);
+#else
   mat4 instTransform = rotationFromQuaternion(instPosition, instRotation);
-  gl_Position = ubo.proj * ubo.view * instTransform * vec4(inPosition * instScale, 1.0);
-  fragColor = inColor;
-  fragTexCoord = inTexCoord;
   fragTexLayer = instTexture;
+#endif
+  vec3 position = mesh.boundsMin.xyz + inPosition * mesh.boundsExtent.xyz;
+  gl_Position = ubo.proj * ubo.view * instTransform * vec4(position * instScale, 1.0);
+  fragTexCoord = inTexCoord;
 }
@@ -24,6 +24,11 @@ Animation::Animation(skyVec3 position, skyGUID textureId, skyGUID meshId,
   type = Animation_e;
 }
 
+Animation::~Animation() {
+  texture->relinquish();
+  mesh->relinquish();
+}
+
 GameOps Animation::update(std::chrono::microseconds dt, GameState &gameState){
   timeLeft = std::chrono::duration_cast<std::chrono::milliseconds>(timeLeft - dt);
   if (timeLeft > std::chrono::milliseconds::zero()) {
@@ -9,10 +9,16 @@ SDG
 
 #pragma once
 
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
-#include "vendor/tiny_obj_loader.h"
 
+#include "asset_manifest.hh"
+#include "asset_task.hh"
 #include "containers.hh"
 
 #include "renderer.hh" // TODO: Move vertex code to separate file
@@ -37,24 +43,6 @@ struct VulkanImageInfo {
 typedef VulkanImageInfo Image_st;
 // END IFDEF
 
-// TODO: consider replacing with STL style traits class
-typedef enum {
-  Mesh_e,
-  Texture_e,
-  Sound_e,
-  Video_e,
-  Bytecode_e,
-  Other_e,
-} AssetType;
-
-typedef enum {
-  File_e,
-  Network_e,
-  Computed_e,
-} AssetLocationType;
-
-typedef std::string skyGUID;
-typedef std::string AssetLocation;
 typedef size_t AssetSize;
 
 
@@ -63,113 +51,123 @@ typedef int LOD;
 class Asset;
 class Mesh;
 class Texture;
-
-const AssetLocation HOUSE_PATH = "./models/viking_room/viking_room.obj";
-const skyGUID HOUSE_GUID = "viking_room1234";
-
-const AssetLocation HOUSE_TEXTURE_PATH = "./models/viking_room/viking_room.png";
-const skyGUID HOUSE_TEXTURE_GUID = "viking_room1234_tex";
-
-const AssetLocation ORC_PATH = "./models/orc_low_poly/orc_low_poly.obj";
-const skyGUID ORC_GUID = "orc_low_poly";
-
-const AssetLocation ORC_TEXTURE_PATH = "./models/orc_low_poly/orc_low_poly.png";
-const skyGUID ORC_TEXTURE_GUID = "orc_low_poly_tex";
-
-const AssetLocation HUMAN_PATH = "./models/human_low_poly/human_low_poly.obj";
-const skyGUID HUMAN_GUID = "human_low_poly";
-
-const AssetLocation HUMAN_TEXTURE_PATH = "./models/human_low_poly/human_low_poly.png";
-const skyGUID HUMAN_TEXTURE_GUID = "human_low_poly_tex";
-
-const AssetLocation MAP_TEXTURE_PATH = "./textures/base_map.png";
-const skyGUID MAP_TEXTURE_GUID = "base_map_tex";
-
-const skyGUID DECORATOR_GUID = "DECORATOR_PANEL";
-
-const AssetLocation BULLET_TEXTURE_PATH_SUPER   = "./models/bullet/bullet_super.png";
-const skyGUID BULLET_TEXTURE_GUID_SUPER   = "bullet_texture_guid_super";
-
-const AssetLocation BULLET_TEXTURE_PATH_REGULAR = "./models/bullet/bullet_regular.png";
-const skyGUID BULLET_TEXTURE_GUID_REGULAR = "bullet_texture_guid_regular"; 
-
-const AssetLocation BULLET_MESH_PATH_SUPER = "./models/bullet/bullet.obj";
-const skyGUID BULLET_MESH_GUID_SUPER      = "bullet_mesh_guid_super";  
-
-const AssetLocation BULLET_MESH_PATH_REGULAR = "./models/bullet/bullet.obj";
-const skyGUID BULLET_MESH_GUID_REGULAR    = "bullet_mesh_guid_regular";  // NOTE: these are the same
-
-const AssetLocation EXPLOSION_PATH = "./models/explosion/explosion_regular.obj";
-const skyGUID EXPLOSION_GUID = "EXPLOSION";
-
-const AssetLocation SUPER_EXPLOSION_PATH = "./models/explosion/explosion_super.obj";
-const skyGUID SUPER_EXPLOSION_GUID = "SUPER_EXPLOSION";
-
-const AssetLocation EXPLOSION_TEXTURE_PATH = "./models/explosion/explosion_regular.png";
-const skyGUID EXPLOSION_TEXTURE_GUID = "EXPLOSION_TEX";
-
-const AssetLocation SUPER_EXPLOSION_TEXTURE_PATH = "./models/explosion/explosion_super.png";
-const skyGUID SUPER_EXPLOSION_TEXTURE_GUID = "SUPER_EXPLOSION_TEX";
-
-const AssetLocation HUMAN_DEAD_PATH = "./models/human_low_poly/human_low_poly.obj";
-const skyGUID HUMAN_DEAD_GUID = "HUMAN_DEAD"; // NOTE: these are the same
-
-const AssetLocation HUMAN_DEAD_TEXTURE_PATH = "./models/human_low_poly/death_low_poly.png";
-const skyGUID HUMAN_DEAD_TEXTURE_GUID = "HUMAN_DEAD_TEXTURE"; 
-
-const std::vector<skyGUID> ALL_GAME_ASSETS {
-  HOUSE_GUID,
-  HOUSE_TEXTURE_GUID,
-  ORC_GUID,
-  ORC_TEXTURE_GUID,
-  HUMAN_GUID,
-  HUMAN_TEXTURE_GUID,
-  MAP_TEXTURE_GUID,
-  DECORATOR_GUID,
-  BULLET_TEXTURE_GUID_SUPER,
-  BULLET_TEXTURE_GUID_REGULAR,
-  BULLET_MESH_GUID_SUPER,
-  BULLET_MESH_GUID_REGULAR,
-  EXPLOSION_GUID,
-  SUPER_EXPLOSION_GUID,
-  EXPLOSION_TEXTURE_GUID,
-  SUPER_EXPLOSION_TEXTURE_GUID,
-  HUMAN_DEAD_GUID,
-  HUMAN_DEAD_TEXTURE_GUID,
-}; // to be passed to load
-// NOTE: while you could write a function to do all this, I don't want
-// the asset store to work that way. The idea is that you'd be able to
-// load various zones. This is just a lazy version for initial implementation.
+template <typename T> struct AssetLoad;
 
   
 /* ========================== Asset Storage ==========================*/
 struct AssetInfo {
   AssetType type;
   AssetLocationType locationType;
-  AssetSize assetSize;
+  AssetSize assetSize;	 // cpu + gpu bytes while loaded, refreshed every frame by evictUnused
   AssetLocation assetLocation;
   Asset *asset;
+  int claims = 0;		 // getMesh/getTexture calls not yet relinquished
+  uint64_t releasedOnFrame = 0; // when claims last dropped to 0, for LRU eviction
+  skyGUID sharedWith;	 // set if asset belongs to another guid (same file or contents),
+						 // claims and sizes are all kept on that guid's info
+};
+
+// lets AssetDB::find take a skyGUIDView without making a string out of it
+struct AssetGUIDHash {
+  using is_transparent = void;
+  size_t operator()(skyGUIDView guid) const { return std::hash<skyGUIDView>{}(guid); }
 };
 
-typedef std::unordered_map<skyGUID, AssetInfo> AssetDB;
+typedef std::unordered_map<skyGUID, AssetInfo, AssetGUIDHash, std::equal_to<>> AssetDB;
+
+// getMesh/getTexture hand out a claim right away and stream the asset in if it isn't loaded,
+// every claim has to be given back with relinquish. Assets nobody claims stay loaded as a
+// cache until the budgets in RendererConfig are exceeded, then they're evicted least recently
+// released first.
+const double ASSET_UPLOAD_BUDGET_MS = 4.0; // per frame, uploadPrefetched always does at least one
 
 class AssetStore {
 public:
   AssetStore(Renderer &renderer);
-  bool  		    		load(skyGUID guid);
+  ~AssetStore();
+  void						addAsset(skyGUID guid, AssetType type, AssetLocationType locationType,
+									 AssetLocation location); // anything not in ASSET_MANIFEST
+  bool  		    		load(skyGUIDView guid); // synchronous
   bool						load(std::vector<skyGUID> guids);
-  Asset * 					get(skyGUID guid);
-  Texture *					getTexture(skyGUID guid); // TODO(caleb): fix this (odin casing instead of C++)
-  Mesh *					getMesh(skyGUID guid);
-  int 						relinquish(skyGUID guid); // returns number of other claims on asset
-  void						unload(skyGUID guid);
-  void						forceUnload(skyGUID guid);
-  AssetLocation 			getLocation(skyGUID guid); // SUBJECT TO CHANGES
-  AssetLocationType			getLocationType(skyGUID guid); // subject to changes
+  Asset * 					get(skyGUIDView guid); // doesn't claim
+  Texture *					getTexture(skyGUIDView guid); // TODO(caleb): fix this (odin casing instead of C++)
+  Mesh *					getMesh(skyGUIDView guid);
+  AssetLoad<Asset>			loadAsync(skyGUIDView guid); // claims now, co_await it for the asset once it's uploaded
+  AssetLoad<Texture>		loadTextureAsync(skyGUIDView guid);
+  AssetLoad<Mesh>			loadMeshAsync(skyGUIDView guid);
+  int 						relinquish(skyGUIDView guid); // returns number of other claims on asset
+  void						unload(skyGUIDView guid);	  // only if nobody has a claim on it
+  void						forceUnload(skyGUIDView guid); // claims or not, nothing may draw it afterwards
+  void						unloadAll(); // before Renderer::cleanup, also stops the loader thread
+									 // and drops AssetTasks still waiting
+  void						enterZone(const ZoneManifest &zone); // claims zone, gives back the previous one
+  void						prefetchZone(const ZoneManifest &zone); // reads zone on the loader thread
+  size_t					residentCount(const ZoneManifest &zone); // assets of zone that are loaded
+  bool						isResident(const ZoneManifest &zone);
+  AssetLocation 			getLocation(skyGUIDView guid); // SUBJECT TO CHANGES
+  AssetLocationType			getLocationType(skyGUIDView guid); // subject to changes
+  void						update(const RenderState &renderState); // once per frame, after display
+  VkDeviceSize				getResidentTextureBytes();
 
 private:
-  AssetDB			        assetDb;
+  std::array<AssetInfo, ASSET_MANIFEST_SIZE>	manifestAssets; // same order as ASSET_MANIFEST
+  AssetDB			        assetDb;	  // only the ones from addAsset
+  std::mutex				assetDbMutex; // addAsset can run while the loader thread looks one up
   Renderer & 				renderer;
+  uint64_t					frame = 0;
+  VkDeviceSize				residentTextureBytes = 0;
+  std::unordered_map<std::string, skyGUID>	assetsByPath;	 // type and normalized path -> owner
+  std::unordered_multimap<uint64_t, skyGUID>	assetsByContent; // type and file hash -> owners, see sameAssetBytes
+  std::unordered_map<std::string, uint64_t>	fileHashes;		 // type and normalized path -> hash the loader thread took
+  const ZoneManifest *		zone = nullptr;
+  void						updateTextureStreaming(const RenderState &renderState);
+  void						evictUnused();
+  AssetInfo &				lookup(skyGUIDView guid); // throws std::out_of_range for unknown guids
+  AssetInfo &				ownerInfo(skyGUIDView guid);
+  std::string				pathKey(const AssetInfo &info);
+  void						unloadInfo(AssetInfo &info);
+  Asset *					findOrCreate(skyGUIDView guid);
+  Asset *					claim(skyGUIDView guid);
+  template <typename Fn> void	forEachInfo(Fn fn) {
+	for (AssetInfo &info : manifestAssets) fn(info);
+	for (auto &[guid, info] : assetDb) fn(info);
+  }
+
+  // the loader thread only ever calls Asset::prefetch, everything touching the GPU
+  // stays on the main thread, see uploadPrefetched
+  std::thread				loaderThread;
+  std::mutex				loaderMutex;
+  std::condition_variable	loaderWake;
+  std::deque<Asset *>		prefetchQueue; // main -> loader
+  std::deque<Asset *>		prefetched;	   // loader -> main, waiting to be uploaded
+  bool						loaderQuit = false;
+  void						loaderMain();
+  void						stopLoader();
+  void						uploadPrefetched();
+  void						queueLoad(Asset *asset);
+  void						fail(Asset *asset, const std::string &why);
+  size_t					failedAssets = 0;
+
+  // new loose files of a prefetched zone get their content hash (see findOrCreate) on the
+  // loader thread too, their asset is only created once it's back
+  struct HashedFile {
+	skyGUID					guid;
+	bool					found;
+	uint64_t				hash;
+  };
+  std::deque<skyGUID>		hashQueue; // main -> loader
+  std::deque<HashedFile>	hashed;	   // loader -> main, see createHashed
+  void						queueHash(skyGUIDView guid);
+  void						createHashed();
+
+  // coroutines co_awaiting an AssetLoad, resumed by update once their asset is loaded
+  struct AssetWaiter {
+	Asset *					asset;
+	std::coroutine_handle<>	handle;
+  };
+  std::vector<AssetWaiter>	waiters;
+  void						resumeWaiters();
+  template <typename T> friend struct AssetLoad;
 };
 
 
@@ -183,62 +181,125 @@ public:
   // copying all that data around
   
   skyGUID 					guid;
-  virtual bool 			load() = 0;   // TODO: maybe this doesn't need to be virtual
-  virtual void			unload() = 0; // TODO: maybe this doesn't have to be virtual either
+  bool 					load();		// main thread only, waits if the loader thread is reading this asset
+  bool					prefetch();	// just the cpu side of load (files, decoding), fine on any thread
+  void					unload();
+  virtual AssetSize		cpuSize() = 0; // bytes currently held, 0 when not loaded
+  virtual AssetSize		gpuSize() = 0;
+  int					relinquish(); // gives back a claim from AssetStore::getMesh/getTexture
   int					generation = 0; 
   friend class AssetStore;
+  template <typename T> friend struct AssetLoad;
 protected:
+  virtual bool			prepare() = 0; // cpu side, must not touch the renderer's queue
+  virtual void			upload() = 0;  // gpu side, uses up whatever prepare left behind
+  virtual void			release() = 0; // gpu side of unload
   bool 					loaded;
+  bool					prepared = false; // prepare has run but upload hasn't yet
+  std::mutex			stateMutex;		  // guards loaded and prepared against the loader thread
+  bool					queued = false;	  // somewhere between AssetStore::queueLoad and the upload,
+										  // guarded by AssetStore::loaderMutex
+  bool					failed = false;	  // loading it threw, so it keeps drawing with the placeholder
+										  // and isn't tried again (main thread only, see AssetStore::fail)
+  std::string			failure;		  // what the loader thread's prefetch threw, read once it's in prefetched
   AssetStore & 			assetStore;
   Renderer & 			renderer;
 };
 
 
-// TODO: For loading LOD's, the most common use case will probably be loading
-// the higher LOD's as you get closer to an object
-// Is the best way to just a pointer to each individual LOD, or to copy them
-// over into a graphics driver compatible, mipmapped single buffer each time
-// a new LOD is requested.
-// or maybe we store a separete LOD object of texture and asset pairings?
+// Texture LODs are mip levels, 0 being the full size image. The whole chain is kept
+// on the CPU and the GPU image only holds the levels from residentMip down, so
+// streaming a level in or out means building a new image for the same slot.
+// Palette textures (flat colored art, see buildPaletteTexture) get a second slot holding
+// their palette as an Nx1 image, base.frag looks it up through the renderer's texture info.
+const uint32_t TEXTURE_STREAM_BASE_SIZE = 128; // mips this size and smaller are always resident
+
 class Texture : public Asset {
 public:
   //  ~Texture();
-  bool              load();
-  void				unload();
-  void              loadLOD(LOD lod);
-  void              loadLOD(LOD lod[]);
-  void              unloadLOD(LOD lod);
-  void              unloadLOD(LOD lod[]);
+  AssetSize			cpuSize();
+  AssetSize			gpuSize();
+  void              loadLOD(LOD lod);   // make lod the finest resident mip (can also drop mips)
+  void              unloadLOD(LOD lod); // drop lod and every finer mip
   uint32_t			getLayerOffset();
   friend class AssetStore;
 private:
   Texture(skyGUID guid, AssetStore &assetStore, Renderer &renderer);
-  std::vector<LOD>	lod;
-  Image_st			image;
+  bool						prepare();
+  void						upload();
+  void						release();
+  std::vector<TextureMip>	mips;
+  TextureFormat				format = TextureRGBA8;
+  std::vector<uint8_t>		palette;	  // RGBA8, empty unless format is a palette format
+  Image_st					paletteImage;
+  uint32_t					residentMip = 0;
+  uint32_t					wantedMip = 0;
+  uint64_t					lastUsedFrame = 0;
+  VkDeviceSize				residentBytes = 0;
+  Image_st					image;
+  uint32_t					baseMip();
+  uint32_t					mipForScreenSize(float pixels);
+  VkDeviceSize				chainBytes(uint32_t firstMip);
+  void						decodeSource(const std::string &texturePath);
+};
+
+// Every level shares the mesh's vertex buffer and only has its own index buffer.
+// Level 0 is the full mesh, each following level has roughly half the triangles.
+const size_t MESH_MAX_LODS = 4;
+const float MESH_LOD_MIN_REDUCTION = 0.9f; // stop the chain once a level saves less than 10%
+const float LOD_ERROR_PIXELS = 1.0f;	   // largest simplification error allowed on screen
+
+struct MeshLOD {
+  std::vector<Index>		indices; // kept around so the level can be uploaded again
+  IndexBuffer_st			indices_st;
+  float						error = 0.0f; // object space distance, see simplifyMesh()
+  bool						loaded = false;
 };
 
-// same questions apply, except here we have the additional question of 
-// are we passing multiple separate LOD buffers to the thing or what?
-// I'm sure i'll figure it out as we get into actually building the game
 class Mesh : public Asset {
 public:
   //~Mesh();
 
-  bool              		load();
-  void						load(LOD lod);
-  void						unload();
-  void						unload(LOD lod);
+  using Asset::load;
+  using Asset::unload;
+  void						load(LOD level);
+  void						unload(LOD level);
+  AssetSize					cpuSize();
+  AssetSize					gpuSize();
   void 						display(RenderState &renderState, Instance &thisInstance);
   friend class AssetStore;
   
 private:
   Mesh(skyGUID guid, AssetStore &assetStore, Renderer &renderer);
-  std::vector<LOD>			lod;
+  std::vector<MeshLOD>		lod;
   VertexBuffer_st			vertices_st;
-  IndexBuffer_st			indices_st;
-  bool						loadFromFile();
-  bool						loadComputed();
+  VkIndexType				indexType = VK_INDEX_TYPE_UINT32;
+  MeshConstants				meshConstants;
+  float						radius = 0.0f; // bounding sphere around the origin
+  std::vector<Vertex>		pendingVertices; // from prepare, freed again by upload
+  bool						prepare();
+  void						upload();
+  void						release();
+  bool						prepareFromFile();
+  bool						prepareComputed();
+  void						optimize(std::vector<Vertex> &vertices, std::vector<Index> &indices);
+  LOD						selectLOD(const Camera &camera, const Instance &instance);
 };
 
-
-
+/* ========================== Async Loads ==========================*/
+
+// What AssetStore::loadAsync hands back. The claim is taken when it's created, so the
+// load is already on its way before anything co_awaits it, and co_await gives back the
+// claimed asset (relinquish it like one from getMesh/getTexture). Already loaded assets
+// don't suspend at all.
+template <typename T>
+struct AssetLoad {
+  AssetStore &				assetStore;
+  T *						asset;
+
+  bool await_ready() { return asset->loaded || asset->failed; } // failed ones draw with the placeholder
+  void await_suspend(std::coroutine_handle<> handle) {
+	assetStore.waiters.push_back(AssetStore::AssetWaiter{ .asset = asset, .handle = handle });
+  }
+  T *await_resume() { return asset; }
+};
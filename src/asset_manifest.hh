@@ -0,0 +1,250 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+								   Asset Manifest
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// NOTE: everything in here is constexpr, so none of it runs (or allocates) during static
+// initialization. AssetStore builds its AssetInfos from ASSET_MANIFEST when it's created.
+
+// TODO: consider replacing with STL style traits class
+typedef enum {
+  Mesh_e,
+  Texture_e,
+  Sound_e,
+  Video_e,
+  Bytecode_e,
+  Other_e,
+} AssetType;
+
+typedef enum {
+  File_e,
+  Network_e,
+  Computed_e,
+} AssetLocationType;
+
+typedef std::string skyGUID;
+typedef std::string_view skyGUIDView; // for lookups, converts from skyGUID and the constants below
+typedef std::string AssetLocation;
+
+constexpr char HOUSE_PATH[] = "./models/viking_room/viking_room.obj";
+constexpr char HOUSE_GUID[] = "viking_room1234";
+
+constexpr char HOUSE_TEXTURE_PATH[] = "./models/viking_room/viking_room.png";
+constexpr char HOUSE_TEXTURE_GUID[] = "viking_room1234_tex";
+
+constexpr char ORC_PATH[] = "./models/orc_low_poly/orc_low_poly.obj";
+constexpr char ORC_GUID[] = "orc_low_poly";
+
+constexpr char ORC_TEXTURE_PATH[] = "./models/orc_low_poly/orc_low_poly.png";
+constexpr char ORC_TEXTURE_GUID[] = "orc_low_poly_tex";
+
+constexpr char HUMAN_PATH[] = "./models/human_low_poly/human_low_poly.obj";
+constexpr char HUMAN_GUID[] = "human_low_poly";
+
+constexpr char HUMAN_TEXTURE_PATH[] = "./models/human_low_poly/human_low_poly.png";
+constexpr char HUMAN_TEXTURE_GUID[] = "human_low_poly_tex";
+
+constexpr char MAP_TEXTURE_PATH[] = "./textures/base_map.png";
+constexpr char MAP_TEXTURE_GUID[] = "base_map_tex";
+
+constexpr char DECORATOR_GUID[] = "DECORATOR_PANEL";
+
+constexpr char BULLET_TEXTURE_PATH_SUPER[]   = "./models/bullet/bullet_super.png";
+constexpr char BULLET_TEXTURE_GUID_SUPER[]   = "bullet_texture_guid_super";
+
+constexpr char BULLET_TEXTURE_PATH_REGULAR[] = "./models/bullet/bullet_regular.png";
+constexpr char BULLET_TEXTURE_GUID_REGULAR[] = "bullet_texture_guid_regular";
+
+constexpr char BULLET_MESH_PATH_SUPER[] = "./models/bullet/bullet.obj";
+constexpr char BULLET_MESH_GUID_SUPER[]      = "bullet_mesh_guid_super";
+
+constexpr char BULLET_MESH_PATH_REGULAR[] = "./models/bullet/bullet.obj";
+constexpr char BULLET_MESH_GUID_REGULAR[]    = "bullet_mesh_guid_regular";  // NOTE: these are the same
+
+constexpr char EXPLOSION_PATH[] = "./models/explosion/explosion_regular.obj";
+constexpr char EXPLOSION_GUID[] = "EXPLOSION";
+
+constexpr char SUPER_EXPLOSION_PATH[] = "./models/explosion/explosion_super.obj";
+constexpr char SUPER_EXPLOSION_GUID[] = "SUPER_EXPLOSION";
+
+constexpr char EXPLOSION_TEXTURE_PATH[] = "./models/explosion/explosion_regular.png";
+constexpr char EXPLOSION_TEXTURE_GUID[] = "EXPLOSION_TEX";
+
+constexpr char SUPER_EXPLOSION_TEXTURE_PATH[] = "./models/explosion/explosion_super.png";
+constexpr char SUPER_EXPLOSION_TEXTURE_GUID[] = "SUPER_EXPLOSION_TEX";
+
+constexpr char HUMAN_DEAD_PATH[] = "./models/human_low_poly/human_low_poly.obj";
+constexpr char HUMAN_DEAD_GUID[] = "HUMAN_DEAD"; // NOTE: these are the same
+
+constexpr char HUMAN_DEAD_TEXTURE_PATH[] = "./models/human_low_poly/death_low_poly.png";
+constexpr char HUMAN_DEAD_TEXTURE_GUID[] = "HUMAN_DEAD_TEXTURE";
+
+/* ========================== Built In Assets ==========================*/
+
+struct AssetManifestEntry {
+  skyGUIDView				guid;
+  AssetType					type;
+  AssetLocationType			locationType;
+  std::string_view			location; // empty for computed assets
+};
+
+// every asset the game ships with, AssetStore::addAsset is for anything else
+constexpr AssetManifestEntry ASSET_MANIFEST[] {
+  { HOUSE_GUID,						Mesh_e,		File_e,		HOUSE_PATH },
+  { HOUSE_TEXTURE_GUID,				Texture_e,	File_e,		HOUSE_TEXTURE_PATH },
+  { ORC_GUID,						Mesh_e,		File_e,		ORC_PATH },
+  { ORC_TEXTURE_GUID,				Texture_e,	File_e,		ORC_TEXTURE_PATH },
+  { MAP_TEXTURE_GUID,				Texture_e,	File_e,		MAP_TEXTURE_PATH },
+  { DECORATOR_GUID,					Mesh_e,		Computed_e,	"" }, // TODO(caleb): add a way to get a computed value here
+  { HUMAN_GUID,						Mesh_e,		File_e,		HUMAN_PATH },
+  { HUMAN_TEXTURE_GUID,				Texture_e,	File_e,		HUMAN_TEXTURE_PATH },
+  { BULLET_MESH_GUID_REGULAR,		Mesh_e,		File_e,		BULLET_MESH_PATH_REGULAR },
+  { BULLET_TEXTURE_GUID_REGULAR,	Texture_e,	File_e,		BULLET_TEXTURE_PATH_REGULAR },
+  { BULLET_MESH_GUID_SUPER,			Mesh_e,		File_e,		BULLET_MESH_PATH_SUPER },
+  { BULLET_TEXTURE_GUID_SUPER,		Texture_e,	File_e,		BULLET_TEXTURE_PATH_SUPER },
+  { EXPLOSION_GUID,					Mesh_e,		File_e,		EXPLOSION_PATH },
+  { EXPLOSION_TEXTURE_GUID,			Texture_e,	File_e,		EXPLOSION_TEXTURE_PATH },
+  { SUPER_EXPLOSION_GUID,			Mesh_e,		File_e,		SUPER_EXPLOSION_PATH },
+  { SUPER_EXPLOSION_TEXTURE_GUID,	Texture_e,	File_e,		SUPER_EXPLOSION_TEXTURE_PATH },
+  { HUMAN_DEAD_GUID,				Mesh_e,		File_e,		HUMAN_DEAD_PATH },
+  { HUMAN_DEAD_TEXTURE_GUID,		Texture_e,	File_e,		HUMAN_DEAD_TEXTURE_PATH },
+};
+
+constexpr size_t ASSET_MANIFEST_SIZE = std::size(ASSET_MANIFEST);
+
+// Perfect hash from guid to manifest index: the seed is searched for at compile time so
+// that no two manifest guids land in the same slot. Any other string still hashes to some
+// slot, so findManifestAsset compares the guid it finds there.
+constexpr size_t ASSET_MANIFEST_SLOTS = 64; // power of two, at least twice the entries so the search ends quickly
+constexpr uint8_t ASSET_MANIFEST_EMPTY_SLOT = 0xFF;
+static_assert(ASSET_MANIFEST_SIZE * 2 <= ASSET_MANIFEST_SLOTS && ASSET_MANIFEST_SIZE < ASSET_MANIFEST_EMPTY_SLOT);
+
+// FNV-1a with the seed folded into the offset basis, then xorshifted so the low bits
+// (the only ones the slot uses) depend on every character
+constexpr uint32_t hashManifestGUID(skyGUIDView guid, uint32_t seed) {
+  uint32_t hash = 2166136261u ^ seed;
+  for (char c : guid) {
+	hash ^= static_cast<uint8_t>(c);
+	hash *= 16777619u;
+  }
+  return hash ^ (hash >> 15);
+}
+
+consteval uint32_t findManifestSeed() {
+  for (uint32_t seed = 0; seed < 1u << 20; seed++) {
+	std::array<bool, ASSET_MANIFEST_SLOTS> used {};
+	bool collided = false;
+	for (const AssetManifestEntry &entry : ASSET_MANIFEST) {
+	  size_t slot = hashManifestGUID(entry.guid, seed) & (ASSET_MANIFEST_SLOTS - 1);
+	  collided = used[slot];
+	  if (collided) break;
+	  used[slot] = true;
+	}
+	if (!collided) return seed;
+  }
+  throw std::logic_error("no perfect hash seed for ASSET_MANIFEST, is a guid in it twice?");
+}
+
+constexpr uint32_t ASSET_MANIFEST_SEED = findManifestSeed();
+
+consteval std::array<uint8_t, ASSET_MANIFEST_SLOTS> buildManifestSlots() {
+  std::array<uint8_t, ASSET_MANIFEST_SLOTS> slots {};
+  slots.fill(ASSET_MANIFEST_EMPTY_SLOT);
+  for (size_t i = 0; i < ASSET_MANIFEST_SIZE; i++) {
+	slots[hashManifestGUID(ASSET_MANIFEST[i].guid, ASSET_MANIFEST_SEED) & (ASSET_MANIFEST_SLOTS - 1)] =
+	  static_cast<uint8_t>(i);
+  }
+  return slots;
+}
+
+constexpr std::array<uint8_t, ASSET_MANIFEST_SLOTS> ASSET_MANIFEST_SLOT_TABLE = buildManifestSlots();
+
+// index into ASSET_MANIFEST, -1 if guid isn't a built in asset
+constexpr int findManifestAsset(skyGUIDView guid) {
+  uint8_t index = ASSET_MANIFEST_SLOT_TABLE[hashManifestGUID(guid, ASSET_MANIFEST_SEED) & (ASSET_MANIFEST_SLOTS - 1)];
+  if (index == ASSET_MANIFEST_EMPTY_SLOT || ASSET_MANIFEST[index].guid != guid) return -1;
+  return index;
+}
+
+// every entry is found at its own index, whatever order the manifest is in
+consteval bool manifestFindsEveryEntry() {
+  for (size_t i = 0; i < ASSET_MANIFEST_SIZE; i++) {
+	if (findManifestAsset(ASSET_MANIFEST[i].guid) != static_cast<int>(i)) return false;
+  }
+  return true;
+}
+
+static_assert(manifestFindsEveryEntry());
+static_assert(findManifestAsset("not_an_asset") == -1);
+
+/* =============================== Zones =============================== */
+
+// A zone lists every asset it needs. AssetStore::enterZone claims them for as long as we're
+// in the zone and gives the previous zone's back, prefetchZone reads the next one's files on
+// the loader thread ahead of time so the transition itself is just a few uploads.
+// Until a zone isResident its objects draw with placeholders (see AssetStore::claim).
+struct ZoneManifest {
+  const char *					name;
+  std::span<const skyGUIDView>	assets;
+};
+
+constexpr skyGUIDView FIELD_ZONE_ASSETS[] {
+  MAP_TEXTURE_GUID,
+  DECORATOR_GUID,
+  ORC_GUID,
+  ORC_TEXTURE_GUID,
+  HUMAN_GUID,
+  HUMAN_TEXTURE_GUID,
+  HUMAN_DEAD_GUID,
+  HUMAN_DEAD_TEXTURE_GUID,
+  BULLET_TEXTURE_GUID_SUPER,
+  BULLET_TEXTURE_GUID_REGULAR,
+  BULLET_MESH_GUID_SUPER,
+  BULLET_MESH_GUID_REGULAR,
+  EXPLOSION_GUID,
+  SUPER_EXPLOSION_GUID,
+  EXPLOSION_TEXTURE_GUID,
+  SUPER_EXPLOSION_TEXTURE_GUID,
+};
+
+constexpr skyGUIDView VILLAGE_ZONE_ASSETS[] {
+  MAP_TEXTURE_GUID,
+  DECORATOR_GUID,
+  HOUSE_GUID,
+  HOUSE_TEXTURE_GUID,
+  HUMAN_GUID,
+  HUMAN_TEXTURE_GUID,
+  HUMAN_DEAD_GUID,
+  HUMAN_DEAD_TEXTURE_GUID,
+};
+
+constexpr ZoneManifest FIELD_ZONE { .name = "field", .assets = FIELD_ZONE_ASSETS };
+constexpr ZoneManifest VILLAGE_ZONE { .name = "village", .assets = VILLAGE_ZONE_ASSETS };
+
+constexpr std::array<ZoneManifest, 2> ZONES { FIELD_ZONE, VILLAGE_ZONE }; // in the order they're visited
+
+// so a typo in a zone's list fails to compile instead of throwing on the way into the zone
+consteval bool zonesOnlyListManifestAssets() {
+  for (const ZoneManifest &zone : ZONES) {
+	for (skyGUIDView guid : zone.assets) {
+	  if (findManifestAsset(guid) < 0) return false;
+	}
+  }
+  return true;
+}
+
+static_assert(zonesOnlyListManifestAssets(), "a zone lists a guid that isn't in ASSET_MANIFEST");
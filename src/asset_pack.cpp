@@ -0,0 +1,331 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+									 Asset Pack
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "asset_pack.hh"
+
+/* ================================ Mapping ================================ */
+
+AssetPack::~AssetPack() {
+  close();
+}
+
+bool AssetPack::open(const std::string &path) {
+  close();
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+							OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+
+  LARGE_INTEGER fileSize;
+  HANDLE fileMapping = nullptr;
+  if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+	fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  }
+  if (fileMapping == nullptr) {
+	CloseHandle(file);
+	throw std::runtime_error("failed to map asset pack " + path);
+  }
+  fileHandle = file;
+  mappingHandle = fileMapping;
+  mapping = static_cast<const uint8_t *>(MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0));
+  mappingSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+  int file = ::open(path.c_str(), O_RDONLY);
+  if (file < 0) return false;
+
+  struct stat fileStat;
+  void *view = MAP_FAILED;
+  if (fstat(file, &fileStat) == 0 && fileStat.st_size > 0) {
+	view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+  }
+  ::close(file); // the mapping keeps the file alive
+  if (view != MAP_FAILED) {
+	mapping = static_cast<const uint8_t *>(view);
+	mappingSize = static_cast<size_t>(fileStat.st_size);
+  }
+#endif
+
+  if (mapping == nullptr) {
+	close();
+	throw std::runtime_error("failed to map asset pack " + path);
+  }
+
+  AssetPackHeader header;
+  if (mappingSize < sizeof(header)) {
+	close();
+	throw std::runtime_error("truncated asset pack " + path);
+  }
+  std::memcpy(&header, mapping, sizeof(header));
+
+  uint64_t indexEnd = sizeof(header) + static_cast<uint64_t>(header.entryCount) * sizeof(AssetPackEntry);
+  if (std::memcmp(header.magic, ASSET_PACK_MAGIC, sizeof(ASSET_PACK_MAGIC)) != 0 ||
+	  header.version != ASSET_PACK_VERSION || indexEnd > mappingSize ||
+	  header.namesOffset < indexEnd || header.namesOffset > mappingSize ||
+	  header.namesSize > mappingSize - header.namesOffset) {
+	close();
+	throw std::runtime_error("bad or outdated asset pack " + path);
+  }
+
+  // the header is a multiple of 8 bytes and the mapping is page aligned, so the index can be used in place
+  entries = reinterpret_cast<const AssetPackEntry *>(mapping + sizeof(header));
+  entryCount = header.entryCount;
+  names = reinterpret_cast<const char *>(mapping + header.namesOffset);
+
+  // written so none of the checks can overflow, and rawSize is checked here since read()
+  // allocates it before the LZ4 block gets a chance to prove itself
+  for (uint32_t i = 0; i < entryCount; i++) {
+	const AssetPackEntry &entry = entries[i];
+	if (entry.offset > mappingSize || entry.size > mappingSize - entry.offset ||
+		static_cast<uint64_t>(entry.nameOffset) + entry.nameSize > header.namesSize ||
+		(entry.compression == AssetPackStored && entry.size != entry.rawSize) ||
+		(entry.compression == AssetPackLZ4 &&
+		 (entry.rawSize == 0 || entry.rawSize / LZ4_MAX_EXPANSION > entry.size)) ||
+		entry.compression > AssetPackLZ4) {
+	  close();
+	  throw std::runtime_error("bad entry in asset pack " + path);
+	}
+  }
+
+  std::printf("asset pack %s: %u entries, %zu bytes mapped\n", path.c_str(), entryCount, mappingSize);
+  return true;
+}
+
+void AssetPack::close() {
+#ifdef _WIN32
+  if (mapping != nullptr) UnmapViewOfFile(mapping);
+  if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+  if (fileHandle != nullptr) CloseHandle(fileHandle);
+  fileHandle = mappingHandle = nullptr;
+#else
+  if (mapping != nullptr) munmap(const_cast<uint8_t *>(mapping), mappingSize);
+#endif
+  mapping = nullptr;
+  mappingSize = 0;
+  entries = nullptr;
+  entryCount = 0;
+  names = nullptr;
+}
+
+bool AssetPack::isOpen() const {
+  return mapping != nullptr;
+}
+
+/* ================================ Lookup ================================ */
+
+std::string_view AssetPack::entryName(const AssetPackEntry &entry) const {
+  return std::string_view(names + entry.nameOffset, entry.nameSize);
+}
+
+const AssetPackEntry *AssetPack::find(std::string_view name) const {
+  const AssetPackEntry *end = entries + entryCount;
+  const AssetPackEntry *found = std::lower_bound(entries, end, name,
+	[this](const AssetPackEntry &entry, std::string_view key) { return entryName(entry) < key; });
+  if (found == end || entryName(*found) != name) return nullptr;
+  return found;
+}
+
+void AssetPack::read(const AssetPackEntry &entry, AssetBytes &bytes) const {
+  const uint8_t *stored = mapping + entry.offset;
+  if (entry.compression == AssetPackStored) {
+	bytes.owned.clear();
+	bytes.data = stored;
+	bytes.size = entry.size;
+	return;
+  }
+
+  bytes.owned.resize(entry.rawSize);
+  if (!decompressLZ4(stored, entry.size, bytes.owned.data(), bytes.owned.size())) {
+	throw std::runtime_error("corrupt lz4 block for " + std::string(entryName(entry)));
+  }
+  bytes.data = bytes.owned.data();
+  bytes.size = bytes.owned.size();
+}
+
+const AssetPack &gameAssetPack() {
+  static AssetPack pack;
+  static bool opened = pack.open(ASSET_PACK_PATH);
+  (void)opened;
+  return pack;
+}
+
+bool readAssetBytes(const std::string &path, AssetBytes &bytes) {
+  const AssetPack &pack = gameAssetPack();
+  if (pack.isOpen()) {
+	if (const AssetPackEntry *entry = pack.find(assetPackName(path))) {
+	  pack.read(*entry, bytes);
+	  return true;
+	}
+  }
+
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) return false;
+  bytes.owned.resize(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(reinterpret_cast<char *>(bytes.owned.data()), bytes.owned.size());
+  bytes.data = bytes.owned.data();
+  bytes.size = bytes.owned.size();
+  return true;
+}
+
+std::string assetPackName(const std::string &path) {
+  return std::filesystem::path(path).lexically_normal().generic_string();
+}
+
+AssetPackFormat assetPackFormat(const std::string &path) {
+  std::string extension = std::filesystem::path(path).extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+				 [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  if (extension == ".obj")  return AssetPackObj;
+  if (extension == ".png")  return AssetPackPng;
+  if (extension == ".ktx2") return AssetPackKTX2;
+  if (extension == ".spv")  return AssetPackSpirV;
+  return AssetPackOther;
+}
+
+uint64_t hashAssetBytes(const uint8_t *data, size_t size, uint64_t hash) {
+  const uint64_t FNV_PRIME = 1099511628211ull;
+  for (size_t i = 0; i < size; i++) hash = (hash ^ data[i]) * FNV_PRIME;
+  return hash;
+}
+
+/* ================================== LZ4 ================================== */
+
+// Plain greedy LZ4: one hash table of the last position each 4 byte sequence was seen at,
+// no lazy matching. Only the packer compresses so it doesn't need to be fast, just valid.
+const size_t LZ4_MIN_MATCH = 4;
+const size_t LZ4_LAST_LITERALS = 5;		// the block always ends in at least this many literals
+const size_t LZ4_MATCH_START_LIMIT = 12; // and no match may start in its last 12 bytes
+const size_t LZ4_MAX_OFFSET = 65535;
+const int LZ4_HASH_BITS = 16;
+
+static uint32_t read32(const uint8_t *p) {
+  uint32_t value;
+  std::memcpy(&value, p, 4);
+  return value;
+}
+
+static void writeLZ4Length(std::vector<uint8_t> &out, size_t length) {
+  while (length >= 255) {
+	out.push_back(255);
+	length -= 255;
+  }
+  out.push_back(static_cast<uint8_t>(length));
+}
+
+static void writeLZ4Sequence(std::vector<uint8_t> &out, const uint8_t *literals, size_t literalCount,
+							 size_t offset, size_t matchLength) {
+  size_t matchCode = matchLength >= LZ4_MIN_MATCH ? matchLength - LZ4_MIN_MATCH : 0;
+  out.push_back(static_cast<uint8_t>((std::min<size_t>(literalCount, 15) << 4) |
+									 (matchLength > 0 ? std::min<size_t>(matchCode, 15) : 0)));
+  if (literalCount >= 15) writeLZ4Length(out, literalCount - 15);
+  out.insert(out.end(), literals, literals + literalCount);
+  if (matchLength == 0) return; // the last sequence is only literals
+
+  out.push_back(static_cast<uint8_t>(offset & 0xFF));
+  out.push_back(static_cast<uint8_t>(offset >> 8));
+  if (matchCode >= 15) writeLZ4Length(out, matchCode - 15);
+}
+
+std::vector<uint8_t> compressLZ4(const uint8_t *data, size_t size) {
+  std::vector<uint8_t> out;
+  out.reserve(size / 2 + 16);
+
+  std::vector<int64_t> table(size_t(1) << LZ4_HASH_BITS, -1);
+  size_t anchor = 0, pos = 0;
+  while (pos + LZ4_MATCH_START_LIMIT <= size) {
+	uint32_t sequence = read32(data + pos);
+	uint32_t hash = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+	int64_t candidate = table[hash];
+	table[hash] = static_cast<int64_t>(pos);
+
+	if (candidate < 0 || pos - candidate > LZ4_MAX_OFFSET || read32(data + candidate) != sequence) {
+	  pos++;
+	  continue;
+	}
+
+	size_t matchLength = LZ4_MIN_MATCH;
+	while (pos + matchLength < size - LZ4_LAST_LITERALS &&
+		   data[candidate + matchLength] == data[pos + matchLength]) {
+	  matchLength++;
+	}
+
+	writeLZ4Sequence(out, data + anchor, pos - anchor, pos - candidate, matchLength);
+	pos += matchLength;
+	anchor = pos;
+  }
+
+  writeLZ4Sequence(out, data + anchor, size - anchor, 0, 0);
+  return out;
+}
+
+bool decompressLZ4(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize) {
+  const uint8_t *in = src, *inEnd = src + srcSize;
+  uint8_t *out = dst, *outEnd = dst + dstSize;
+
+  auto readLength = [&](size_t &length) {
+	uint8_t byte;
+	do {
+	  if (in >= inEnd) return false;
+	  byte = *in++;
+	  length += byte;
+	} while (byte == 255);
+	return true;
+  };
+
+  while (in < inEnd) {
+	uint8_t token = *in++;
+
+	size_t literalCount = token >> 4;
+	if (literalCount == 15 && !readLength(literalCount)) return false;
+	if (literalCount > static_cast<size_t>(inEnd - in) ||
+		literalCount > static_cast<size_t>(outEnd - out)) return false;
+	if (literalCount > 0) std::memcpy(out, in, literalCount);
+	in += literalCount;
+	out += literalCount;
+
+	if (in == inEnd) break; // the last sequence has no match
+
+	if (inEnd - in < 2) return false;
+	size_t offset = in[0] | (static_cast<size_t>(in[1]) << 8);
+	in += 2;
+	if (offset == 0 || offset > static_cast<size_t>(out - dst)) return false;
+
+	size_t matchLength = token & 15;
+	if (matchLength == 15 && !readLength(matchLength)) return false;
+	matchLength += LZ4_MIN_MATCH;
+	if (matchLength > static_cast<size_t>(outEnd - out)) return false;
+
+	// byte by byte on purpose, matches may overlap what they're writing
+	const uint8_t *match = out - offset;
+	for (size_t i = 0; i < matchLength; i++) out[i] = match[i];
+	out += matchLength;
+  }
+
+  return out == outEnd;
+}
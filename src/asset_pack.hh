@@ -0,0 +1,117 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+									 Asset Pack
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// NOTE: like texture_formats.hh this knows nothing about vulkan, tools/asset_packer.cpp
+// writes the packs with the same definitions the game reads them with.
+
+// One file holding every model, texture and shader, built by the asset_pack target.
+// The game maps it once and reads straight out of the mapping, entries are found by
+// binary search over an index sorted by name. Names are paths relative to the game's
+// working directory ("models/orc_low_poly/orc_low_poly.obj", see assetPackName), which
+// is what AssetLocation and the shader paths already are.
+//
+// Layout: AssetPackHeader, entryCount AssetPackEntry sorted by name, the name table, then
+// the data with every entry starting on ASSET_PACK_ALIGNMENT (so SPIR-V can be used in place).
+const char ASSET_PACK_MAGIC[8] = { 'O', 'R', 'C', 'P', 'A', 'C', 'K', '\0' };
+const uint32_t ASSET_PACK_VERSION = 1;
+const uint64_t ASSET_PACK_ALIGNMENT = 16;
+const char *const ASSET_PACK_PATH = "./assets.pack";
+
+enum AssetPackFormat : uint32_t {
+  AssetPackOther = 0,
+  AssetPackObj,
+  AssetPackPng,
+  AssetPackKTX2,
+  AssetPackSpirV,
+};
+
+enum AssetPackCompression : uint32_t {
+  AssetPackStored = 0,
+  AssetPackLZ4,			// one LZ4 block (no frame), decompresses to rawSize bytes
+};
+
+struct AssetPackHeader {
+  char						magic[8];
+  uint32_t					version;
+  uint32_t					entryCount;
+  uint64_t					namesOffset;
+  uint64_t					namesSize;
+};
+
+struct AssetPackEntry {
+  uint64_t					offset;		 // from the start of the pack
+  uint64_t					size;		 // bytes in the pack
+  uint64_t					rawSize;	 // bytes once decompressed, same as size when stored
+  uint64_t					contentHash; // hashAssetBytes of the raw bytes
+  uint32_t					nameOffset;	 // into the name table, not null terminated
+  uint32_t					nameSize;
+  AssetPackFormat			format;
+  AssetPackCompression		compression;
+};
+
+// The bytes of one asset. Stored entries point straight into the pack's mapping, anything
+// else (LZ4 entries, loose files when there's no pack) lands in owned.
+struct AssetBytes {
+  const uint8_t *			data = nullptr;
+  size_t					size = 0;
+  std::vector<uint8_t>		owned;
+};
+
+class AssetPack {
+public:
+  AssetPack() = default;
+  ~AssetPack();
+  AssetPack(const AssetPack &) = delete;
+  AssetPack &operator=(const AssetPack &) = delete;
+
+  bool						open(const std::string &path); // false if there's no such file
+  bool						isOpen() const;
+  const AssetPackEntry *	find(std::string_view name) const; // nullptr if it isn't packed
+  std::string_view			entryName(const AssetPackEntry &entry) const;
+  void						read(const AssetPackEntry &entry, AssetBytes &bytes) const;
+
+private:
+  const uint8_t *			mapping = nullptr;
+  size_t					mappingSize = 0;
+  const AssetPackEntry *	entries = nullptr;
+  uint32_t					entryCount = 0;
+  const char *				names = nullptr;
+#ifdef _WIN32
+  void *					fileHandle = nullptr;
+  void *					mappingHandle = nullptr;
+#endif
+  void						close();
+};
+
+// ASSET_PACK_PATH, opened the first time anyone asks. Never fails, without a pack every
+// lookup just misses and readAssetBytes goes to the loose files instead.
+const AssetPack &			gameAssetPack();
+
+// from the pack if it's in there, otherwise the loose file. False if it's in neither.
+bool						readAssetBytes(const std::string &path, AssetBytes &bytes);
+
+std::string					assetPackName(const std::string &path); // "./models/a.obj" -> "models/a.obj"
+AssetPackFormat				assetPackFormat(const std::string &path); // from the extension
+
+// FNV-1a, pass the previous result back in as hash to continue over more bytes
+const uint64_t				ASSET_HASH_SEED = 14695981039346656037ull;
+uint64_t					hashAssetBytes(const uint8_t *data, size_t size, uint64_t hash = ASSET_HASH_SEED);
+
+// raw LZ4 blocks, see https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+const uint64_t				LZ4_MAX_EXPANSION = 255; // no block decompresses to more than this times its size
+std::vector<uint8_t>		compressLZ4(const uint8_t *data, size_t size);
+bool						decompressLZ4(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize);
@@ -0,0 +1,70 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+									 Asset Tasks
+*/
+
+#include <cstdio>
+#include <new>
+
+#include "asset_task.hh"
+
+AssetTaskFramePool::FreeFrame *	AssetTaskFramePool::freeFrames = nullptr;
+size_t							AssetTaskFramePool::inUse = 0;
+
+void *AssetTaskFramePool::allocate(size_t size) {
+  if (size > ASSET_TASK_FRAME_SIZE) return ::operator new(size);
+
+  if (freeFrames == nullptr) grow();
+  FreeFrame *frame = freeFrames;
+  freeFrames = frame->next;
+  inUse++;
+  return frame;
+}
+
+void AssetTaskFramePool::deallocate(void *frame, size_t size) {
+  if (size > ASSET_TASK_FRAME_SIZE) {
+	::operator delete(frame);
+	return;
+  }
+
+  FreeFrame *freed = static_cast<FreeFrame *>(frame);
+  freed->next = freeFrames;
+  freeFrames = freed;
+  inUse--;
+}
+
+size_t AssetTaskFramePool::framesInUse() {
+  return inUse;
+}
+
+// NOTE: blocks are never given back, there are only ever a handful of tasks alive at once
+void AssetTaskFramePool::grow() {
+  // operator new aligns for anything, and ASSET_TASK_FRAME_SIZE keeps every frame after the first aligned too
+  char *block = static_cast<char *>(::operator new(ASSET_TASK_FRAME_SIZE * ASSET_TASK_FRAMES_PER_BLOCK));
+  for (size_t i = 0; i < ASSET_TASK_FRAMES_PER_BLOCK; i++) {
+	FreeFrame *frame = reinterpret_cast<FreeFrame *>(block + i * ASSET_TASK_FRAME_SIZE);
+	frame->next = freeFrames;
+	freeFrames = frame;
+  }
+}
+
+// the task is suspended at its end here, so its frame can go
+void AssetTask::FinalSuspend::await_suspend(std::coroutine_handle<promise_type> task) noexcept {
+  std::exception_ptr exception = task.promise().exception;
+  task.destroy();
+  if (!exception) return;
+
+  try {
+	std::rethrow_exception(exception);
+  } catch (const std::exception &e) {
+	std::printf("asset task failed: %s\n", e.what());
+  } catch (...) {
+	std::printf("asset task failed\n");
+  }
+  std::fflush(stdout);
+  std::terminate();
+}
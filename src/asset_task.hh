@@ -0,0 +1,74 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+									 Asset Tasks
+*/
+
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+
+// Gameplay code that needs an asset before it can go on writes a coroutine returning
+// AssetTask and co_awaits AssetStore::loadAsync (or loadMeshAsync/loadTextureAsync):
+//
+//   AssetTask spawnWhenReady(GameState &gameState) {
+//     Mesh *mesh = co_await gameState.assetStore.loadMeshAsync(ORC_GUID);
+//     ...
+//     mesh->relinquish();
+//   }
+//
+// The files are read on the loader thread like any other claim, and the coroutine is
+// resumed from AssetStore::update on the main thread once the asset is uploaded (or has
+// failed to load, in which case it draws with the placeholder).
+
+// NOTE: tasks are only ever started and resumed on the main thread, so no locking here
+const size_t ASSET_TASK_FRAME_SIZE = 512;	   // bigger frames fall back to operator new
+const size_t ASSET_TASK_FRAMES_PER_BLOCK = 64; // the pool grows a block at a time, never shrinks
+
+class AssetTaskFramePool {
+public:
+  static void *				allocate(size_t size);
+  static void				deallocate(void *frame, size_t size);
+  static size_t				framesInUse();
+
+private:
+  struct FreeFrame {
+	FreeFrame *				next;
+  };
+  static FreeFrame *		freeFrames;
+  static size_t				inUse;
+  static void				grow();
+};
+
+// Fire and forget: runs until its first co_await that has to wait, and frees its own frame
+// when it returns. Nothing ever waits on a task, so an exception it doesn't catch has
+// nowhere to go: it's kept in the promise until the task finishes, then reported and the
+// game terminates (like an exception leaving a std::thread). It never comes out of
+// whoever resumed the task.
+class AssetTask {
+public:
+  struct promise_type;
+
+  struct FinalSuspend {
+	bool					await_ready() noexcept { return false; }
+	void					await_suspend(std::coroutine_handle<promise_type> task) noexcept;
+	void					await_resume() noexcept {}
+  };
+
+  struct promise_type {
+	AssetTask				get_return_object() { return {}; }
+	std::suspend_never		initial_suspend() noexcept { return {}; }
+	FinalSuspend			final_suspend() noexcept { return {}; }
+	void					return_void() {}
+	void					unhandled_exception() noexcept { exception = std::current_exception(); }
+	std::exception_ptr		exception;
+
+	static void *			operator new(size_t size) { return AssetTaskFramePool::allocate(size); }
+	static void				operator delete(void *frame, size_t size) { AssetTaskFramePool::deallocate(frame, size); }
+  };
+};
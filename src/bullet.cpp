@@ -42,6 +42,11 @@ Bullet::Bullet(skyVec3 position, skyVec3 direction, bool superBullet, AssetStore
   type = Bullet_e;
 }
 
+Bullet::~Bullet() {
+  texture->relinquish();
+  mesh->relinquish();
+}
+
 std::vector<GameOp> Bullet::update(std::chrono::microseconds dt, GameState &gameState){
   float movement_rate = superBullet ? MOVEMENT_RATE_SUPER : MOVEMENT_RATE_REGULAR;
   float hit_radius = superBullet ? HIT_RADIUS_SUPER : HIT_RADIUS_REGULAR;
@@ -19,6 +19,11 @@ Decorator::Decorator(skyVec3 position, float scale, skyGUID textureId, AssetStor
   mesh = assetStore.getMesh(DECORATOR_GUID);
 }
 
+Decorator::~Decorator() {
+  texture->relinquish();
+  mesh->relinquish();
+}
+
 GameOps Decorator::update(std::chrono::microseconds dt, GameState &gameState){ return {}; }
 
 void Decorator::display(RenderState &renderState){
@@ -0,0 +1,68 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+									 Frame Pacer
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "frame_pacer.hh"
+
+typedef std::chrono::duration<double, std::milli> PacerMs;
+
+FramePacer::FramePacer(double targetFrameRate) {
+  period = ProfileClock::duration::zero();
+  if (targetFrameRate > 0.0) {
+	period = std::chrono::duration_cast<ProfileClock::duration>(std::chrono::duration<double>(1.0 / targetFrameRate));
+  }
+  lastFrame = deadline = ProfileClock::now();
+}
+
+// NOTE: "cpu utilization %" is the main thread's time outside of sleepUntil, so blocking
+// in drawFrame (timeline waits, vkAcquireNextImageKHR under FIFO) still counts as busy
+ProfileClock::time_point FramePacer::wait() {
+  ProfileClock::duration slept {};
+  if (period > ProfileClock::duration::zero()) {
+	deadline += period;
+	if (ProfileClock::now() >= deadline) {
+	  deadline = ProfileClock::now(); // a long frame, don't rush the next few to catch up
+	} else {
+	  sleepUntil(deadline - spin, slept);
+	  while (ProfileClock::now() < deadline) std::this_thread::yield();
+	}
+  }
+
+  auto now = ProfileClock::now();
+  ProfileClock::duration interval = now - lastFrame;
+  if (Profiler::isEnabled() && interval > ProfileClock::duration::zero()) {
+	ProfileClock::duration expected = period > ProfileClock::duration::zero() ? period : lastInterval;
+	Profiler::addCounter("cpu utilization %", 100.0 * (1.0 - PacerMs(slept) / PacerMs(interval)));
+	Profiler::addCounter("frame jitter ms", std::abs(PacerMs(interval - expected).count()));
+  }
+  lastInterval = interval;
+  lastFrame = now;
+  return now;
+}
+
+// the spin grows right away when a sleep wakes up later than it covers, and shrinks
+// slowly back towards FRAME_PACER_MIN_SPIN while they don't
+void FramePacer::sleepUntil(ProfileClock::time_point until, ProfileClock::duration &slept) {
+  auto start = ProfileClock::now();
+  if (until <= start) return;
+
+  std::this_thread::sleep_until(until);
+  auto woke = ProfileClock::now();
+  slept = woke - start;
+
+  ProfileClock::duration late = woke - until;
+  if (late > spin) {
+	spin = std::min<ProfileClock::duration>(late + late / 4, FRAME_PACER_MAX_SPIN);
+  } else {
+	spin = std::max<ProfileClock::duration>(spin - spin / 64, FRAME_PACER_MIN_SPIN);
+  }
+}
@@ -0,0 +1,39 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+									 Frame Pacer
+*/
+
+#pragma once
+
+#include <chrono>
+
+#include "profiler.hh"
+
+// Holds the main loop to a target frame rate without pinning a core: it sleeps until
+// shortly before the deadline, then spins (yielding) for the rest, since sleeps wake
+// up late by anywhere from tens of microseconds to a scheduler tick. How much it spins
+// follows the worst oversleep it has seen lately.
+//
+// With --profile it reports "cpu utilization %" (time not spent asleep, spinning counts
+// as busy) and "frame jitter ms" (how far each frame interval is from the target, or
+// from the previous interval when uncapped) through Profiler::addCounter.
+const std::chrono::microseconds FRAME_PACER_MIN_SPIN(200);
+const std::chrono::microseconds FRAME_PACER_MAX_SPIN(4000);
+
+class FramePacer {
+public:
+  FramePacer(double targetFrameRate); // 0 doesn't wait at all, for --fps 0
+  ProfileClock::time_point	wait();   // call at the top of every frame, returns when the frame starts
+
+private:
+  ProfileClock::duration	period;
+  ProfileClock::duration	spin = FRAME_PACER_MIN_SPIN;
+  ProfileClock::time_point	deadline;
+  ProfileClock::time_point	lastFrame;
+  ProfileClock::duration	lastInterval {};
+  void						sleepUntil(ProfileClock::time_point until, ProfileClock::duration &slept);
+};
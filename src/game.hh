@@ -36,6 +36,8 @@ struct GameState {
   AssetStore &assetStore;
   std::vector<GameObject*> gameObjects;
   std::vector<GameOp> mailbox;
+  size_t zone = 0; // index into ZONES
+  bool spawning = false; // set by startSpawning once orcs and humans can be drawn
 };
 
 
@@ -33,7 +33,9 @@ enum GameObjectType {
 class GameObject {
 public:
   GameObject(skyVec3 position) :position(position){};
-  //~GameObject();
+  virtual ~GameObject() = default; // subclasses relinquish their asset claims
+  GameObject(const GameObject &) = delete; // a copy would relinquish the same claims twice
+  GameObject &operator=(const GameObject &) = delete;
 
   
   virtual GameOps 		update(std::chrono::microseconds dt, GameState &gameState) = 0;
@@ -62,7 +64,7 @@ class RigidBody : public GameObject {
 public:
   RigidBody(skyVec3 position, skyQuat rotation, float scale,
 			GUID textureId, GUID meshId, AssetStore &assetStore);
-  //~RigidBody();
+  ~RigidBody();
   GameOps 				update(std::chrono::microseconds dt, GameState &gameState);
   void 					display(RenderState &renderState);
   void                  move(std::chrono::microseconds dt, skyVec3 dv, skyVec3 dw);
@@ -82,7 +84,7 @@ public:
   GameOps 				update(std::chrono::microseconds dt, GameState &gameState);
   void 					display(RenderState &renderState);
   bool 					load();
-  //~Decorator();
+  ~Decorator();
 private:
   // TODO(caleb): add private copy constructor
   float scale;
@@ -94,6 +96,7 @@ private:
 class Orc : public GameObject {
 public:
   Orc(skyVec3 position, AssetStore &assetStore);
+  ~Orc();
   GameOps 				update(std::chrono::microseconds dt, GameState &gameState);
   void 					display(RenderState &renderState);
   void                  move(std::chrono::microseconds dt, skyVec3 dv, skyVec3 dw);
@@ -111,6 +114,7 @@ private:
 class Human: public GameObject {
 public:
   Human(skyVec3 position, AssetStore &assetStore);
+  ~Human();
   GameOps 				update(std::chrono::microseconds dt, GameState &gameState);
   void 					display(RenderState &renderState);
   void                  move(std::chrono::microseconds dt, skyVec3 dv, skyVec3 dw);
@@ -131,6 +135,7 @@ private:
 class Bullet: public GameObject {
 public:
   Bullet(skyVec3 position, skyVec3 direction, bool superBullet, AssetStore &assetStore);
+  ~Bullet();
   GameOps 						update(std::chrono::microseconds dt, GameState &gameState);
   void 							display(RenderState &renderState);
   void                  		move(std::chrono::microseconds dt, skyVec3 dv, skyVec3 dw);
@@ -152,6 +157,7 @@ class Animation: public GameObject {
 public:
   Animation(skyVec3 position, skyGUID textureId, skyGUID meshId,
 			std::chrono::milliseconds duration, AssetStore &assetStore);
+  ~Animation();
   GameOps 						update(std::chrono::microseconds dt, GameState &gameState);
   void 							display(RenderState &renderState);
   void                  		move(std::chrono::microseconds dt, skyVec3 dv, skyVec3 dw);
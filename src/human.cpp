@@ -36,6 +36,11 @@ Human::Human(skyVec3 position, AssetStore &assetStore)
   type = Human_e;
 }
 
+Human::~Human() {
+  texture->relinquish();
+  mesh->relinquish();
+}
+
 GameOps Human::update(std::chrono::microseconds dt, GameState &gameState){
   GameOps ops;
 
@@ -9,9 +9,36 @@ SDG
 
 
 
-#include "game_object.hh"
+#include <cstdint>
+#include <cstdlib>
 
-std::chrono::duration MIN_FRAME_TIME = 1ms;
+#include "frame_pacer.hh"
+#include "game_object.hh"
+#include "profiler.hh"
+
+double targetFrameRate = 60.0; // --fps, 0 runs as fast as the present mode lets it
+// --max-objects, the spawners stop here. The default is the old MAX_GAME_OBJECTS/8: every
+// unit looks through all the others each frame (findNearestHuman and friends), so bigger
+// hordes are opt in. The instance buffers grow to fit whatever is asked for.
+size_t maxGameObjects = 1011;
+std::chrono::duration<float> zoneInterval(0.0f); // --zone-seconds, 0 stays in the first zone
+
+// The game runs from the first frame with whatever is resident. Until the zone is all in
+// there's a backdrop behind it and a progress bar in front (see displayLoadingView), and
+// the title bar counts the assets.
+struct LoadingView {
+  bool active = true;
+  float progress = 0.0f;   // of the zone's assets that are resident
+  size_t shown = SIZE_MAX; // resident count in the title right now
+  std::chrono::high_resolution_clock::time_point since;
+};
+
+const float LOADING_BACKDROP_Z = -0.1f;	// just behind the map
+const float LOADING_BACKDROP_SCALE = 100.0f; // past the edges of the view at any aspect
+const int LOADING_BAR_CELLS = 20;
+const float LOADING_BAR_CELL_SIZE = 0.25f;
+const float LOADING_BAR_Y = -3.4f;			// near the bottom of the default camera's view
+const float LOADING_BAR_Z = 0.5f;			// in front of everything on the ground
 
 void passGameOpsToMailboxes(std::vector<GameOp> ops, GameState &gameState) {
   for (auto &op : ops) {
@@ -73,7 +100,10 @@ void handleWorldGameOps(GameState &gameState) {
 GameState initGameState(Renderer &renderer) {;
   AssetStore *assetStore = new AssetStore(renderer);
 
-  assetStore->load(ALL_GAME_ASSETS);
+  // neither of these waits, the first zone streams in while the loading view is up and
+  // the next zone reads in the background after it, see advanceZone
+  assetStore->enterZone(ZONES[0]);
+  assetStore->prefetchZone(ZONES[1 % ZONES.size()]);
 
   skyVec3 position (0.0,0.0,0.0);
   skyQuat rotation = skyQuat::unitVec();
@@ -87,8 +117,77 @@ GameState initGameState(Renderer &renderer) {;
   return gameState;
 }
 
+// TODO(caleb): there are no missions yet to say when we move on, so the demo just cycles
+// through ZONES every zoneInterval to exercise the transitions
+void advanceZone(GameState &gameState) {
+  gameState.zone = (gameState.zone + 1) % ZONES.size();
+  gameState.assetStore.enterZone(ZONES[gameState.zone]);
+  gameState.assetStore.prefetchZone(ZONES[(gameState.zone + 1) % ZONES.size()]);
+}
+
+// Both are quads from the renderer, so they cost one draw and no assets: the backdrop
+// in the placeholder texture, then one lit cell per 1/LOADING_BAR_CELLS of progress.
+void displayLoadingView(Renderer &renderer, RenderState &renderState, float progress) {
+  const glm::vec4 unrotated(1.0f, 0.0f, 0.0f, 0.0f); // w first, see base.vert
+
+  Renderable &quads = renderState.assets["LOADING_VIEW"];
+  if (quads.lods.empty()) quads = renderer.getQuadMesh();
+  std::vector<Instance> &instances = quads.lods[0].instances;
+
+  instances.push_back(Instance{ .position = {0.0f, 0.0f, LOADING_BACKDROP_Z},
+								.rotation = unrotated,
+								.scale = LOADING_BACKDROP_SCALE,
+								.textureIndex = renderer.getPlaceholderTextureSlot() });
+
+  int lit = std::clamp(static_cast<int>(progress * LOADING_BAR_CELLS), 0, LOADING_BAR_CELLS);
+  float left = -0.5f * LOADING_BAR_CELLS * LOADING_BAR_CELL_SIZE;
+  for (int cell = 0; cell < lit; cell++) {
+	float x = left + (cell + 0.5f) * LOADING_BAR_CELL_SIZE;
+	instances.push_back(Instance{ .position = {x, LOADING_BAR_Y, LOADING_BAR_Z},
+								  .rotation = unrotated,
+								  .scale = 0.8f * LOADING_BAR_CELL_SIZE, // gaps between the cells
+								  .textureIndex = renderer.getProgressTextureSlot() });
+  }
+}
+
+void updateLoadingView(Renderer &renderer, GameState &gameState, LoadingView &view) {
+  const ZoneManifest &zone = ZONES[gameState.zone];
+  size_t resident = gameState.assetStore.residentCount(zone);
+  view.progress = zone.assets.empty() ? 1.0f : static_cast<float>(resident) / zone.assets.size();
+
+  if (resident == zone.assets.size()) {
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - view.since;
+	Profiler::addCounter("zone resident ms", elapsed.count());
+	std::printf("zone %s resident after %.1f ms\n", zone.name, elapsed.count());
+	renderer.setWindowTitle(WINDOW_TITLE);
+	view.active = false;
+  } else if (resident != view.shown) {
+	renderer.setWindowTitle(std::string(WINDOW_TITLE) + " - loading " + zone.name + " (" +
+							std::to_string(resident) + "/" + std::to_string(zone.assets.size()) + ")");
+  }
+  view.shown = resident;
+}
+
+// Units spawned before their assets are in would fight invisibly for the first few frames,
+// so spawning waits for them. The claims only bridge the wait, each unit takes its own.
+AssetTask startSpawning(GameState &gameState) {
+  AssetStore &assetStore = gameState.assetStore;
+  // all four are claimed (and loading) before we wait on the first
+  AssetLoad<Asset> loads[] {
+	assetStore.loadAsync(ORC_GUID),
+	assetStore.loadAsync(ORC_TEXTURE_GUID),
+	assetStore.loadAsync(HUMAN_GUID),
+	assetStore.loadAsync(HUMAN_TEXTURE_GUID),
+  };
+  for (AssetLoad<Asset> &load : loads) co_await load;
+
+  gameState.spawning = true;
+  std::printf("spawning started\n");
+  for (AssetLoad<Asset> &load : loads) load.asset->relinquish();
+}
+
 void spawnOrcs(GameState &gameState) {
-  for (int i = 0; i < ORCS_PER_FRAME && gameState.gameObjects.size() < MAX_GAME_OBJECTS/8; i++) {
+  for (int i = 0; i < ORCS_PER_FRAME && gameState.gameObjects.size() < maxGameObjects; i++) {
     std::random_device rd;
     std::mt19937 generator(rd());
     std::uniform_real_distribution<float> distribution(-5.4, 5.4);
@@ -102,7 +201,7 @@ void spawnOrcs(GameState &gameState) {
 }
 
 void spawnHumans(GameState &gameState) {
-  for (int i = 0; i < HUMANS_PER_FRAME && gameState.gameObjects.size() < MAX_GAME_OBJECTS/8; i++) {
+  for (int i = 0; i < HUMANS_PER_FRAME && gameState.gameObjects.size() < maxGameObjects; i++) {
     std::random_device rd;
     std::mt19937 generator(rd());
     std::uniform_real_distribution<float> distribution(-5.4, 5.4);
@@ -120,13 +219,17 @@ void spawnHumans(GameState &gameState) {
   }
 }
 
-void drawDemoFrame(Renderer &renderer, GameState &gameState, std::chrono::duration<float> dt) {
+void drawDemoFrame(Renderer &renderer, GameState &gameState, const LoadingView &loadingView,
+				   std::chrono::duration<float> dt) {
   RenderState renderState = {};
+  renderState.camera = renderer.getCamera();
 
   auto dt_micros = std::chrono::duration_cast<std::chrono::microseconds>(dt);
 
-  spawnOrcs(gameState);
-  spawnHumans(gameState);
+  if (gameState.spawning) {
+	spawnOrcs(gameState);
+	spawnHumans(gameState);
+  }
   
   for (GameObject *obj : gameState.gameObjects) {
 	auto ops = obj->update(dt_micros, gameState);
@@ -146,6 +249,9 @@ void drawDemoFrame(Renderer &renderer, GameState &gameState, std::chrono::durati
 	obj->display(renderState);
 	obj->generation++;
   }
+  if (loadingView.active) displayLoadingView(renderer, renderState, loadingView.progress);
+
+  gameState.assetStore.update(renderState);
 
   int numBullets = 0;
   for (GameObject *obj : gameState.gameObjects) {
@@ -165,8 +271,68 @@ static void handleMouseButton(Window window, int button, int action, int mods) {
 }
 
 
+// TODO: this will want to be a proper settings file once we have a menu
+static void parseArgs(int argc, char *argv[], Renderer &renderer) {
+  bool gpuBudgetSet = false;
+  for (int i = 1; i < argc; i++) {
+	std::string arg = argv[i];
+	if (arg == "--packed-instances") {
+	  renderer.config.instanceFormat = InstancePacked;
+	} else if (arg == "--quantized-vertices") {
+	  renderer.config.vertexFormat = VertexQuantized;
+	} else if (arg == "--profile") {
+	  Profiler::setEnabled(true);
+	} else if (arg == "--texture-budget" && i + 1 < argc) {
+	  renderer.config.textureBudget = std::strtoull(argv[++i], nullptr, 10) * 1024 * 1024; // MB
+	} else if (arg == "--asset-cpu-budget" && i + 1 < argc) {
+	  renderer.config.assetCpuBudget = std::strtoull(argv[++i], nullptr, 10) * 1024 * 1024; // MB
+	} else if (arg == "--asset-gpu-budget" && i + 1 < argc) {
+	  renderer.config.assetGpuBudget = std::strtoull(argv[++i], nullptr, 10) * 1024 * 1024; // MB
+	} else if (arg == "--zone-seconds" && i + 1 < argc) {
+	  zoneInterval = std::chrono::duration<float>(std::strtof(argv[++i], nullptr));
+	} else if (arg == "--fps" && i + 1 < argc) {
+	  targetFrameRate = std::strtod(argv[++i], nullptr);
+	} else if (arg == "--present-mode" && i + 1 < argc) {
+	  std::string mode = argv[++i];
+	  if (mode == "fifo") renderer.config.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	  else if (mode == "mailbox") renderer.config.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+	  else if (mode == "immediate") renderer.config.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+	  else std::printf("unknown present mode %s (fifo, mailbox or immediate)\n", mode.c_str());
+	} else if (arg == "--max-objects" && i + 1 < argc) {
+	  maxGameObjects = std::strtoull(argv[++i], nullptr, 10);
+	} else if (arg == "--gpu-stats") {
+	  renderer.config.pipelineStatistics = true;
+	} else if (arg == "--headless") {
+	  renderer.config.headless = true;
+	} else if (arg == "--frames" && i + 1 < argc) {
+	  renderer.config.headlessFrames = std::strtoull(argv[++i], nullptr, 10);
+	} else if (arg == "--dump-frames" && i + 1 < argc) {
+	  renderer.config.dumpFrameInterval = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+	} else if (arg == "--render-pass") {
+	  renderer.config.dynamicRendering = false;
+	} else if (arg == "--pipelines") {
+	  renderer.config.shaderObjects = false;
+	} else if (arg == "--frames-in-flight" && i + 1 < argc) {
+	  renderer.config.framesInFlight = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)); // 2 to 4
+	} else if (arg == "--dynamic-resolution") {
+	  renderer.config.dynamicResolution = true;
+	} else if (arg == "--gpu-budget" && i + 1 < argc) {
+	  renderer.config.gpuFrameBudgetMs = std::strtod(argv[++i], nullptr); // ms
+	  gpuBudgetSet = true;
+	} else if (arg == "--min-render-scale" && i + 1 < argc) {
+	  renderer.config.minRenderScale = std::strtof(argv[++i], nullptr);
+	} else {
+	  std::printf("unknown argument %s\n", arg.c_str());
+	}
+  }
+  // the gpu gets the whole frame the pacer aims for, unless it's told otherwise
+  if (!gpuBudgetSet && targetFrameRate > 0.0) renderer.config.gpuFrameBudgetMs = 1000.0 / targetFrameRate;
+}
+
 int main (int argc, char *argv[]) {
+  auto startup = std::chrono::high_resolution_clock::now();
   Renderer renderer;
+  parseArgs(argc, argv, renderer);
 
   try {
 
@@ -174,22 +340,60 @@ int main (int argc, char *argv[]) {
     renderer.initGraphics();
 
 	// TODO(caleb): createCursor here once we load the cursor sprite
-	renderer.setCursorMovementCallback(glfwCreateStandardCursor(GLFW_HRESIZE_CURSOR), (CursorPositionCallback)handleCursorMovement);
-	renderer.setMouseButtonCallback((MouseButtonCallback)handleMouseButton);
+	if (!renderer.config.headless) {
+	  renderer.setCursorMovementCallback(glfwCreateStandardCursor(GLFW_HRESIZE_CURSOR), (CursorPositionCallback)handleCursorMovement);
+	  renderer.setMouseButtonCallback((MouseButtonCallback)handleMouseButton);
+	}
 
+	// present before anything is read so the window never sits there white
+	renderer.setWindowTitle(std::string(WINDOW_TITLE) + " - loading");
+	RenderState loadingState = {};
+	loadingState.camera = renderer.getCamera();
+	displayLoadingView(renderer, loadingState, 0.0f);
+	renderer.drawFrame(loadingState.getRenderOps(renderer));
+	std::chrono::duration<double, std::milli> firstFrame = std::chrono::high_resolution_clock::now() - startup;
+	Profiler::addCounter("time to first frame ms", firstFrame.count());
+	std::printf("first frame after %.1f ms\n", firstFrame.count());
+
+	LoadingView loadingView { .since = std::chrono::high_resolution_clock::now() };
 	GameState gameState = initGameState(renderer);
+	startSpawning(gameState);
 
+	FramePacer pacer(renderer.config.headless ? 0.0 : targetFrameRate); // headless runs are benchmarks
 	auto prev_frame = std::chrono::high_resolution_clock::now();
+	auto zone_entered = prev_frame;
+	auto loop_start = prev_frame;
+	RenderStats statsBefore = renderer.getRenderStats();
 
 	int generation = 0;
     while (!renderer.shouldClose()) {
-	  auto current_frame = std::chrono::high_resolution_clock::now();
-	  if ((current_frame - prev_frame) > MIN_FRAME_TIME) {
-		renderer.getInput();
-		drawDemoFrame(renderer, gameState, current_frame - prev_frame);
-		prev_frame = current_frame;
+	  auto current_frame = pacer.wait();
+	  Profiler::beginFrame();
+	  renderer.getInput();
+	  if (zoneInterval.count() > 0.0f && current_frame - zone_entered >= zoneInterval) {
+		advanceZone(gameState);
+		zone_entered = current_frame;
+		loadingView = LoadingView { .since = current_frame };
 	  }
+	  if (loadingView.active) updateLoadingView(renderer, gameState, loadingView);
+	  drawDemoFrame(renderer, gameState, loadingView, current_frame - prev_frame);
+	  prev_frame = current_frame;
+	  Profiler::endFrame();
     }
+
+	if (renderer.config.headless) {
+	  RenderStats stats = renderer.getRenderStats();
+	  double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - loop_start).count();
+	  uint64_t frames = stats.frames - statsBefore.frames;
+	  std::printf("headless: %llu frames in %.2f s, %.1f frames/s, %.0f draws/s, %.0f instances/s\n",
+				  static_cast<unsigned long long>(frames), seconds, frames / seconds,
+				  (stats.draws - statsBefore.draws) / seconds, (stats.instances - statsBefore.instances) / seconds);
+	}
+
+	// give back every claim, then free the assets while the device is still around
+	for (GameObject *obj : gameState.gameObjects) delete obj;
+	gameState.gameObjects.clear();
+	gameState.assetStore.unloadAll();
   } catch (const std::exception &e) {
     std::cerr << e.what() << std::endl;
     return EXIT_FAILURE;
@@ -0,0 +1,492 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+								  Mesh Optimizer
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <unordered_map>
+
+#include "mesh_optimizer.hh"
+
+/* ========================== Post Transform Cache ========================== */
+
+float computeACMR(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize) {
+  if (indices.size() < 3) return 0.0f;
+
+  // a vertex is in the FIFO if fewer than cacheSize misses happened since it was inserted
+  std::vector<uint32_t> insertedAt(vertexCount, 0);
+  uint32_t misses = 0;
+  for (uint32_t index : indices) {
+	if (insertedAt[index] == 0 || misses - insertedAt[index] >= cacheSize) {
+	  misses++;
+	  insertedAt[index] = misses;
+	}
+  }
+
+  return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+}
+
+// tuning values straight from the paper
+static const int	FORSYTH_CACHE_SIZE = 32;
+static const float	CACHE_DECAY_POWER = 1.5f;
+static const float	LAST_TRIANGLE_SCORE = 0.75f;
+static const float	VALENCE_BOOST_SCALE = 2.0f;
+static const float	VALENCE_BOOST_POWER = 0.5f;
+
+static float vertexScore(int cachePosition, uint32_t liveTriangles) {
+  if (liveTriangles == 0) return -1.0f;
+
+  float score = 0.0f;
+  if (cachePosition >= 0) {
+	if (cachePosition < 3) {
+	  // vertices of the last triangle are penalized a bit so we don't get stuck in fans
+	  score = LAST_TRIANGLE_SCORE;
+	} else {
+	  float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+	  score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+	}
+  }
+
+  // prefer finishing off vertices with few triangles left
+  score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(liveTriangles), -VALENCE_BOOST_POWER);
+  return score;
+}
+
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) return;
+
+  // vertex -> triangle adjacency, live triangles are kept at the front of each list
+  std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+  for (uint32_t index : indices) adjacencyOffset[index + 1]++;
+  for (size_t v = 0; v < vertexCount; v++) adjacencyOffset[v + 1] += adjacencyOffset[v];
+
+  std::vector<uint32_t> adjacency(indices.size());
+  std::vector<uint32_t> liveTriangles(vertexCount, 0);
+  for (size_t t = 0; t < triangleCount; t++) {
+	for (int k = 0; k < 3; k++) {
+	  uint32_t v = indices[t * 3 + k];
+	  adjacency[adjacencyOffset[v] + liveTriangles[v]++] = static_cast<uint32_t>(t);
+	}
+  }
+
+  std::vector<int> cachePosition(vertexCount, -1);
+  std::vector<float> vScore(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++) vScore[v] = vertexScore(-1, liveTriangles[v]);
+
+  std::vector<float> tScore(triangleCount);
+  std::vector<bool> emitted(triangleCount, false);
+  for (size_t t = 0; t < triangleCount; t++) {
+	tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] + vScore[indices[t * 3 + 2]];
+  }
+
+  auto findBestTriangle = [&](size_t first) -> int64_t {
+	int64_t best = -1;
+	float bestScore = -std::numeric_limits<float>::max();
+	for (size_t t = first; t < triangleCount; t++) {
+	  if (!emitted[t] && tScore[t] > bestScore) {
+		bestScore = tScore[t];
+		best = static_cast<int64_t>(t);
+	  }
+	}
+	return best;
+  };
+
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  std::vector<uint32_t> cache, nextCache;
+  cache.reserve(FORSYTH_CACHE_SIZE + 3);
+  nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+  size_t firstLive = 0;
+
+  int64_t best = findBestTriangle(0);
+  while (best >= 0) {
+	emitted[best] = true;
+	const uint32_t *triangle = &indices[best * 3];
+	output.insert(output.end(), triangle, triangle + 3);
+
+	nextCache.clear();
+	for (int k = 0; k < 3; k++) {
+	  uint32_t v = triangle[k];
+
+	  uint32_t *live = &adjacency[adjacencyOffset[v]];
+	  for (uint32_t i = 0; i < liveTriangles[v]; i++) {
+		if (live[i] == best) {
+		  std::swap(live[i], live[liveTriangles[v] - 1]);
+		  liveTriangles[v]--;
+		  break;
+		}
+	  }
+
+	  if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end()) {
+		nextCache.push_back(v);
+	  }
+	}
+	for (uint32_t v : cache) {
+	  if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end()) {
+		nextCache.push_back(v);
+	  }
+	}
+
+	// everything that was in the cache (including what just fell out of it) needs rescoring
+	for (size_t i = 0; i < nextCache.size(); i++) {
+	  uint32_t v = nextCache[i];
+	  cachePosition[v] = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+	  vScore[v] = vertexScore(cachePosition[v], liveTriangles[v]);
+	}
+
+	best = -1;
+	float bestScore = -std::numeric_limits<float>::max();
+	for (uint32_t v : nextCache) {
+	  const uint32_t *live = &adjacency[adjacencyOffset[v]];
+	  for (uint32_t i = 0; i < liveTriangles[v]; i++) {
+		uint32_t t = live[i];
+		tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] + vScore[indices[t * 3 + 2]];
+		if (tScore[t] > bestScore) {
+		  bestScore = tScore[t];
+		  best = t;
+		}
+	  }
+	}
+
+	if (nextCache.size() > FORSYTH_CACHE_SIZE) nextCache.resize(FORSYTH_CACHE_SIZE);
+	std::swap(cache, nextCache);
+
+	if (best < 0) {
+	  // nothing left touching the cache, start over somewhere else
+	  while (firstLive < triangleCount && emitted[firstLive]) firstLive++;
+	  best = findBestTriangle(firstLive);
+	}
+  }
+
+  indices.swap(output);
+}
+
+/* ================================ Overdraw ================================ */
+
+struct TriangleCluster {
+  size_t 	first;
+  size_t 	count;
+  float 	sortKey;
+};
+
+void optimizeOverdraw(std::vector<uint32_t> &indices,
+					  const float *positions, size_t positionStride,
+					  size_t vertexCount) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount < 2) return;
+
+  auto position = [&](uint32_t v) -> const float * {
+	return reinterpret_cast<const float *>(reinterpret_cast<const char *>(positions) + v * positionStride);
+  };
+
+  // split wherever a triangle misses the cache on all three vertices, those are the
+  // spots where the cache optimizer started a new region anyway
+  std::vector<TriangleCluster> clusters;
+  std::vector<uint32_t> insertedAt(vertexCount, 0);
+  uint32_t misses = 0;
+  for (size_t t = 0; t < triangleCount; t++) {
+	int triangleMisses = 0;
+	for (int k = 0; k < 3; k++) {
+	  uint32_t v = indices[t * 3 + k];
+	  if (insertedAt[v] == 0 || misses - insertedAt[v] >= ACMR_CACHE_SIZE) {
+		misses++;
+		insertedAt[v] = misses;
+		triangleMisses++;
+	  }
+	}
+	if (t == 0 || triangleMisses == 3) clusters.push_back(TriangleCluster{ t, 0, 0.0f });
+	clusters.back().count++;
+  }
+  if (clusters.size() < 2) return;
+
+  // area weighted mesh centroid
+  double meshCentroid[3] = {0.0, 0.0, 0.0};
+  double meshArea = 0.0;
+  std::vector<float> clusterData(clusters.size() * 6, 0.0f); // centroid * area, normal * 2 area
+
+  for (size_t c = 0; c < clusters.size(); c++) {
+	float *data = &clusterData[c * 6];
+	for (size_t t = clusters[c].first; t < clusters[c].first + clusters[c].count; t++) {
+	  const float *a = position(indices[t * 3]);
+	  const float *b = position(indices[t * 3 + 1]);
+	  const float *p = position(indices[t * 3 + 2]);
+
+	  float e0[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+	  float e1[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+	  float n[3] = { e0[1] * e1[2] - e0[2] * e1[1],
+					 e0[2] * e1[0] - e0[0] * e1[2],
+					 e0[0] * e1[1] - e0[1] * e1[0] };
+	  float area = 0.5f * std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+	  for (int axis = 0; axis < 3; axis++) {
+		float centroid = (a[axis] + b[axis] + p[axis]) / 3.0f;
+		data[axis] += centroid * area;
+		data[3 + axis] += n[axis];
+		meshCentroid[axis] += centroid * area;
+	  }
+	  meshArea += area;
+	}
+  }
+  if (meshArea <= 0.0) return;
+  for (int axis = 0; axis < 3; axis++) meshCentroid[axis] /= meshArea;
+
+  // clusters that face away from the middle of the mesh are the ones likely to
+  // occlude the rest, so draw those first
+  for (size_t c = 0; c < clusters.size(); c++) {
+	float *data = &clusterData[c * 6];
+	float normalLength = std::sqrt(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+	float clusterArea = 0.5f * normalLength;
+	if (normalLength <= 0.0f || clusterArea <= 0.0f) continue;
+
+	float key = 0.0f;
+	for (int axis = 0; axis < 3; axis++) {
+	  float offset = data[axis] / clusterArea - static_cast<float>(meshCentroid[axis]);
+	  key += offset * (data[3 + axis] / normalLength);
+	}
+	clusters[c].sortKey = key;
+  }
+
+  std::stable_sort(clusters.begin(), clusters.end(),
+				   [](const TriangleCluster &a, const TriangleCluster &b) { return a.sortKey > b.sortKey; });
+
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  for (const auto &cluster : clusters) {
+	output.insert(output.end(),
+				  indices.begin() + cluster.first * 3,
+				  indices.begin() + (cluster.first + cluster.count) * 3);
+  }
+  indices.swap(output);
+}
+
+/* ============================== Vertex Fetch ============================== */
+
+std::vector<uint32_t> optimizeVertexFetch(std::vector<uint32_t> &indices, size_t vertexCount,
+										  size_t &usedVertexCount) {
+  std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+  uint32_t next = 0;
+  for (uint32_t &index : indices) {
+	if (remap[index] == UINT32_MAX) remap[index] = next++;
+	index = remap[index];
+  }
+  usedVertexCount = next;
+  return remap;
+}
+
+/* ============================== Simplification ============================== */
+
+// symmetric 4x4 matrix, plus the summed weight so that evaluating gives a squared distance
+struct Quadric {
+  double 	a00, a01, a02, a03;
+  double 		 a11, a12, a13;
+  double 			  a22, a23;
+  double 				   a33;
+  double 	weight;
+};
+
+static void addQuadric(Quadric &q, const Quadric &other) {
+  q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02; q.a03 += other.a03;
+  q.a11 += other.a11; q.a12 += other.a12; q.a13 += other.a13;
+  q.a22 += other.a22; q.a23 += other.a23;
+  q.a33 += other.a33;
+  q.weight += other.weight;
+}
+
+static double evaluateQuadric(const Quadric &q, const float *p) {
+  double x = p[0], y = p[1], z = p[2];
+  double error = q.a00 * x * x + 2 * q.a01 * x * y + 2 * q.a02 * x * z + 2 * q.a03 * x
+	+ q.a11 * y * y + 2 * q.a12 * y * z + 2 * q.a13 * y
+	+ q.a22 * z * z + 2 * q.a23 * z
+	+ q.a33;
+  return q.weight > 0.0 ? std::fabs(error) / q.weight : 0.0;
+}
+
+static void triangleNormal(const float *a, const float *b, const float *c, double n[3]) {
+  double e0[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+  double e1[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+  n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+  n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+  n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+struct Collapse {
+  uint32_t 	from;
+  uint32_t 	to;
+  double 	cost;
+};
+
+std::vector<uint32_t> simplifyMesh(const std::vector<uint32_t> &indices,
+								   const float *positions, size_t positionStride,
+								   size_t vertexCount, size_t targetIndexCount,
+								   float &resultError) {
+  auto position = [&](uint32_t v) -> const float * {
+	return reinterpret_cast<const float *>(reinterpret_cast<const char *>(positions) + v * positionStride);
+  };
+
+  // weld by position so that uv seams show up as vertices sharing a position
+  std::vector<uint32_t> weld(vertexCount);
+  std::vector<uint32_t> copies(vertexCount, 0);
+  {
+	std::unordered_map<std::string, uint32_t> firstAtPosition;
+	for (uint32_t v = 0; v < vertexCount; v++) {
+	  std::string key(reinterpret_cast<const char *>(position(v)), sizeof(float) * 3);
+	  weld[v] = firstAtPosition.emplace(key, v).first->second;
+	  copies[weld[v]]++;
+	}
+  }
+
+  std::vector<bool> locked(vertexCount, false);
+  for (uint32_t v = 0; v < vertexCount; v++) {
+	if (copies[weld[v]] > 1) locked[v] = true;
+  }
+
+  // edges that don't have exactly two triangles are borders (or worse), leave them alone
+  std::unordered_map<uint64_t, uint32_t> edgeTriangles;
+  for (size_t i = 0; i < indices.size(); i += 3) {
+	for (int k = 0; k < 3; k++) {
+	  uint64_t a = weld[indices[i + k]], b = weld[indices[i + (k + 1) % 3]];
+	  edgeTriangles[a < b ? (a << 32) | b : (b << 32) | a]++;
+	}
+  }
+  for (size_t i = 0; i < indices.size(); i += 3) {
+	for (int k = 0; k < 3; k++) {
+	  uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+	  uint64_t wa = weld[a], wb = weld[b];
+	  if (edgeTriangles[wa < wb ? (wa << 32) | wb : (wb << 32) | wa] != 2) {
+		locked[a] = true;
+		locked[b] = true;
+	  }
+	}
+  }
+
+  std::vector<Quadric> quadrics(vertexCount, Quadric{});
+  for (size_t i = 0; i < indices.size(); i += 3) {
+	const float *p0 = position(indices[i]);
+	double n[3];
+	triangleNormal(p0, position(indices[i + 1]), position(indices[i + 2]), n);
+	double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+	if (length <= 0.0) continue;
+
+	double area = 0.5 * length;
+	double a = n[0] / length, b = n[1] / length, c = n[2] / length;
+	double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+	Quadric plane {
+	  a * a * area, a * b * area, a * c * area, a * d * area,
+	  b * b * area, b * c * area, b * d * area,
+	  c * c * area, c * d * area,
+	  d * d * area,
+	  area,
+	};
+	for (int k = 0; k < 3; k++) addQuadric(quadrics[indices[i + k]], plane);
+  }
+
+  std::vector<uint32_t> result = indices;
+  double maxError = 0.0;
+
+  std::vector<uint32_t> adjacencyOffset, adjacency;
+  std::vector<Collapse> collapses;
+  std::vector<uint32_t> remap(vertexCount);
+  std::vector<bool> touched(vertexCount);
+
+  // collapse in passes: pick the cheapest non-overlapping collapses, apply them, rebuild
+  while (result.size() > targetIndexCount) {
+	size_t triangleCount = result.size() / 3;
+
+	adjacencyOffset.assign(vertexCount + 1, 0);
+	for (uint32_t index : result) adjacencyOffset[index + 1]++;
+	for (size_t v = 0; v < vertexCount; v++) adjacencyOffset[v + 1] += adjacencyOffset[v];
+	adjacency.resize(result.size());
+	{
+	  std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	  for (size_t t = 0; t < triangleCount; t++) {
+		for (int k = 0; k < 3; k++) adjacency[fill[result[t * 3 + k]]++] = static_cast<uint32_t>(t);
+	  }
+	}
+
+	// cheapest collapse for every vertex that can move
+	std::vector<Collapse> best(vertexCount, Collapse{ 0, 0, -1.0 });
+	for (size_t t = 0; t < triangleCount; t++) {
+	  for (int k = 0; k < 3; k++) {
+		for (int direction = 1; direction <= 2; direction++) {
+		  uint32_t from = result[t * 3 + k], to = result[t * 3 + (k + direction) % 3];
+		  if (locked[from]) continue;
+
+		  Quadric q = quadrics[from];
+		  addQuadric(q, quadrics[to]);
+		  double cost = evaluateQuadric(q, position(to));
+		  if (best[from].cost < 0.0 || cost < best[from].cost) best[from] = Collapse{ from, to, cost };
+		}
+	  }
+	}
+
+	collapses.clear();
+	for (const auto &collapse : best) {
+	  if (collapse.cost >= 0.0) collapses.push_back(collapse);
+	}
+	std::sort(collapses.begin(), collapses.end(),
+			  [](const Collapse &a, const Collapse &b) { return a.cost < b.cost; });
+
+	// each collapse removes about two triangles
+	size_t collapsesWanted = (result.size() - targetIndexCount) / 6 + 1;
+	size_t collapsed = 0;
+	for (uint32_t v = 0; v < vertexCount; v++) remap[v] = v;
+	std::fill(touched.begin(), touched.end(), false);
+
+	for (const auto &collapse : collapses) {
+	  if (collapsed >= collapsesWanted) break;
+	  if (touched[collapse.from] || touched[collapse.to]) continue;
+
+	  // reject collapses that would flip a triangle around the moved vertex
+	  bool flips = false;
+	  for (uint32_t i = adjacencyOffset[collapse.from]; i < adjacencyOffset[collapse.from + 1] && !flips; i++) {
+		const uint32_t *triangle = &result[adjacency[i] * 3];
+		if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) continue;
+
+		const float *before[3], *after[3];
+		for (int k = 0; k < 3; k++) {
+		  before[k] = position(triangle[k]);
+		  after[k] = triangle[k] == collapse.from ? position(collapse.to) : before[k];
+		}
+		double n0[3], n1[3];
+		triangleNormal(before[0], before[1], before[2], n0);
+		triangleNormal(after[0], after[1], after[2], n1);
+		flips = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0;
+	  }
+	  if (flips) continue;
+
+	  // neighbours are frozen for the rest of the pass so the flip test above stays valid
+	  for (uint32_t i = adjacencyOffset[collapse.from]; i < adjacencyOffset[collapse.from + 1]; i++) {
+		const uint32_t *triangle = &result[adjacency[i] * 3];
+		for (int k = 0; k < 3; k++) touched[triangle[k]] = true;
+	  }
+
+	  remap[collapse.from] = collapse.to;
+	  addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+	  maxError = std::max(maxError, collapse.cost);
+	  collapsed++;
+	}
+
+	if (collapsed == 0) break;
+
+	size_t written = 0;
+	for (size_t t = 0; t < triangleCount; t++) {
+	  uint32_t a = remap[result[t * 3]], b = remap[result[t * 3 + 1]], c = remap[result[t * 3 + 2]];
+	  if (a == b || b == c || c == a) continue;
+	  result[written++] = a;
+	  result[written++] = b;
+	  result[written++] = c;
+	}
+	result.resize(written);
+  }
+
+  resultError = static_cast<float>(std::sqrt(maxError));
+  return result;
+}
@@ -0,0 +1,58 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+								  Mesh Optimizer
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// NOTE: everything in here works on indexed triangle lists and knows nothing about
+// Vertex or vulkan, so that it can be shared by the loader and any offline tools.
+
+const uint32_t ACMR_CACHE_SIZE = 16; // FIFO, roughly what desktop GPUs behave like
+
+// average cache miss ratio: transformed vertices per triangle (0.5 is ideal, 3 is worst)
+float 					computeACMR(const std::vector<uint32_t> &indices, size_t vertexCount,
+									uint32_t cacheSize = ACMR_CACHE_SIZE);
+
+// reorders triangles for post transform cache hits (Forsyth, "Linear-Speed Vertex
+// Cache Optimisation")
+void 					optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount);
+
+// reorders clusters of cache-optimized triangles so that outward facing ones draw first.
+// cluster boundaries are where the cache goes cold anyway, so ACMR barely moves.
+// positions are xyz floats, positionStride is in bytes.
+void					optimizeOverdraw(std::vector<uint32_t> &indices,
+										 const float *positions, size_t positionStride,
+										 size_t vertexCount);
+
+// edge collapse simplification (Garland & Heckbert quadrics, collapsing onto existing
+// vertices so every level can share one vertex buffer). Stops at targetIndexCount or when
+// nothing else can collapse. Vertices on borders and uv seams are never moved.
+// resultError is the largest collapse error, as a distance in the units of positions.
+std::vector<uint32_t>	simplifyMesh(const std::vector<uint32_t> &indices,
+									 const float *positions, size_t positionStride,
+									 size_t vertexCount, size_t targetIndexCount,
+									 float &resultError);
+
+// returns remap[oldVertex] = newVertex, ordered by first use in indices. Indices are
+// rewritten in place. Unused vertices are remapped to UINT32_MAX.
+std::vector<uint32_t>	optimizeVertexFetch(std::vector<uint32_t> &indices, size_t vertexCount,
+											size_t &usedVertexCount);
+
+template<typename T>
+std::vector<T> remapVertices(const std::vector<T> &vertices, const std::vector<uint32_t> &remap,
+							 size_t usedVertexCount) {
+  std::vector<T> remapped(usedVertexCount);
+  for (size_t i = 0; i < vertices.size(); i++) {
+	if (remap[i] != UINT32_MAX) remapped[remap[i]] = vertices[i];
+  }
+  return remapped;
+}
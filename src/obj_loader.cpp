@@ -0,0 +1,339 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+									 OBJ Loader
+*/
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "obj_loader.hh"
+
+/* ================================ Numbers ================================ */
+
+static bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+static bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char *skipSpaces(const char *p, const char *end) {
+  while (p < end && isSpace(*p)) p++;
+  return p;
+}
+
+// SWAR digit parsing (eight ascii digits in a uint64_t, see simdjson's
+// parse_eight_digits_unrolled). Coordinates are mostly 6 or 7 digits so this only
+// kicks in on long ones, the loop below does the rest a digit at a time.
+static bool isEightDigits(uint64_t chunk) {
+  return (((chunk & 0xF0F0F0F0F0F0F0F0ull) |
+		   (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull);
+}
+
+static uint32_t parseEightDigits(uint64_t chunk) {
+  const uint64_t mask = 0x000000FF000000FFull;
+  const uint64_t mul1 = 100 + (1000000ull << 32);
+  const uint64_t mul2 = 1 + (10000ull << 32);
+  chunk -= 0x3030303030303030ull;
+  chunk = (chunk * 10) + (chunk >> 8);
+  return static_cast<uint32_t>((((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32);
+}
+
+// accumulates digits into mantissa while it has room (leading zeros cost nothing), counting
+// the digits that went in and the ones that didn't fit
+static const char *parseDigits(const char *p, const char *end, uint64_t &mantissa,
+							   int &accumulated, int &dropped) {
+  const uint64_t ROOM_FOR_EIGHT = 100000000000ull;	 // mantissa * 1e8 + 99999999 < 2^64
+  const uint64_t ROOM_FOR_ONE = 1000000000000000000ull; // mantissa * 10 + 9 < 2^64
+  if constexpr (std::endian::native == std::endian::little) {
+	while (end - p >= 8 && mantissa < ROOM_FOR_EIGHT) {
+	  uint64_t chunk;
+	  std::memcpy(&chunk, p, 8);
+	  if (!isEightDigits(chunk)) break;
+	  mantissa = mantissa * 100000000ull + parseEightDigits(chunk);
+	  accumulated += 8;
+	  p += 8;
+	}
+  }
+  for (; p < end && isDigit(*p); p++) {
+	if (mantissa < ROOM_FOR_ONE) {
+	  mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+	  accumulated++;
+	} else {
+	  dropped++;
+	}
+  }
+  return p;
+}
+
+// exact powers of ten a double holds, so mantissa * or / one of these rounds only once
+static const double POWERS_OF_TEN[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// nullptr if there's no number at p
+const char *parseObjFloat(const char *p, const char *end, float &value) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+  uint64_t mantissa = 0;
+  int accumulated = 0, dropped = 0;
+  const char *start = p;
+  p = parseDigits(p, end, mantissa, accumulated, dropped);
+  int exponent = dropped; // integer digits that didn't fit still count
+
+  if (p < end && *p == '.') {
+	int fractionAccumulated = 0, fractionDropped = 0;
+	p = parseDigits(p + 1, end, mantissa, fractionAccumulated, fractionDropped);
+	exponent -= fractionAccumulated;
+  }
+  if (p == start || (p == start + 1 && *start == '.')) return nullptr;
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+	const char *q = p + 1;
+	bool negativeExponent = false;
+	if (q < end && (*q == '-' || *q == '+')) negativeExponent = *q++ == '-';
+	if (q < end && isDigit(*q)) {
+	  int written = 0;
+	  for (; q < end && isDigit(*q); q++) written = std::min(written * 10 + (*q - '0'), 1000);
+	  exponent += negativeExponent ? -written : written;
+	  p = q;
+	}
+  }
+
+  double result = static_cast<double>(mantissa);
+  if (mantissa == 0) {
+	result = 0.0;
+  } else if (exponent >= 0 && exponent <= 22) {
+	result *= POWERS_OF_TEN[exponent];
+  } else if (exponent < 0 && exponent >= -22) {
+	result /= POWERS_OF_TEN[-exponent];
+  } else {
+	result *= std::pow(10.0, exponent);
+  }
+  value = static_cast<float>(negative ? -result : result);
+  return p;
+}
+
+static const char *parseInt(const char *p, const char *end, int64_t &value) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+  if (p >= end || !isDigit(*p)) return nullptr;
+
+  value = 0;
+  for (; p < end && isDigit(*p); p++) value = std::min<int64_t>(value * 10 + (*p - '0'), INT32_MAX);
+  if (negative) value = -value;
+  return p;
+}
+
+/* ================================ Chunks ================================ */
+
+// Indices are resolved once every chunk is done, since relative (negative) ones and the
+// positions before a chunk depend on the chunks in front of it. Until then absolute
+// indices are stored 0 based and relative ones as OBJ_RELATIVE + their index within the chunk.
+const int64_t OBJ_RELATIVE = int64_t(1) << 40;
+const int64_t OBJ_NO_TEXCOORD = -1;
+
+struct ObjChunk {
+  const char *				begin;
+  const char *				end;
+  std::vector<float>		positions; // xyz
+  std::vector<float>		texCoords; // uv
+  std::vector<int64_t>		corners;   // position, texcoord pairs, three per triangle
+  const char *				errorAt = nullptr;
+  std::string				error;
+};
+
+static int64_t encodeIndex(int64_t index, size_t chunkCount) {
+  if (index > 0) return index - 1;
+  return OBJ_RELATIVE + static_cast<int64_t>(chunkCount) + index; // 0 is caught by the caller
+}
+
+static const char *parseFace(ObjChunk &chunk, const char *p, const char *lineEnd,
+							 std::vector<int64_t> &polygon) {
+  polygon.clear();
+  while (true) {
+	p = skipSpaces(p, lineEnd);
+	if (p >= lineEnd) break;
+
+	int64_t position, texCoord = 0, normal;
+	p = parseInt(p, lineEnd, position);
+	if (p == nullptr || position == 0) return nullptr;
+	if (p < lineEnd && *p == '/') {
+	  p++;
+	  if (p < lineEnd && *p != '/') {
+		p = parseInt(p, lineEnd, texCoord);
+		if (p == nullptr || texCoord == 0) return nullptr;
+	  }
+	  if (p < lineEnd && *p == '/') {
+		p = parseInt(p + 1, lineEnd, normal); // normals aren't used, just skipped
+		if (p == nullptr) return nullptr;
+	  }
+	}
+	if (p < lineEnd && !isSpace(*p)) return nullptr;
+
+	polygon.push_back(encodeIndex(position, chunk.positions.size() / 3));
+	polygon.push_back(texCoord == 0 ? OBJ_NO_TEXCOORD : encodeIndex(texCoord, chunk.texCoords.size() / 2));
+  }
+  if (polygon.size() < 6) return nullptr;
+
+  for (size_t corner = 2; corner < polygon.size() / 2; corner++) {
+	chunk.corners.insert(chunk.corners.end(), polygon.begin(), polygon.begin() + 2);
+	chunk.corners.insert(chunk.corners.end(), polygon.begin() + 2 * (corner - 1), polygon.begin() + 2 * (corner + 1));
+  }
+  return p;
+}
+
+static void parseChunk(ObjChunk &chunk) {
+  std::vector<int64_t> polygon;
+  const char *p = chunk.begin;
+  while (p < chunk.end) {
+	const char *lineEnd = static_cast<const char *>(std::memchr(p, '\n', chunk.end - p));
+	if (lineEnd == nullptr) lineEnd = chunk.end;
+
+	const char *q = skipSpaces(p, lineEnd);
+	const char *parsed = q;
+	if (lineEnd - q >= 2 && q[0] == 'v' && isSpace(q[1])) {
+	  float xyz[3];
+	  parsed = q + 1;
+	  for (int axis = 0; axis < 3 && parsed != nullptr; axis++) {
+		parsed = parseObjFloat(skipSpaces(parsed, lineEnd), lineEnd, xyz[axis]);
+	  }
+	  if (parsed != nullptr) chunk.positions.insert(chunk.positions.end(), xyz, xyz + 3);
+	} else if (lineEnd - q >= 3 && q[0] == 'v' && q[1] == 't' && isSpace(q[2])) {
+	  float uv[2] = { 0.0f, 0.0f };
+	  parsed = parseObjFloat(skipSpaces(q + 2, lineEnd), lineEnd, uv[0]);
+	  const char *second = parsed ? skipSpaces(parsed, lineEnd) : nullptr;
+	  if (second != nullptr && second < lineEnd) parsed = parseObjFloat(second, lineEnd, uv[1]);
+	  if (parsed != nullptr) chunk.texCoords.insert(chunk.texCoords.end(), uv, uv + 2);
+	} else if (lineEnd - q >= 2 && q[0] == 'f' && isSpace(q[1])) {
+	  parsed = parseFace(chunk, q + 1, lineEnd, polygon);
+	}
+	// everything else (comments, vn, o, g, s, usemtl, mtllib, l) is skipped
+
+	if (parsed == nullptr) {
+	  chunk.errorAt = p;
+	  chunk.error = std::string(p, std::find(p, lineEnd, '\r'));
+	  return;
+	}
+	p = lineEnd + 1;
+  }
+}
+
+/* ================================ Stitching ================================ */
+
+uint64_t hashObjVertex(const ObjVertex &vertex) {
+  const float values[5] = { vertex.pos[0], vertex.pos[1], vertex.pos[2], vertex.texCoord[0], vertex.texCoord[1] };
+  uint64_t hash = 0;
+  for (float value : values) {
+	uint32_t bits = 0;
+	if (value != 0.0f) std::memcpy(&bits, &value, 4); // -0 == 0, so they have to hash the same
+	hash = (hash ^ bits) * 0x9E3779B97F4A7C15ull;
+	hash ^= hash >> 29;
+  }
+  // splitmix64 finalizer, so every input bit reaches the low bits we index with
+  hash ^= hash >> 30;
+  hash *= 0xBF58476D1CE4E5B9ull;
+  hash ^= hash >> 27;
+  hash *= 0x94D049BB133111EBull;
+  hash ^= hash >> 31;
+  return hash;
+}
+
+static bool sameObjVertex(const ObjVertex &a, const ObjVertex &b) {
+  return a.pos[0] == b.pos[0] && a.pos[1] == b.pos[1] && a.pos[2] == b.pos[2] &&
+	a.texCoord[0] == b.texCoord[0] && a.texCoord[1] == b.texCoord[1];
+}
+
+static int64_t resolveIndex(int64_t encoded, int64_t chunkStart, int64_t count, const char *name) {
+  int64_t index = encoded >= OBJ_RELATIVE / 2 ? chunkStart + (encoded - OBJ_RELATIVE) : encoded;
+  if (index < 0 || index >= count) {
+	throw std::runtime_error(std::string(name) + ": face index out of range");
+  }
+  return index;
+}
+
+void loadObj(const uint8_t *data, size_t size, const char *name, ObjMesh &mesh, unsigned threadCount) {
+  const char *text = reinterpret_cast<const char *>(data);
+
+  if (threadCount == 0) threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+  size_t chunkCount = std::clamp<size_t>(size / OBJ_MIN_CHUNK_BYTES, 1, threadCount);
+
+  std::vector<ObjChunk> chunks(chunkCount);
+  const char *chunkBegin = text;
+  for (size_t i = 0; i < chunkCount; i++) {
+	const char *chunkEnd = text + size;
+	if (i + 1 < chunkCount) {
+	  chunkEnd = std::max(text + size * (i + 1) / chunkCount, chunkBegin);
+	  const char *newline = static_cast<const char *>(std::memchr(chunkEnd, '\n', text + size - chunkEnd));
+	  chunkEnd = newline ? newline + 1 : text + size;
+	}
+	chunks[i].begin = chunkBegin;
+	chunks[i].end = chunkEnd;
+	chunkBegin = chunkEnd;
+  }
+
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < chunkCount; i++) workers.emplace_back(parseChunk, std::ref(chunks[i]));
+  parseChunk(chunks[0]);
+  for (auto &worker : workers) worker.join();
+
+  for (const ObjChunk &chunk : chunks) {
+	if (chunk.errorAt == nullptr) continue;
+	size_t line = 1 + std::count(text, chunk.errorAt, '\n');
+	throw std::runtime_error(std::string(name) + ":" + std::to_string(line) + ": can't parse \"" + chunk.error + "\"");
+  }
+
+  std::vector<float> positions, texCoords;
+  std::vector<int64_t> positionStarts, texCoordStarts;
+  size_t cornerCount = 0;
+  for (const ObjChunk &chunk : chunks) {
+	positionStarts.push_back(positions.size() / 3);
+	texCoordStarts.push_back(texCoords.size() / 2);
+	positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+	texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+	cornerCount += chunk.corners.size() / 2;
+  }
+  int64_t positionCount = positions.size() / 3, texCoordCount = texCoords.size() / 2;
+
+  // open addressing, at most half full since there can't be more vertices than corners
+  size_t tableSize = std::bit_ceil(std::max<size_t>(cornerCount * 2, 16));
+  std::vector<uint32_t> table(tableSize, 0); // vertex index + 1, 0 is empty
+
+  mesh.vertices.clear();
+  mesh.indices.clear();
+  mesh.indices.reserve(cornerCount);
+  for (size_t c = 0; c < chunkCount; c++) {
+	const std::vector<int64_t> &corners = chunks[c].corners;
+	for (size_t i = 0; i < corners.size(); i += 2) {
+	  ObjVertex vertex {};
+	  int64_t position = resolveIndex(corners[i], positionStarts[c], positionCount, name);
+	  std::memcpy(vertex.pos, &positions[position * 3], sizeof(vertex.pos));
+	  if (corners[i + 1] != OBJ_NO_TEXCOORD) {
+		int64_t texCoord = resolveIndex(corners[i + 1], texCoordStarts[c], texCoordCount, name);
+		std::memcpy(vertex.texCoord, &texCoords[texCoord * 2], sizeof(vertex.texCoord));
+	  }
+
+	  size_t slot = hashObjVertex(vertex) & (tableSize - 1);
+	  while (table[slot] != 0 && !sameObjVertex(mesh.vertices[table[slot] - 1], vertex)) {
+		slot = (slot + 1) & (tableSize - 1);
+	  }
+	  if (table[slot] == 0) {
+		mesh.vertices.push_back(vertex);
+		table[slot] = static_cast<uint32_t>(mesh.vertices.size());
+	  }
+	  mesh.indices.push_back(table[slot] - 1);
+	}
+  }
+}
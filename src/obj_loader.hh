@@ -0,0 +1,42 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+									 OBJ Loader
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// NOTE: like mesh_optimizer.hh this knows nothing about Vertex or vulkan, so tools
+// (tools/obj_bench.cpp) can run the same loader as the game.
+
+// Only what Mesh uses: positions and texture coordinates. Normals, groups, materials
+// and the rest are skipped. texCoord is as written in the file (v points up).
+struct ObjVertex {
+  float						pos[3];
+  float						texCoord[2]; // 0, 0 for corners without one
+};
+
+struct ObjMesh {
+  std::vector<ObjVertex>	vertices; // unique by value, like the old unordered_map<Vertex> dedup
+  std::vector<uint32_t>		indices;  // triangle list, polygons are fanned
+};
+
+const size_t OBJ_MIN_CHUNK_BYTES = 256 * 1024; // smaller files aren't worth a thread
+
+// Parses the file in line aligned chunks, one thread per chunk (threadCount 0 means one
+// per hardware thread), then stitches the chunks and dedups corners on one thread.
+// Throws std::runtime_error on malformed files, name is only used in the message.
+void						loadObj(const uint8_t *data, size_t size, const char *name,
+									ObjMesh &mesh, unsigned threadCount = 0);
+
+// the pieces loadObj uses, exposed for tools/obj_bench.cpp to check against strtof and
+// the old std::hash<Vertex>
+const char *				parseObjFloat(const char *p, const char *end, float &value); // nullptr if no number
+uint64_t					hashObjVertex(const ObjVertex &vertex);
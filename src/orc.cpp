@@ -26,6 +26,11 @@ Orc::Orc(skyVec3 position, AssetStore &assetStore)
   type = Orc_e;
 }
 
+Orc::~Orc() {
+  texture->relinquish();
+  mesh->relinquish();
+}
+
 GameOps Orc::update(std::chrono::microseconds dt, GameState &gameState){
   GameOps ops;
 
@@ -0,0 +1,109 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+									 Profiler
+*/
+
+#include <algorithm>
+#include <cstdio>
+
+#include "profiler.hh"
+
+bool 								Profiler::enabled = false;
+ProfileClock::time_point			Profiler::frameStart;
+ProfileClock::time_point			Profiler::lastReport;
+uint64_t							Profiler::frames = 0;
+ProfileStat							Profiler::frameTime;
+ProfileStat							Profiler::gpuFrameTime;
+std::map<std::string, ProfileStat>	Profiler::zones;
+std::map<std::string, ProfileStat>	Profiler::counters;
+
+static void accumulate(ProfileStat &stat, double value) {
+  stat.total += value;
+  stat.max = std::max(stat.max, value);
+  stat.samples++;
+}
+
+void Profiler::setEnabled(bool enable) {
+  enabled = enable;
+  lastReport = ProfileClock::now();
+}
+
+bool Profiler::isEnabled() {
+  return enabled;
+}
+
+void Profiler::beginFrame() {
+  if (!enabled) return;
+  frameStart = ProfileClock::now();
+}
+
+void Profiler::endFrame() {
+  if (!enabled) return;
+
+  auto now = ProfileClock::now();
+  std::chrono::duration<double, std::milli> elapsed = now - frameStart;
+  accumulate(frameTime, elapsed.count());
+  frames++;
+
+  if (now - lastReport >= PROFILE_REPORT_INTERVAL) {
+	report();
+	lastReport = now;
+  }
+}
+
+void Profiler::recordZone(const char *name, double ms) {
+  if (!enabled) return;
+  accumulate(zones[name], ms);
+}
+
+void Profiler::addCounter(const char *name, double value) {
+  if (!enabled) return;
+  accumulate(counters[name], value);
+}
+
+void Profiler::recordGpuFrame(double ms) {
+  if (!enabled) return;
+  accumulate(gpuFrameTime, ms);
+}
+
+// NOTE: zones are averaged per sample, counters are averaged per frame
+// (so a counter bumped once per draw reads as "per frame" totals).
+void Profiler::report() {
+  if (frames == 0) return;
+
+  std::printf("\n /* ------- PROFILE (%llu frames) ------- */ \n",
+			  static_cast<unsigned long long>(frames));
+  std::printf("%-32s avg %9.3f ms   max %9.3f ms\n", "frame",
+			  frameTime.total / frameTime.samples, frameTime.max);
+
+  // NOTE: the gpu times are from frames a couple behind (see Renderer::readGpuFrameQueries),
+  // close enough at one report a second. A gpu that's busy for most of the cpu's frame is
+  // what's holding us back.
+  if (gpuFrameTime.samples > 0) {
+	double cpuAvg = frameTime.total / frameTime.samples;
+	double gpuAvg = gpuFrameTime.total / gpuFrameTime.samples;
+	std::printf("%-32s avg %9.3f ms   max %9.3f ms   (%s bound)\n", "gpu frame",
+				gpuAvg, gpuFrameTime.max, gpuAvg >= 0.9 * cpuAvg ? "gpu" : "cpu");
+  }
+
+  for (auto& [name, stat] : zones) {
+	std::printf("%-32s avg %9.3f ms   max %9.3f ms   (%llu samples)\n", name.c_str(),
+				stat.total / stat.samples, stat.max,
+				static_cast<unsigned long long>(stat.samples));
+  }
+
+  for (auto& [name, stat] : counters) {
+	std::printf("%-32s avg %12.1f / frame   max %12.1f\n", name.c_str(),
+				stat.total / frames, stat.max);
+  }
+
+  frames = 0;
+  frameTime = {};
+  gpuFrameTime = {};
+  zones.clear();
+  counters.clear();
+}
@@ -0,0 +1,68 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+									 Profiler
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+typedef std::chrono::high_resolution_clock ProfileClock;
+
+// NOTE: this is deliberately dumb. Zones and counters are accumulated by name
+// and dumped to stdout once every PROFILE_REPORT_INTERVAL. If we ever need
+// more than that we should hook up tracy or something similar instead.
+const std::chrono::seconds PROFILE_REPORT_INTERVAL(1);
+
+struct ProfileStat {
+  double 					total = 0.0;
+  double					max = 0.0;
+  uint64_t 					samples = 0;
+};
+
+class Profiler {
+public:
+  static void				setEnabled(bool enabled);
+  static bool				isEnabled();
+  static void				beginFrame();
+  static void				endFrame();
+  static void				recordZone(const char *name, double ms);
+  static void				addCounter(const char *name, double value);
+  static void				recordGpuFrame(double ms); // render pass time from the timestamp queries
+
+private:
+  static void				report();
+
+  static bool				enabled;
+  static ProfileClock::time_point	frameStart;
+  static ProfileClock::time_point	lastReport;
+  static uint64_t			frames;
+  static ProfileStat		frameTime;
+  static ProfileStat		gpuFrameTime;
+  static std::map<std::string, ProfileStat> zones;
+  static std::map<std::string, ProfileStat> counters;
+};
+
+// Times the enclosing scope and records it under name (use string literals)
+class ProfileZone {
+public:
+  ProfileZone(const char *name) : name(name), start(ProfileClock::now()) {}
+  ~ProfileZone() {
+	std::chrono::duration<double, std::milli> elapsed = ProfileClock::now() - start;
+	Profiler::recordZone(name, elapsed.count());
+  }
+private:
+  const char *				name;
+  ProfileClock::time_point	start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone_, __LINE__)(name)
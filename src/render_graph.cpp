@@ -0,0 +1,310 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+								   Render Graph
+*/
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include "render_graph.hh"
+
+const VkAccessFlags RENDER_GRAPH_WRITES = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+  VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+const VkImageUsageFlags RENDER_GRAPH_ATTACHMENT_USAGE = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+  VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+RenderGraphState renderGraphState(RenderGraphAccess access) {
+  switch (access) {
+  case AccessColorAttachment:
+	return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			 VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT };
+  case AccessDepthAttachment:
+	return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+  case AccessSampled:
+	return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+  case AccessTransferSrc:
+	return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT };
+  case AccessTransferDst:
+	return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT };
+  case AccessPresent:
+	return { VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0 };
+  }
+  throw std::invalid_argument("unknown render graph access!");
+}
+
+void RenderGraph::init(VkDevice device, VkPhysicalDevice physicalDevice, RenderGraphRetire retire) {
+  this->device = device;
+  this->physicalDevice = physicalDevice;
+  this->retire = retire;
+}
+
+void RenderGraph::destroy() {
+  releaseTransients(true);
+}
+
+// readyStage is where whatever made the image available is waited on, for a swapchain
+// image that's the stage the acquire semaphore waits at
+RenderGraphImage RenderGraph::importImage(VkImage image, VkImageView view, VkImageAspectFlags aspect,
+										  uint32_t mipLevels, VkPipelineStageFlags readyStage,
+										  RenderGraphAccess finalAccess) {
+  images.push_back(Image{
+	  .image = image,
+	  .view = view,
+	  .aspect = aspect,
+	  .mipLevels = mipLevels,
+	  .state = { VK_IMAGE_LAYOUT_UNDEFINED, readyStage, 0 },
+	  .imported = true,
+	  .transient = 0,
+	  .finalAccess = finalAccess,
+	});
+  return static_cast<RenderGraphImage>(images.size() - 1);
+}
+
+RenderGraphImage RenderGraph::createTransient(const RenderGraphTransientDesc &desc) {
+  declared.push_back(Transient{ .desc = desc, .firstPass = UINT32_MAX, .lastPass = 0 });
+  images.push_back(Image{
+	  .image = VK_NULL_HANDLE,
+	  .view = VK_NULL_HANDLE,
+	  .aspect = desc.aspect,
+	  .mipLevels = 1,
+	  .state = {},
+	  .imported = false,
+	  .transient = static_cast<uint32_t>(declared.size() - 1),
+	  .finalAccess = AccessColorAttachment, // transients are done with after their last pass
+	});
+  return static_cast<RenderGraphImage>(images.size() - 1);
+}
+
+void RenderGraph::addPass(const char *name, std::vector<RenderGraphUse> uses,
+						  std::function<void(VkCommandBuffer)> record) {
+  uint32_t passIndex = static_cast<uint32_t>(passes.size());
+  for (const RenderGraphUse &use : uses) {
+	const Image &image = images[use.first];
+	if (image.imported) continue;
+	Transient &transient = declared[image.transient];
+	transient.firstPass = std::min(transient.firstPass, passIndex);
+	transient.lastPass = std::max(transient.lastPass, passIndex);
+  }
+  passes.push_back(Pass{ .name = name, .uses = std::move(uses), .record = std::move(record) });
+}
+
+VkImage RenderGraph::image(RenderGraphImage image) {
+  return images[image].image;
+}
+
+VkImageView RenderGraph::view(RenderGraphImage image) {
+  return images[image].view;
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer) {
+  allocateTransients();
+  for (Image &image : images) {
+	if (image.imported) continue;
+	image.image = transients[image.transient].image;
+	image.view = transients[image.transient].view;
+  }
+
+  std::vector<VkImageMemoryBarrier> barriers;
+  auto flush = [&](VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages) {
+	if (barriers.empty()) return;
+	vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr,
+						 static_cast<uint32_t>(barriers.size()), barriers.data());
+	barriers.clear();
+  };
+
+  for (Pass &pass : passes) {
+	VkPipelineStageFlags srcStages = 0, dstStages = 0;
+	for (const RenderGraphUse &use : pass.uses) {
+	  transition(images[use.first], renderGraphState(use.second), barriers, srcStages, dstStages);
+	}
+	flush(srcStages, dstStages);
+	pass.record(commandBuffer);
+  }
+
+  VkPipelineStageFlags srcStages = 0, dstStages = 0;
+  for (Image &image : images) {
+	if (image.imported) transition(image, renderGraphState(image.finalAccess), barriers, srcStages, dstStages);
+  }
+  flush(srcStages, dstStages);
+
+  images.clear();
+  passes.clear();
+  declared.clear();
+}
+
+// Read after read in the same layout needs no barrier, the stages just pile up so that
+// whatever writes next waits for all of them. Everything else gets one. Only writes have
+// to be made available, so only they go in srcAccessMask.
+void RenderGraph::transition(Image &image, RenderGraphState next, std::vector<VkImageMemoryBarrier> &barriers,
+							 VkPipelineStageFlags &srcStages, VkPipelineStageFlags &dstStages) {
+  RenderGraphState previous = image.state;
+  Block *block = image.imported ? nullptr : &blocks[transients[image.transient].block];
+  if (block && previous.layout == VK_IMAGE_LAYOUT_UNDEFINED) { // first use this frame
+	previous.stages = block->state.stages;
+	previous.access = block->state.access;
+  }
+
+  if (previous.layout == next.layout && !(previous.access & RENDER_GRAPH_WRITES) && !(next.access & RENDER_GRAPH_WRITES)) {
+	image.state.stages |= next.stages;
+	image.state.access |= next.access;
+  } else {
+	barriers.push_back(VkImageMemoryBarrier{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.srcAccessMask = previous.access & RENDER_GRAPH_WRITES,
+		.dstAccessMask = next.access,
+		.oldLayout = previous.layout,
+		.newLayout = next.layout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image.image,
+		.subresourceRange = { image.aspect, 0, image.mipLevels, 0, 1 },
+	  });
+	srcStages |= previous.stages;
+	dstStages |= next.stages;
+	image.state = next;
+  }
+  if (block) block->state = image.state;
+}
+
+// NOTE: the transients are rebuilt whenever anything about them changes, which in practice
+// is a resize or a new MSAA level. The old ones go through retire since frames in flight may
+// still use them.
+void RenderGraph::allocateTransients() {
+  bool same = declared.size() == transients.size();
+  for (size_t i = 0; same && i < declared.size(); i++) {
+	const Transient &a = declared[i], &b = transients[i];
+	same = a.desc.format == b.desc.format && a.desc.extent.width == b.desc.extent.width &&
+	  a.desc.extent.height == b.desc.extent.height && a.desc.samples == b.desc.samples &&
+	  a.desc.usage == b.desc.usage && a.desc.aspect == b.desc.aspect &&
+	  a.firstPass == b.firstPass && a.lastPass == b.lastPass;
+  }
+  if (same) return;
+
+  releaseTransients(false);
+  transients = declared;
+  transientGeneration++;
+  if (transients.empty()) return;
+
+  struct BlockPlan {
+	VkDeviceSize size;
+	uint32_t typeBits;
+	uint32_t lastPass;
+	bool lazy;
+  };
+  std::vector<BlockPlan> plans;
+  std::vector<VkMemoryRequirements> requirements(transients.size());
+
+  std::vector<size_t> order(transients.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+	return transients[a].firstPass < transients[b].firstPass;
+  });
+
+  for (size_t i : order) {
+	Transient &transient = transients[i];
+	const RenderGraphTransientDesc &desc = transient.desc;
+	bool lazy = (desc.usage & ~RENDER_GRAPH_ATTACHMENT_USAGE) == 0;
+
+	VkImageCreateInfo imageInfo {
+	  .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+	  .imageType = VK_IMAGE_TYPE_2D,
+	  .format = desc.format,
+	  .extent = { desc.extent.width, desc.extent.height, 1 },
+	  .mipLevels = 1,
+	  .arrayLayers = 1,
+	  .samples = desc.samples,
+	  .tiling = VK_IMAGE_TILING_OPTIMAL,
+	  .usage = desc.usage | (lazy ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0),
+	  .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+	  .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+	};
+	if (vkCreateImage(device, &imageInfo, nullptr, &transient.image) != VK_SUCCESS) {
+	  throw std::runtime_error("failed to create transient image!");
+	}
+	vkGetImageMemoryRequirements(device, transient.image, &requirements[i]);
+
+	// the first block nothing in has a pass at or after this one's first
+	auto plan = std::find_if(plans.begin(), plans.end(), [&](const BlockPlan &plan) {
+	  return plan.lastPass < transient.firstPass && plan.lazy == lazy &&
+		(plan.typeBits & requirements[i].memoryTypeBits) != 0;
+	});
+	if (plan == plans.end()) {
+	  plans.push_back(BlockPlan{ .size = 0, .typeBits = ~0u, .lastPass = 0, .lazy = lazy });
+	  plan = plans.end() - 1;
+	}
+	plan->size = std::max(plan->size, requirements[i].size);
+	plan->typeBits &= requirements[i].memoryTypeBits;
+	plan->lastPass = transient.lastPass;
+	transient.block = static_cast<uint32_t>(plan - plans.begin());
+  }
+
+  blocks.resize(plans.size());
+  for (size_t i = 0; i < plans.size(); i++) {
+	VkMemoryAllocateInfo allocInfo {
+	  .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+	  .allocationSize = plans[i].size,
+	  .memoryTypeIndex = findMemoryType(plans[i].typeBits, plans[i].lazy),
+	};
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &blocks[i].memory) != VK_SUCCESS) {
+	  throw std::runtime_error("failed to allocate transient memory!");
+	}
+  }
+
+  // every transient starts at offset 0 of its block, they're never alive at the same time
+  for (Transient &transient : transients) {
+	vkBindImageMemory(device, transient.image, blocks[transient.block].memory, 0);
+
+	VkImageViewCreateInfo viewInfo {
+	  .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+	  .image = transient.image,
+	  .viewType = VK_IMAGE_VIEW_TYPE_2D,
+	  .format = transient.desc.format,
+	  .subresourceRange = { transient.desc.aspect & ~VK_IMAGE_ASPECT_STENCIL_BIT, 0, 1, 0, 1 },
+	};
+	if (vkCreateImageView(device, &viewInfo, nullptr, &transient.view) != VK_SUCCESS) {
+	  throw std::runtime_error("failed to create transient image view!");
+	}
+  }
+}
+
+void RenderGraph::releaseTransients(bool now) {
+  for (Transient &transient : transients) {
+	if (now) {
+	  vkDestroyImageView(device, transient.view, nullptr);
+	  vkDestroyImage(device, transient.image, nullptr);
+	} else {
+	  retire(transient.image, VK_NULL_HANDLE, transient.view);
+	}
+  }
+  for (Block &block : blocks) {
+	if (now) vkFreeMemory(device, block.memory, nullptr);
+	else retire(VK_NULL_HANDLE, block.memory, VK_NULL_HANDLE);
+  }
+  transients.clear();
+  blocks.clear();
+}
+
+// lazily allocated memory is only ever device local, so without it that's the fallback
+uint32_t RenderGraph::findMemoryType(uint32_t typeFilter, bool lazy) {
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+  std::vector<VkMemoryPropertyFlags> wanted { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT };
+  if (lazy) wanted.insert(wanted.begin(), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+  for (VkMemoryPropertyFlags properties : wanted) {
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+	  if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+		return i;
+	  }
+	}
+  }
+  throw std::runtime_error("failed to find a memory type for transient images!");
+}
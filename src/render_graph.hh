@@ -0,0 +1,138 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+								   Render Graph
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+// A small frame graph. Each frame the renderer declares the images it touches and the
+// passes that use them, then execute() records the passes in the order they were added
+// with the barriers between them worked out from what each pass said it does with each
+// image. Every barrier a pass needs goes out as one vkCmdPipelineBarrier, and so do the
+// transitions into each imported image's final access at the end.
+//
+// Imported images (the swapchain image, a texture being uploaded) are owned elsewhere and
+// start out UNDEFINED, so their contents are dropped. Transient images are owned by the
+// graph and only live inside a frame: they're allocated the first time they're declared
+// and kept while later frames declare the same thing. Attachment-only transients get
+// lazily allocated memory where the device has it (tile memory on mobile GPUs, so they
+// may never be backed at all), and transients whose passes don't overlap share memory.
+//
+// NOTE: passes aren't reordered or culled, adding them in the order they run is up to the
+// caller. That's all this renderer needs so far.
+
+typedef uint32_t RenderGraphImage; // a handle, only good for the frame it was declared in
+
+enum RenderGraphAccess {
+  AccessColorAttachment, 	// written as a color or resolve attachment
+  AccessDepthAttachment, 	// depth tested and written
+  AccessSampled, 			// read from a fragment shader
+  AccessTransferSrc,
+  AccessTransferDst,
+  AccessPresent, 			// only as an imported image's final access
+};
+
+// the layout, stages and memory accesses one RenderGraphAccess stands for
+struct RenderGraphState {
+  VkImageLayout 			layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  VkPipelineStageFlags 		stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+  VkAccessFlags 			access = 0;
+};
+
+RenderGraphState renderGraphState(RenderGraphAccess access);
+
+struct RenderGraphTransientDesc {
+  VkFormat 					format;
+  VkExtent2D 				extent;
+  VkSampleCountFlagBits 	samples;
+  VkImageUsageFlags 		usage;
+  VkImageAspectFlags 		aspect;
+};
+
+typedef std::pair<RenderGraphImage, RenderGraphAccess> RenderGraphUse;
+
+// something the graph can't use anymore but a frame in flight may still be reading,
+// see RenderGraph::retire
+typedef std::function<void(VkImage, VkDeviceMemory, VkImageView)> RenderGraphRetire;
+
+class RenderGraph {
+public:
+  // only needed with transients, a graph that only imports images never allocates anything
+  void 						init(VkDevice device, VkPhysicalDevice physicalDevice, RenderGraphRetire retire);
+  void 						destroy(); // frees the transients right away, the device has to be idle
+
+  RenderGraphImage 			importImage(VkImage image, VkImageView view, VkImageAspectFlags aspect,
+										uint32_t mipLevels, VkPipelineStageFlags readyStage,
+										RenderGraphAccess finalAccess);
+  RenderGraphImage 			createTransient(const RenderGraphTransientDesc &desc);
+  void 						addPass(const char *name, std::vector<RenderGraphUse> uses,
+									std::function<void(VkCommandBuffer)> record);
+  void 						execute(VkCommandBuffer commandBuffer); // and forgets this frame's declarations
+
+  VkImage 					image(RenderGraphImage image); // transients only have these once execute allocates them
+  VkImageView 				view(RenderGraphImage image);
+  uint64_t 					generation() { return transientGeneration; } // bumped whenever the transients are rebuilt
+
+private:
+  struct Image {
+	VkImage 				image;
+	VkImageView 			view;
+	VkImageAspectFlags 		aspect;
+	uint32_t 				mipLevels;
+	RenderGraphState 		state;
+	bool 					imported;
+	uint32_t 				transient; 	// index into transients
+	RenderGraphAccess 		finalAccess;
+  };
+
+  struct Pass {
+	const char 								*name;
+	std::vector<RenderGraphUse> 			uses;
+	std::function<void(VkCommandBuffer)> 	record;
+  };
+
+  // what the frame before asked for, first and last pass included, so the same frame
+  // again doesn't allocate anything
+  struct Transient {
+	RenderGraphTransientDesc 	desc;
+	uint32_t 					firstPass;
+	uint32_t 					lastPass;
+	VkImage 					image = VK_NULL_HANDLE;
+	VkImageView 				view = VK_NULL_HANDLE;
+	uint32_t 					block = 0; // into blocks
+  };
+
+  // memory shared by transients whose passes don't overlap. The last access to it carries
+  // over to the next frame, that's what the first transient using it has to wait for.
+  struct Block {
+	VkDeviceMemory 			memory = VK_NULL_HANDLE;
+	RenderGraphState 		state;
+  };
+
+  VkDevice 						device = VK_NULL_HANDLE;
+  VkPhysicalDevice 				physicalDevice = VK_NULL_HANDLE;
+  RenderGraphRetire 			retire;
+  std::vector<Image> 			images;
+  std::vector<Pass> 			passes;
+  std::vector<Transient> 		declared;		// this frame's
+  std::vector<Transient> 		transients; 	// what's allocated
+  std::vector<Block> 			blocks;
+  uint64_t 						transientGeneration = 0;
+
+  void 						allocateTransients();
+  void 						releaseTransients(bool now);
+  uint32_t 					findMemoryType(uint32_t typeFilter, bool lazy);
+  void 						transition(Image &image, RenderGraphState next, std::vector<VkImageMemoryBarrier> &barriers,
+									   VkPipelineStageFlags &srcStages, VkPipelineStageFlags &dstStages);
+};
@@ -9,9 +9,12 @@ SDG                                                                          JJ
 
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <fstream>
 #include <optional>
+#include <unordered_map>
 #include <vector>
 #include <map>
 
@@ -26,6 +29,11 @@ SDG                                                                          JJ
 
 #include "vendor/stb_image.h"
 
+#include "asset_pack.hh"
+#include "texture_formats.hh"
+#include "render_graph.hh"
+#include "resolution_controller.hh"
+
 typedef GLFWwindow* Window;
 typedef GLFWcursor* Cursor;
 
@@ -35,6 +43,7 @@ typedef void *(MouseButtonCallback)(GLFWwindow *window, int button, int action,
 const float WORLD_TOP_COORD = 5.4;
 const float WORLD_RIGHT_COORD = 12.0;
 
+const char *const WINDOW_TITLE = "Orc Horde";
 const uint32_t INIT_WIN_W = 800;
 const uint32_t INIT_WIN_H = 600;
 
@@ -43,16 +52,28 @@ const uint32_t INIT_WIN_H = 600;
 
 const std::string TEXTURE_PATH = "./models/viking_room/viking_room.png";
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
-const int MAX_GAME_OBJECTS = 8092;
+const int MIN_FRAMES_IN_FLIGHT = 2;
+const int MAX_FRAMES_IN_FLIGHT = 4; // sizes the per frame arrays, RendererConfig::framesInFlight of them are used
+const int INSTANCE_BUFFER_INITIAL_CAPACITY = 8192; // instances per frame, grows (see growInstanceBuffer)
 const int MAX_TEXTURES_LOADED = 1024;
 
+// one uint per texture slot in base.frag's TextureInfo buffer: the low 8 bits are the bits
+// per palette index (0 for ordinary textures), the rest is the slot holding the palette
+const uint32_t TEXTURE_INFO_INDEX_BITS_MASK = 0xFF;
+const uint32_t TEXTURE_INFO_PALETTE_SHIFT = 8;
+
 class Asset; // defined in asset.hh
 typedef std::string GUID;
 
 struct Instance;
 class Renderer;
 
+// per draw push constants for base.vert. For VertexFull meshes this is just the identity.
+struct MeshConstants {
+  glm::vec4 boundsMin {0.0f, 0.0f, 0.0f, 0.0f};
+  glm::vec4 boundsExtent {1.0f, 1.0f, 1.0f, 0.0f};
+};
+
 enum RenderOpType {
   DrawMeshSimple,
   DrawMeshInstanced,
@@ -60,64 +81,68 @@ enum RenderOpType {
 
 struct RenderOp {
   RenderOpType type;
+  MeshConstants meshConstants;
   VkBuffer vertexBuffer;
   VkBuffer indexBuffer;
+  VkIndexType indexType;
   uint32_t numIndices;
   VkBuffer instanceBuffer;
   uint32_t numInstances;
   uint32_t instanceOffset;
 };
 
-struct Renderable {
-  VkBuffer 					vertexBuffer; // do not deallocate
+// one per mesh LOD, instances are sorted into these in Mesh::display
+struct DrawBucket {
   VkBuffer 					indexBuffer;  // do not deallocate
   uint32_t 					numIndices;
   std::vector<Instance> 	instances;
 };
 
+struct Renderable {
+  MeshConstants				meshConstants;
+  VkBuffer 					vertexBuffer; // do not deallocate
+  VkIndexType				indexType = VK_INDEX_TYPE_UINT32;
+  std::vector<DrawBucket>	lods;
+};
+
+struct Camera {
+  glm::vec3 				position {0.0f, 0.1f, 10.0f};
+  glm::vec3 				target {0.0f, 0.0f, 0.0f};
+  glm::vec3 				up {0.0f, 0.0f, -1.0f};
+  float 					fovY = glm::radians(45.0f);
+  float 					nearPlane = 0.1f;
+  float 					farPlane = 100.0f;
+  float 					viewportHeight = INIT_WIN_H; // pixels, for LOD selection
+
+  // roughly how many pixels tall worldSize units at point end up on screen
+  float projectedSize(glm::vec3 point, float worldSize) const {
+	float distance = std::max(glm::length(point - position), nearPlane);
+	return worldSize * viewportHeight / (2.0f * std::tan(fovY * 0.5f) * distance);
+  }
+};
+
 struct RenderState {
   std::unordered_map<GUID, Renderable> assets;
+  Camera camera;
+  std::unordered_map<uint32_t, float> textureScreenSize; // texture slot -> largest size in pixels
 
   // WARNING(caleb): This will allocate instance buffers
   std::vector<RenderOp> getRenderOps(Renderer &renderer);
   void cleanup(Renderer & renderer);
 };
 
+enum VertexFormat {
+  VertexFull,      // Vertex, 32 bytes
+  VertexQuantized, // QuantizedVertex, 12 bytes, dequantized with MeshConstants in base.vert
+};
+
 struct Vertex {
   glm::vec3 pos;
   glm::vec3 color;
   glm::vec2 texCoord;
   
-  static VkVertexInputBindingDescription getBindingDescription() {
-    VkVertexInputBindingDescription bindingDescription{};
-	bindingDescription.binding = 0;
-	bindingDescription.stride = sizeof(Vertex);
-	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-    return bindingDescription;
-  }
-  
-  static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
-    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions {};
-	// positions
-	attributeDescriptions[0].binding = 0;
-	attributeDescriptions[0].location = 0;
-	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[0].offset = offsetof(Vertex, pos);
-	
-	// colors
-	attributeDescriptions[1].binding = 0;
-	attributeDescriptions[1].location = 1;
-	attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[1].offset = offsetof(Vertex, color);
-	
-	// textures
-	attributeDescriptions[2].binding = 0;
-	attributeDescriptions[2].location = 2;
-	attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-	attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-	
-	return attributeDescriptions;
-  }
+  static VkVertexInputBindingDescription getBindingDescription(VertexFormat format = VertexFull);
+  static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(VertexFormat format = VertexFull);
   
   
   bool operator==(const Vertex& other) const {
@@ -127,18 +152,18 @@ struct Vertex {
   }
 };
 
-namespace std {
-  template<> struct hash<Vertex> {
-	size_t operator()(Vertex const& vertex) const {
-	  return ((hash<glm::vec3>()(vertex.pos) ^
-			   (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-		(hash<glm::vec2>()(vertex.texCoord) << 1);
-	}
-  };
-}
+// NOTE: the color is dropped (it's always white for loaded meshes), positions are unorm16
+// within the mesh bounds and uvs are half floats.
+struct QuantizedVertex {
+  uint16_t	pos[4]; // xyz + padding
+  uint32_t 	texCoord; // half x2
+};
 
 typedef uint32_t Index;
 
+// positions as unorm16 within the mesh bounds (written to meshConstants), uvs as half floats
+std::vector<QuantizedVertex> quantizeVertices(const std::vector<Vertex> &vertices, MeshConstants &meshConstants);
+
 struct Instance {
   glm::vec3 position;
   glm::vec4 rotation;
@@ -183,6 +208,93 @@ struct Instance {
   }
 };
 
+// NOTE: the game is (for now) top down, so positions are stored as fixed point over
+// the world extents and z/scale only get half precision. Rotations are always unit
+// quaternions so we can get away with the "smallest three" encoding.
+// 16 bytes per instance instead of 36. Must match base.vert (PACKED_INSTANCES).
+const float INSTANCE_POSITION_RANGE = 16.0f;
+
+struct PackedInstance {
+  uint32_t		positionXY;     // snorm16 x2, scaled by INSTANCE_POSITION_RANGE
+  uint32_t		positionZScale; // half x2
+  uint32_t		rotation;       // 2 bit index of largest component, 3 x 10 bits for the rest
+  uint16_t		textureIndex;
+  uint16_t		padding;
+
+  static PackedInstance fromInstance(const Instance &instance);
+
+  static VkVertexInputBindingDescription getBindingDescription() {
+	return VkVertexInputBindingDescription {
+	  .binding = 	1,
+	  .stride = 	sizeof(PackedInstance),
+	  .inputRate = 	VK_VERTEX_INPUT_RATE_INSTANCE,
+	};
+  }
+
+  static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions() {
+	std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions {
+  	  VkVertexInputAttributeDescription {  // position xy
+  	    .location = 3,
+		.binding = 1,
+  	    .format = VK_FORMAT_R16G16_SNORM,
+  	    .offset = offsetof(PackedInstance, positionXY) },
+
+  	  VkVertexInputAttributeDescription {  // position z and scale
+  	    .location = 4,
+		.binding = 1,
+  	    .format = VK_FORMAT_R16G16_SFLOAT,
+  	    .offset = offsetof(PackedInstance, positionZScale) },
+
+  	  VkVertexInputAttributeDescription {  // rotation
+  	    .location = 5,
+		.binding = 1,
+  	    .format = VK_FORMAT_R32_UINT,
+  	    .offset = offsetof(PackedInstance, rotation) },
+
+  	  VkVertexInputAttributeDescription{  // textureIndex
+  	    .location = 6,
+		.binding = 1,
+  	    .format = VK_FORMAT_R16_UINT,
+  	    .offset = offsetof(PackedInstance, textureIndex) },
+  	};
+	return attributeDescriptions;
+  }
+};
+
+enum InstanceFormat {
+  InstanceFull,   // Instance, uploaded as is
+  InstancePacked, // PackedInstance, decoded in base.vert
+};
+
+// Set before initGraphics(), most of these can't be changed afterwards
+struct RendererConfig {
+  InstanceFormat	instanceFormat = InstanceFull;
+  VertexFormat		vertexFormat = VertexFull;
+  VkDeviceSize		textureBudget = 256 * 1024 * 1024; // bytes of streamed texture mips
+  size_t			assetCpuBudget = 512 * 1024 * 1024;  // unreferenced assets get evicted above these,
+  VkDeviceSize		assetGpuBudget = 1024 * 1024 * 1024; // see AssetStore::evictUnused
+  VkPresentModeKHR	presentMode = VK_PRESENT_MODE_MAILBOX_KHR; // FIFO if the surface doesn't have it
+  bool				headless = false;	// no window, surface or swapchain, see createOffscreenTargets
+  VkExtent2D		headlessExtent = { INIT_WIN_W, INIT_WIN_H };
+  uint64_t			headlessFrames = 1000;	 // shouldClose() once this many have been drawn
+  uint32_t			dumpFrameInterval = 0;	 // headless, every Nth frame goes to frame_NNNNNN.ppm, 0 never
+  bool				pipelineStatistics = false; // vertex/fragment invocation counts with --profile, if supported
+  uint32_t			framesInFlight = 2;	 // MIN_FRAMES_IN_FLIGHT to MAX_FRAMES_IN_FLIGHT, clamped by initGraphics
+  bool				dynamicRendering = true; // VK_KHR_dynamic_rendering if supported, else a VkRenderPass and framebuffers
+  bool				shaderObjects = true;	 // VK_EXT_shader_object if supported (needs dynamicRendering), else pipelines
+  bool				dynamicResolution = false; // scale the scene (and MSAA with shader objects) to hold gpuFrameBudgetMs
+  double			gpuFrameBudgetMs = 1000.0 / 60.0;
+  float				minRenderScale = RESOLUTION_MIN_SCALE;
+};
+
+// totals since initGraphics, what a headless benchmark run reports
+struct RenderStats {
+  uint64_t frames = 0;
+  uint64_t draws = 0;
+  uint64_t instances = 0;
+};
+
+
 struct UniformBufferObject {
   glm::mat4 view;
   glm::mat4 proj;
@@ -199,6 +311,8 @@ const std::vector<const char*> deviceExtensions = {
   VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+const VkFormat HEADLESS_IMAGE_FORMAT = VK_FORMAT_B8G8R8A8_SRGB; // what chooseSwapSurfaceFormat prefers
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -214,34 +328,186 @@ struct BufferAllocation {
   uint32_t offset;
   VkBuffer buffer;
   VkDeviceMemory memory;
+  VkDeviceSize capacity; // bytes
+};
+
+// descriptor writes can't touch a set that's in flight, so these get applied to each
+// frame's set once its timeline value has been waited on
+struct TextureSlotWrite {
+  uint32_t slot;
+  VkImageView imageView;
+};
+
+// Everything retired is kept until the timeline semaphore reaches timelineValue, the
+// value of the first frame submitted after it was retired. That frame isn't submitted
+// yet when it's retired, so it starts out as TIMELINE_PENDING (see stampRetired).
+const uint64_t TIMELINE_PENDING = 0;
+
+struct RetiredImage {
+  VkImage image;
+  VkDeviceMemory memory;
+  VkImageView imageView;
+  uint64_t timelineValue;
+};
+
+struct RetiredBuffer {
+  VkBuffer buffer;
+  VkDeviceMemory memory;
+  uint64_t timelineValue;
+};
+
+struct RetiredTextureSlot {
+  uint32_t slot;
+  uint64_t timelineValue;
+};
+
+// the swapchain recreateSwapChain replaced, with what was built on its images. When only
+// the render targets were rebuilt (see recordCommandBuffer) swapChain is VK_NULL_HANDLE.
+struct RetiredSwapChain {
+  VkSwapchainKHR swapChain;
+  std::vector<VkImageView> imageViews;
+  std::vector<VkFramebuffer> framebuffers;
+  uint64_t timelineValue;
+};
+
+// writeInstanceBuffer fills a staging buffer right away, the copy out of it is recorded
+// at the start of the frame's command buffer (see recordCommandBuffer)
+struct InstanceCopy {
+  VkBuffer stagingBuffer;
+  VkDeviceMemory stagingMemory;
+  VkBuffer instanceBuffer;
+  VkDeviceSize offset;
+  VkDeviceSize size;
+};
+
+// Geometry the renderer makes for itself instead of loading it: meshes that aren't uploaded
+// yet draw as the placeholder cube, the loading view is made of quads. Stored in
+// config.vertexFormat like everything else, see createBuiltinMeshes.
+const char *const PLACEHOLDER_MESH_RENDERABLE = "PLACEHOLDER_MESH"; // its key in RenderState::assets
+
+struct BuiltinMesh {
+  MeshConstants				meshConstants;
+  VkBuffer					vertexBuffer;
+  VkDeviceMemory			vertexMemory;
+  VkBuffer					indexBuffer;
+  VkDeviceMemory			indexMemory;
+  uint32_t					numIndices;
+
+  Renderable				renderable() const; // a single level, no instances yet
+};
+
+// The loader only exports core 1.2 entry points, these get looked up with vkGetDeviceProcAddr
+// once the extension is enabled (see loadDeviceExtensionFunctions) and stay null otherwise.
+#define DYNAMIC_RENDERING_FUNCTIONS(X) \
+  X(vkCmdBeginRenderingKHR) \
+  X(vkCmdEndRenderingKHR)
+
+#define SHADER_OBJECT_FUNCTIONS(X) \
+  X(vkCreateShadersEXT) \
+  X(vkDestroyShaderEXT) \
+  X(vkCmdBindShadersEXT) \
+  X(vkCmdSetVertexInputEXT) \
+  X(vkCmdSetViewportWithCountEXT) \
+  X(vkCmdSetScissorWithCountEXT) \
+  X(vkCmdSetRasterizerDiscardEnableEXT) \
+  X(vkCmdSetPrimitiveTopologyEXT) \
+  X(vkCmdSetPrimitiveRestartEnableEXT) \
+  X(vkCmdSetPolygonModeEXT) \
+  X(vkCmdSetCullModeEXT) \
+  X(vkCmdSetFrontFaceEXT) \
+  X(vkCmdSetDepthBiasEnableEXT) \
+  X(vkCmdSetRasterizationSamplesEXT) \
+  X(vkCmdSetSampleMaskEXT) \
+  X(vkCmdSetAlphaToCoverageEnableEXT) \
+  X(vkCmdSetDepthTestEnableEXT) \
+  X(vkCmdSetDepthWriteEnableEXT) \
+  X(vkCmdSetDepthCompareOpEXT) \
+  X(vkCmdSetDepthBoundsTestEnableEXT) \
+  X(vkCmdSetStencilTestEnableEXT) \
+  X(vkCmdSetColorBlendEnableEXT) \
+  X(vkCmdSetColorWriteMaskEXT)
+
+struct DeviceExtensionFunctions {
+#define DECLARE_DEVICE_FUNCTION(name) PFN_##name name = nullptr;
+  DYNAMIC_RENDERING_FUNCTIONS(DECLARE_DEVICE_FUNCTION)
+  SHADER_OBJECT_FUNCTIONS(DECLARE_DEVICE_FUNCTION)
+#undef DECLARE_DEVICE_FUNCTION
+};
+
+// With VK_EXT_shader_object a program is just its two stages, each its own VkShaderEXT so
+// a new variant of one doesn't recompile the other. Everything a pipeline would bake in is
+// dynamic state instead: the vertex input is set with the program (bindShaderProgram), the
+// rest once per command buffer (setShaderObjectState).
+struct ShaderProgram {
+  VkShaderEXT vertex = VK_NULL_HANDLE;
+  VkShaderEXT fragment = VK_NULL_HANDLE;
+  std::vector<VkVertexInputBindingDescription2EXT> bindings;
+  std::vector<VkVertexInputAttributeDescription2EXT> attributes;
+};
+
+// GPU timing with --profile. Each frame in flight has its own pools, read back once its
+// timeline value has been waited on again (framesInFlight frames later), so nothing stalls.
+// Timestamps 0 and 1 bracket the render pass, then one per boundary between draw ranges.
+// Draws overlap on the gpu, so a pair around each draw wouldn't time it. The boundaries are
+// written at COLOR_ATTACHMENT_OUTPUT, when everything before has written its pixels, and
+// each range gets the time from the previous boundary to its own.
+const uint32_t GPU_TIMED_RANGES = 128; // more draws than this and each range has several
+const uint32_t GPU_FRAME_TIMESTAMPS = 2 + GPU_TIMED_RANGES;
+
+struct GpuFrameQueries {
+  VkQueryPool timestamps = VK_NULL_HANDLE;
+  VkQueryPool statistics = VK_NULL_HANDLE; // vertex and fragment invocations, if enabled
+  uint32_t timestampsWritten = 0;		   // 0 when the frame wasn't profiled
+  bool statisticsWritten = false;
 };
   
 
 class Renderer {
 public:
+  RendererConfig config;
+
   /* lifetime procedures */
   void initGraphics();
   void initWindow();
   bool shouldClose();
   void getInput();
+  void setWindowTitle(const std::string &title);
   void cleanup();
   
   /* game procedures */
   void loadModel(std::string modelPath);
   void createVertexBuffer(std::vector<Vertex> vertices,
 						  VkBuffer &vertexBuffer, VkDeviceMemory &vertexBufferMemory);
+  void createVertexBuffer(std::vector<QuantizedVertex> vertices,
+						  VkBuffer &vertexBuffer, VkDeviceMemory &vertexBufferMemory);
   void createIndexBuffer(std::vector<Index> indices,
 						 VkBuffer &indexBuffer, VkDeviceMemory &indexBufferMemory);
-  BufferSlice writeInstanceBuffer(std::vector<Instance> instances); // TODO(caleb): handle case where instancebuffer is too small.
+  void createIndexBuffer(std::vector<uint16_t> indices,
+						 VkBuffer &indexBuffer, VkDeviceMemory &indexBufferMemory);
+  Camera getCamera();
+  BufferSlice writeInstanceBuffer(std::vector<Instance> instances); // grows this frame's buffer if it has to
   void drawFrame(std::vector<RenderOp> renderOps);
   void destroyBuffer(VkBuffer buffer);
   void freeMemory(VkDeviceMemory memory);
   void destroyImage(VkImage image);
   void destroyImageView(VkImageView imageView);
-  void createTextureImage(stbi_uc *pixels, int texWidth, int texHeight, int texChannels,
+  bool supportsTextureFormat(TextureFormat format);
+  void createTextureImage(const std::vector<TextureMip> &mips, uint32_t firstMip, TextureFormat format,
 						  VkImage &textureImage, VkDeviceMemory &textureImageMemory,
 						  VkImageView &textureImageView);
   void addTextureImageToDescriptorSet(VkImageView &imageView, uint32_t &offset);
+  void setTextureSlot(uint32_t slot, VkImageView imageView);
+  void releaseTextureSlot(uint32_t slot); // reused once no frame can use it
+  void setTexturePalette(uint32_t slot, uint32_t paletteSlot, TextureFormat format); // before slot is drawn
+  void retireImage(VkImage image, VkDeviceMemory memory, VkImageView imageView); // destroyed once no frame can use it
+  void retireBuffer(VkBuffer buffer, VkDeviceMemory memory); // same, for buffers
+  uint32_t getPlaceholderTextureSlot() { return placeholderTextureSlot; } // drawn until a texture is uploaded
+  uint32_t getProgressTextureSlot() { return progressTextureSlot; } // the loading view's bar
+  Renderable getPlaceholderMesh() { return placeholderMesh.renderable(); } // drawn until a mesh is uploaded
+  Renderable getQuadMesh() { return quadMesh.renderable(); } // unit square in xy, facing +z
+  VkDeviceSize getImageMemorySize(VkImage image);   // what the allocation for it takes, not just the texels
+  VkDeviceSize getBufferMemorySize(VkBuffer buffer);
+  RenderStats getRenderStats() { return renderStats; }
 
   // NOTE(caleb): Depending on when these get called, we may be able to have them simply cache objects which are then returned to the game via getInput()
   void setCursorMovementCallback(GLFWcursor *cursor, CursorPositionCallback cursorPositionCallback);
@@ -252,7 +518,7 @@ public:
   
 private:
   /* props */
-  GLFWwindow *window;
+  GLFWwindow *window = nullptr; // stays null when headless
   VkInstance instance;
   VkDebugUtilsMessengerEXT debugMessenger;
   VkPhysicalDevice physicalDevice;
@@ -265,65 +531,118 @@ private:
   VkQueue graphicsQueue;
   VkQueue presentQueue;
   VkSurfaceKHR surface;
-  VkSwapchainKHR swapChain;
+  VkSwapchainKHR swapChain = VK_NULL_HANDLE; // the old one is passed as oldSwapchain on recreation
   std::vector<VkImage> swapChainImages; // resized only on swapchain creation
   VkFormat swapChainImageFormat;
   VkExtent2D swapChainExtent;
   std::vector<VkImageView>
   swapChainImageViews; // resized only on swapchain createinog
-  VkRenderPass renderPass;
+  std::vector<VkDeviceMemory> offscreenImageMemory; // headless, backs swapChainImages
+  VkRenderPass renderPass = VK_NULL_HANDLE; // stays null with dynamic rendering, as do the framebuffers
   VkDescriptorSetLayout descriptorSetLayout;
   VkPipelineLayout pipelineLayout;
-  VkPipeline graphicsPipeline;
+  VkPipeline graphicsPipeline = VK_NULL_HANDLE; // stay null with shader objects
   VkPipelineLayout instancedPipelineLayout;
-  VkPipeline instancedGraphicsPipeline;
+  VkPipeline instancedGraphicsPipeline = VK_NULL_HANDLE;
+  ShaderProgram simpleShaders;	// with shader objects
+  ShaderProgram instancedShaders;
+  bool dynamicRendering = false;	// what config asked for and the device has, see createLogicalDevice
+  bool shaderObjects = false;
+  DeviceExtensionFunctions ext;
   std::vector<VkFramebuffer> swapChainFramebuffers;
   VkCommandPool commandPool;
   std::vector<VkCommandBuffer> commandBuffers;
   std::vector<VkSemaphore> imageAvailableSemaphores;
   std::vector<VkSemaphore> renderFinishedSemaphores;
-  std::vector<VkFence> inFlightFences;
+  VkSemaphore timeline;		// signalled once per frame and per upload, see submitTimeline
+  uint64_t timelineValue = 0; // the last value submitted
+  std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> frameTimelineValues {}; // what each frame's last submit signals
+  uint32_t framesInFlight = MIN_FRAMES_IN_FLIGHT;
   uint32_t currentFrame = 0;
   bool framebufferResized = false;
+  bool swapChainSuspended = false; // minimized, drawFrame skips frames until there's a size again
   std::vector<VkBuffer> uniformBuffers;
   std::vector<VkDeviceMemory> uniformBuffersMemory;
   std::vector<void*> uniformBuffersMapped;
   VkDescriptorPool descriptorPool;
   std::vector<VkDescriptorSet> descriptorSets;
   VkSampler textureSampler;
-  VkImage depthImage;
-  VkDeviceMemory depthImageMemory;
-  VkImageView depthImageView;
-  VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
-  VkImage colorImage;
-  VkDeviceMemory colorImageMemory;
-  VkImageView colorImageView;
+  VkBuffer textureInfoBuffer;
+  VkDeviceMemory textureInfoBufferMemory;
+  uint32_t *textureInfoMapped;
+  VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT; // can change between frames, see setupDynamicResolution
+  bool textureCompressionBC = false;
+  RenderGraph frameGraph;	// owns the multisampled color and depth targets, see recordCommandBuffer
+  uint64_t framebufferGeneration = 0; // frameGraph's transients the framebuffers were built on
+  ResolutionController resolution;		// with dynamicResolution, fed by readGpuFrameQueries
+  float renderScale = 1.0f;				// of swapChainExtent, see renderExtent
+  VkFilter upscaleFilter = VK_FILTER_LINEAR;
   std::array<BufferAllocation, MAX_FRAMES_IN_FLIGHT> instanceBufferPool;
-  uint32_t numTextures = 0;
+  uint32_t numTextures = 0; // slots ever handed out, the free ones are in freeTextureSlots
+  std::vector<uint32_t> freeTextureSlots;
+  VkImage placeholderImage;
+  VkDeviceMemory placeholderImageMemory;
+  VkImageView placeholderImageView;
+  uint32_t placeholderTextureSlot = 0;
+  VkImage progressImage;
+  VkDeviceMemory progressImageMemory;
+  VkImageView progressImageView;
+  uint32_t progressTextureSlot = 0;
+  BuiltinMesh placeholderMesh;
+  BuiltinMesh quadMesh;
+  Camera camera;
+  uint64_t frameNumber = 0;
+  std::array<std::vector<TextureSlotWrite>, MAX_FRAMES_IN_FLIGHT> pendingTextureSlots;
+  std::vector<RetiredImage> retiredImages;
+  std::vector<RetiredBuffer> retiredBuffers;
+  std::vector<RetiredTextureSlot> retiredTextureSlots;
+  std::vector<RetiredSwapChain> retiredSwapChains;
+  std::vector<InstanceCopy> pendingInstanceCopies; // for the frame being built
+  RenderStats renderStats;
+  std::array<GpuFrameQueries, MAX_FRAMES_IN_FLIGHT> gpuFrameQueries;
+  VkQueryPool uploadQueryPool = VK_NULL_HANDLE; // brackets each single time command buffer
+  bool uploadTimed = false;
+  bool pipelineStatisticsQuery = false;
+  float timestampPeriod = 0.0f; // ns per tick
+  uint64_t timestampMask = 0;	// the queue's timestampValidBits
   
   /* initialization functions */
   void createInstance();
   void setupDebugMessenger();
   void selectPhysicalDevice();
   void createLogicalDevice();
+  void loadDeviceExtensionFunctions();
   void createSurface();
   void createSwapChain();
+  void createOffscreenTargets();
   void createImageViews();
   void createRenderPass();
   void createDescriptorSetLayout();
   void createGraphicsPipeline();
   void createInstancedGraphicsPipeline();
+  void createPipelineLayout(VkPipelineLayout &layout);
+  void createShaderProgram(const std::string &vertShader, const std::string &fragShader,
+						   const std::vector<VkVertexInputBindingDescription> &bindingDescriptions,
+						   const std::vector<VkVertexInputAttributeDescription> &attributeDescriptions,
+						   ShaderProgram &program);
+  void destroyShaderProgram(ShaderProgram &program);
   void createCommandPool();
-  void createColorResources();
-  void createDepthResources();
-  void createFramebuffers();
+  void createFramebuffers(VkImageView colorView, VkImageView depthView, VkImageView resolveView);
   void createTextureSampler();
   void createUniformBuffers();
+  void createTextureInfoBuffer();
   void createDescriptorPool();
   void createDescriptorSets();
   void createCommandBuffers();
   void createSyncObjects();
   void createInstanceBuffers();
+  void createPlaceholderTexture();
+  void createBuiltinMeshes();
+  void createBuiltinMesh(const std::vector<Vertex> &vertices, const std::vector<Index> &indices, BuiltinMesh &mesh);
+  void destroyBuiltinMesh(BuiltinMesh &mesh);
+  void createQueryPools();
+  void createRenderGraph();
+  void setupDynamicResolution();
   void initVulkan();
   
   /* handling things like resizes */
@@ -341,33 +660,53 @@ private:
   QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
   int rateDeviceSuitability(VkPhysicalDevice device);
   std::vector<const char *> getRequiredExtensions();
+  std::vector<const char *> getRequiredDeviceExtensions();
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
   VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &availableFormats);
   VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes); 
   VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
-  VkShaderModule createShaderModule(const std::vector<char> &byteCode);
+  VkShaderModule createShaderModule(const AssetBytes &byteCode);
   void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, std::vector<RenderOp> renderOps);
+  void beginRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkImageView targetView,
+					  VkImageView colorView, VkImageView depthView, VkExtent2D extent);
+  VkExtent2D renderExtent();
+  void endRendering(VkCommandBuffer commandBuffer);
+  void setShaderObjectState(VkCommandBuffer commandBuffer, const VkViewport &viewport, const VkRect2D &scissor);
+  void bindShaderProgram(VkCommandBuffer commandBuffer, const ShaderProgram &program);
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+  VkDeviceSize instanceStride();
+  void growInstanceBuffer(BufferAllocation &instanceAlloc, VkDeviceSize needed);
   void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory);
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, uint32_t dstOffset = 0);
+  void createDeviceLocalBuffer(const void *data, VkDeviceSize size, VkBufferUsageFlags usage,
+							   VkBuffer &buffer, VkDeviceMemory &bufferMemory);
   void updateUniformBuffer(uint32_t currentImage);
   void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling , VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-  void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
+  uint64_t submitTimeline(VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, VkSemaphore signalSemaphore);
+  void waitTimeline(uint64_t value);
+  void recordInstanceCopies(VkCommandBuffer commandBuffer);
+  void stampRetired(uint64_t value);
+  void skipFrame();
   void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
   VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
   VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
   VkFormat findDepthFormat();
   bool hasStencilComponent(VkFormat format);
-  void generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+  void applyPendingTextureSlots();
+  void destroyRetired(bool all = false);
+  void dumpFrame(uint32_t imageIndex);
+  void readGpuFrameQueries();
+  double timestampMs(uint64_t begin, uint64_t end);
+  VkSampleCountFlags getUsableSampleCounts();
   VkSampleCountFlagBits getMaxUsableSampleCount();
   void Renderer::createGraphicsPipeline(const std::string &vertShader,
 										const std::string &fragShader,
 										const std::vector<VkVertexInputBindingDescription> bindingDescriptions,
 										const std::vector<VkVertexInputAttributeDescription> attributeDescriptions,
 										
-										VkPipelineLayout &pipelineLayout,
+										VkPipelineLayout pipelineLayout,
 										VkPipeline &graphicsPipeline);
   
 };
@@ -381,20 +720,13 @@ const bool enableValidationLayers = false;
 const bool enableValidationLayers = true;
 #endif
 
-static std::vector<char> readBinAsset(const std::string& filename) {
-  std::ifstream file(filename, std::ios::ate | std::ios::binary);
-  
-  if (!file.is_open()) {
-    throw std::runtime_error("failed to open file!");
+// straight out of the asset pack's mapping when there is one (see asset_pack.hh), so the
+// bytes are 4 byte aligned for vkCreateShaderModule either way
+static AssetBytes readBinAsset(const std::string& filename) {
+  AssetBytes bytes;
+  if (!readAssetBytes(filename, bytes)) {
+    throw std::runtime_error("failed to open file! " + filename);
   }
-  
-  size_t fileSize = (size_t)file.tellg();
-  std::vector<char> buffer(fileSize);
-  
-  file.seekg(0);
-  file.read(buffer.data(), fileSize);
-  file.close();
-  
-  return buffer;
+  return bytes;
 }
 
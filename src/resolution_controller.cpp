@@ -0,0 +1,71 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+							   Resolution Controller
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "resolution_controller.hh"
+
+ResolutionController::ResolutionController(double budgetMs, float minScale, uint32_t sampleCounts, uint32_t samples) {
+  this->budgetMs = budgetMs;
+  this->minScale = std::clamp(minScale, 0.1f, 1.0f);
+  sampleCount = std::max(samples, 1u);
+  this->sampleCounts = sampleCounts | sampleCount;
+}
+
+uint32_t ResolutionController::fewerSamples() {
+  for (uint32_t samples = sampleCount >> 1; samples > 0; samples >>= 1) {
+	if (sampleCounts & samples) return samples;
+  }
+  return sampleCount;
+}
+
+uint32_t ResolutionController::moreSamples() {
+  for (uint32_t samples = sampleCount << 1; samples != 0; samples <<= 1) {
+	if (sampleCounts & samples) return samples;
+  }
+  return sampleCount;
+}
+
+// Fragment cost goes with the pixel count, so a scale s costs about s^2 of full resolution.
+// More samples are assumed to cost in proportion (4x twice what 2x does), which is
+// pessimistic, but a step that's too cautious only costs a little quality while one that's
+// too eager oscillates. Samples only ever step between counts in sampleCounts.
+bool ResolutionController::update(double gpuMs) {
+  if (budgetMs <= 0.0 || gpuMs <= 0.0) return false;
+  smoothedMs = smoothedMs == 0.0 ? gpuMs : smoothedMs + RESOLUTION_SMOOTHING * (gpuMs - smoothedMs);
+  if (settle > 0) {
+	settle--;
+	return false;
+  }
+
+  if (smoothedMs > budgetMs) {
+	if (fewerSamples() != sampleCount) {
+	  sampleCount = fewerSamples();
+	} else if (renderScale > minScale) {
+	  float wanted = renderScale * static_cast<float>(std::sqrt(budgetMs / smoothedMs));
+	  renderScale = std::max(minScale, std::min(renderScale - RESOLUTION_SCALE_STEP, wanted));
+	} else {
+	  return false; // nothing left to give up
+	}
+  } else if (renderScale < 1.0f) {
+	float next = std::min(1.0f, renderScale + RESOLUTION_SCALE_STEP);
+	if (smoothedMs * (next * next) / (renderScale * renderScale) > budgetMs * RESOLUTION_HEADROOM) return false;
+	renderScale = next;
+  } else if (moreSamples() != sampleCount) {
+	uint32_t next = moreSamples();
+	if (smoothedMs * next / sampleCount > budgetMs * RESOLUTION_HEADROOM) return false;
+	sampleCount = next;
+  } else {
+	return false;
+  }
+
+  settle = RESOLUTION_SETTLE_FRAMES;
+  return true;
+}
@@ -0,0 +1,47 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+							   Resolution Controller
+*/
+
+#pragma once
+
+#include <cstdint>
+
+// Picks the scene's render scale and MSAA sample count from measured gpu frame times, so a
+// big horde costs sharpness instead of frames. Over budget it gives up samples first, then
+// resolution in proportion to how far over it is. Comfortably under budget it takes back
+// resolution first, then samples, but only when the step up is predicted to still fit.
+//
+// NOTE: like frame_pacer.hh this knows nothing about vulkan, sample counts are plain numbers
+// (1, 2, 4, ...), which happen to be the VkSampleCountFlagBits values. The ones it may pick
+// come as a mask of them, like VkSampleCountFlags, since a device needn't support every
+// power of two in between (only 1 and 4 are guaranteed).
+const float RESOLUTION_MIN_SCALE = 0.5f;
+const float RESOLUTION_SCALE_STEP = 0.05f;
+const uint32_t RESOLUTION_SETTLE_FRAMES = 30; // after a change, so frames still in flight with the old one don't count
+const double RESOLUTION_SMOOTHING = 0.1;	  // weight of the newest frame time
+const double RESOLUTION_HEADROOM = 0.85;	  // the most of the budget a step up may be predicted to use
+
+class ResolutionController {
+public:
+  ResolutionController() = default; // full resolution, one sample, never changes
+  ResolutionController(double budgetMs, float minScale, uint32_t sampleCounts, uint32_t samples);
+  bool 						update(double gpuMs); // once per timed frame, true when scale() or samples() changed
+  float 					scale() { return renderScale; }
+  uint32_t 					samples() { return sampleCount; }
+
+private:
+  double 					budgetMs = 0.0;
+  float 					minScale = 1.0f;
+  uint32_t 					sampleCounts = 1; // a bit per sample count it may pick, samples included
+  float 					renderScale = 1.0f;
+  uint32_t 					sampleCount = 1;
+  double 					smoothedMs = 0.0;
+  uint32_t 					settle = RESOLUTION_SETTLE_FRAMES;
+  uint32_t 					fewerSamples(); // the next supported count down, sampleCount if there's none
+  uint32_t 					moreSamples();
+};
@@ -21,6 +21,11 @@ RigidBody::RigidBody(skyVec3 position, skyQuat rotation, float scale,
   mesh = assetStore.getMesh(meshId);
 }
 
+RigidBody::~RigidBody() {
+  texture->relinquish();
+  mesh->relinquish();
+}
+
 GameOps RigidBody::update(std::chrono::microseconds dt, GameState &gameState){ return {}; }
 void RigidBody::display(RenderState &renderState){
   Instance thisInstance {
@@ -0,0 +1,398 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+								  Texture Formats
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "texture_formats.hh"
+
+size_t textureMipBytes(TextureFormat format, uint32_t width, uint32_t height) {
+  size_t blocks = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+  switch (format) {
+  case TextureRGBA8:	return static_cast<size_t>(width) * height * 4;
+  case TextureBC1:		return blocks * 8;
+  case TextureBC7:		return blocks * 16;
+  case TexturePalette4:	return static_cast<size_t>(textureImageWidth(format, width)) * height;
+  case TexturePalette8:	return static_cast<size_t>(width) * height;
+  }
+  throw std::logic_error("unknown texture format");
+}
+
+uint32_t textureImageWidth(TextureFormat format, uint32_t width) {
+  return format == TexturePalette4 ? (width + 1) / 2 : width;
+}
+
+bool isPaletteFormat(TextureFormat format) {
+  return format == TexturePalette4 || format == TexturePalette8;
+}
+
+/* ============================== Mip Generation ============================== */
+
+// NOTE: the GPU used to blit these with linear filtering on an sRGB image, which
+// averages in linear space. We do the same here so streamed mips match.
+struct SrgbTables {
+  float		toLinear[256];
+  uint8_t	toSrgb[4096];
+
+  SrgbTables() {
+	for (int i = 0; i < 256; i++) {
+	  float c = i / 255.0f;
+	  toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+	for (int i = 0; i < 4096; i++) {
+	  float c = i / 4095.0f;
+	  float srgb = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	  toSrgb[i] = static_cast<uint8_t>(std::round(std::clamp(srgb, 0.0f, 1.0f) * 255.0f));
+	}
+  }
+};
+
+static const SrgbTables &srgbTables() {
+  static const SrgbTables tables;
+  return tables;
+}
+
+// 2x2 box filter, clamping at the edge for odd sizes
+static TextureMip downsample(const TextureMip &source) {
+  const SrgbTables &srgb = srgbTables();
+  TextureMip mip {
+	.width = std::max(source.width / 2, 1u),
+	.height = std::max(source.height / 2, 1u),
+	.data = {},
+  };
+  mip.data.resize(static_cast<size_t>(mip.width) * mip.height * 4);
+
+  for (uint32_t y = 0; y < mip.height; y++) {
+	uint32_t y0 = std::min(y * 2, source.height - 1);
+	uint32_t y1 = std::min(y * 2 + 1, source.height - 1);
+	for (uint32_t x = 0; x < mip.width; x++) {
+	  uint32_t x0 = std::min(x * 2, source.width - 1);
+	  uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+
+	  const uint8_t *taps[4] = {
+		&source.data[(static_cast<size_t>(y0) * source.width + x0) * 4],
+		&source.data[(static_cast<size_t>(y0) * source.width + x1) * 4],
+		&source.data[(static_cast<size_t>(y1) * source.width + x0) * 4],
+		&source.data[(static_cast<size_t>(y1) * source.width + x1) * 4],
+	  };
+	  uint8_t *out = &mip.data[(static_cast<size_t>(y) * mip.width + x) * 4];
+
+	  for (int c = 0; c < 3; c++) {
+		float sum = srgb.toLinear[taps[0][c]] + srgb.toLinear[taps[1][c]]
+		  + srgb.toLinear[taps[2][c]] + srgb.toLinear[taps[3][c]];
+		out[c] = srgb.toSrgb[static_cast<int>(sum * 0.25f * 4095.0f + 0.5f)];
+	  }
+	  out[3] = static_cast<uint8_t>((taps[0][3] + taps[1][3] + taps[2][3] + taps[3][3] + 2) / 4);
+	}
+  }
+
+  return mip;
+}
+
+std::vector<TextureMip> buildMipChain(const uint8_t *pixels, uint32_t width, uint32_t height) {
+  std::vector<TextureMip> mips;
+  mips.push_back(TextureMip {
+	  .width = width,
+	  .height = height,
+	  .data = std::vector<uint8_t>(pixels, pixels + static_cast<size_t>(width) * height * 4),
+	});
+
+  while (mips.back().width > 1 || mips.back().height > 1) {
+	mips.push_back(downsample(mips.back()));
+  }
+  return mips;
+}
+
+/* ================================ Palettes ================================ */
+
+// most common of the four, ties go to the first one
+static uint8_t majorityIndex(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+  if (a == b || a == c || a == d) return a;
+  if (b == c || b == d) return b;
+  if (c == d) return c;
+  return a;
+}
+
+// Palette4 levels have to stay an even number of texels wide so that the vulkan image
+// (textureImageWidth) halves the same way we do. It never goes below 2 wide (1 image texel).
+static uint32_t nextMipWidth(TextureFormat format, uint32_t width) {
+  if (format == TexturePalette4) return 2 * std::max(width / 4, 1u);
+  return std::max(width / 2, 1u);
+}
+
+// indices is one byte per texel here, packing for Palette4 happens at the end
+static std::vector<uint8_t> downsampleIndices(const std::vector<uint8_t> &indices,
+											  uint32_t width, uint32_t height,
+											  uint32_t mipWidth, uint32_t mipHeight) {
+  std::vector<uint8_t> mip(static_cast<size_t>(mipWidth) * mipHeight);
+  for (uint32_t y = 0; y < mipHeight; y++) {
+	const uint8_t *row0 = &indices[static_cast<size_t>(std::min(y * 2, height - 1)) * width];
+	const uint8_t *row1 = &indices[static_cast<size_t>(std::min(y * 2 + 1, height - 1)) * width];
+	for (uint32_t x = 0; x < mipWidth; x++) {
+	  uint32_t x0 = std::min(x * 2, width - 1);
+	  uint32_t x1 = std::min(x * 2 + 1, width - 1);
+	  mip[static_cast<size_t>(y) * mipWidth + x] = majorityIndex(row0[x0], row0[x1], row1[x0], row1[x1]);
+	}
+  }
+  return mip;
+}
+
+static std::vector<uint8_t> packIndices4(const std::vector<uint8_t> &indices, uint32_t width, uint32_t height) {
+  uint32_t rowBytes = textureImageWidth(TexturePalette4, width);
+  std::vector<uint8_t> packed(static_cast<size_t>(rowBytes) * height);
+  for (uint32_t y = 0; y < height; y++) {
+	const uint8_t *row = &indices[static_cast<size_t>(y) * width];
+	for (uint32_t x = 0; x < width; x += 2) {
+	  uint8_t right = x + 1 < width ? row[x + 1] : row[x];
+	  packed[static_cast<size_t>(y) * rowBytes + x / 2] = static_cast<uint8_t>((row[x] << 4) | right);
+	}
+  }
+  return packed;
+}
+
+bool buildPaletteTexture(const uint8_t *pixels, uint32_t width, uint32_t height, bool allow4Bit,
+						 TextureFormat &format, std::vector<TextureMip> &mips,
+						 std::vector<uint8_t> &palette) {
+  size_t texels = static_cast<size_t>(width) * height;
+  std::vector<uint8_t> indices(texels);
+  std::vector<uint32_t> colors;
+  std::unordered_map<uint32_t, uint8_t> colorIndex;
+
+  uint32_t lastColor = 0;
+  uint8_t lastIndex = 0;
+  for (size_t i = 0; i < texels; i++) {
+	uint32_t color;
+	std::memcpy(&color, pixels + i * 4, 4);
+	if (i > 0 && color == lastColor) { // runs of the same color are the common case
+	  indices[i] = lastIndex;
+	  continue;
+	}
+
+	auto found = colorIndex.find(color);
+	if (found == colorIndex.end()) {
+	  if (colors.size() == TEXTURE_PALETTE_MAX_COLORS) return false;
+	  found = colorIndex.emplace(color, static_cast<uint8_t>(colors.size())).first;
+	  colors.push_back(color);
+	}
+	indices[i] = lastIndex = found->second;
+	lastColor = color;
+  }
+
+  if (colors.size() == 1) {
+	format = TextureRGBA8;
+	mips.assign(1, TextureMip{ .width = 1, .height = 1, .data = std::vector<uint8_t>(pixels, pixels + 4) });
+	palette.clear();
+	return true;
+  }
+
+  format = allow4Bit && colors.size() <= 16 && width % 2 == 0 ? TexturePalette4 : TexturePalette8;
+  palette.resize(colors.size() * 4);
+  std::memcpy(palette.data(), colors.data(), palette.size());
+
+  mips.clear();
+  uint32_t mipWidth = width, mipHeight = height;
+  while (true) {
+	mips.push_back(TextureMip{
+		.width = mipWidth,
+		.height = mipHeight,
+		.data = format == TexturePalette4 ? packIndices4(indices, mipWidth, mipHeight) : indices,
+	  });
+	if (textureImageWidth(format, mipWidth) == 1 && mipHeight == 1) break;
+
+	uint32_t nextWidth = nextMipWidth(format, mipWidth);
+	uint32_t nextHeight = std::max(mipHeight / 2, 1u);
+	indices = downsampleIndices(indices, mipWidth, mipHeight, nextWidth, nextHeight);
+	mipWidth = nextWidth;
+	mipHeight = nextHeight;
+  }
+  return true;
+}
+
+/* ================================== KTX2 ================================== */
+
+static const uint8_t KTX2_IDENTIFIER[12] = {
+  0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+// NOTE: everything we target is little endian, same as the file, so these are plain copies
+struct KTX2Header {
+  uint8_t 	identifier[12];
+  uint32_t 	vkFormat;
+  uint32_t 	typeSize;
+  uint32_t 	pixelWidth;
+  uint32_t 	pixelHeight;
+  uint32_t 	pixelDepth;
+  uint32_t 	layerCount;
+  uint32_t 	faceCount;
+  uint32_t 	levelCount;
+  uint32_t 	supercompressionScheme;
+  uint32_t 	dfdByteOffset;
+  uint32_t 	dfdByteLength;
+  uint32_t 	kvdByteOffset;
+  uint32_t 	kvdByteLength;
+  uint64_t 	sgdByteOffset;
+  uint64_t 	sgdByteLength;
+};
+static_assert(sizeof(KTX2Header) == 80, "KTX2 header has to match the file layout");
+
+struct KTX2Level {
+  uint64_t 	byteOffset;
+  uint64_t 	byteLength;
+  uint64_t 	uncompressedByteLength;
+};
+
+const uint64_t KTX2_LEVEL_ALIGNMENT = 16; // covers both block sizes and RGBA8
+
+void writeKTX2(const std::string &path, TextureFormat format, const std::vector<TextureMip> &mips,
+			   const std::vector<uint8_t> &palette) {
+  KTX2Header header {};
+  std::memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+  header.vkFormat = format;
+  header.typeSize = 1;
+  header.pixelWidth = textureImageWidth(format, mips[0].width);
+  header.pixelHeight = mips[0].height;
+  header.faceCount = 1;
+  header.levelCount = static_cast<uint32_t>(mips.size());
+
+  // one key/value pair: byte length, key with its terminator, value, padding to 4 bytes
+  std::vector<uint8_t> keyValueData;
+  if (!palette.empty()) {
+	size_t keyBytes = std::strlen(KTX2_PALETTE_KEY) + 1;
+	auto length = static_cast<uint32_t>(keyBytes + palette.size());
+	keyValueData.resize(4 + (length + 3) / 4 * 4, 0);
+	std::memcpy(keyValueData.data(), &length, 4);
+	std::memcpy(keyValueData.data() + 4, KTX2_PALETTE_KEY, keyBytes);
+	std::memcpy(keyValueData.data() + 4 + keyBytes, palette.data(), palette.size());
+
+	header.kvdByteOffset = static_cast<uint32_t>(sizeof(KTX2Header) + sizeof(KTX2Level) * mips.size());
+	header.kvdByteLength = static_cast<uint32_t>(keyValueData.size());
+  }
+
+  // level data goes smallest first, like the spec says
+  std::vector<KTX2Level> levels(mips.size());
+  uint64_t offset = sizeof(KTX2Header) + sizeof(KTX2Level) * levels.size() + keyValueData.size();
+  for (size_t i = mips.size(); i-- > 0;) {
+	offset = (offset + KTX2_LEVEL_ALIGNMENT - 1) / KTX2_LEVEL_ALIGNMENT * KTX2_LEVEL_ALIGNMENT;
+	levels[i] = KTX2Level{ offset, mips[i].data.size(), mips[i].data.size() };
+	offset += mips[i].data.size();
+  }
+
+  std::vector<uint8_t> file(offset, 0);
+  std::memcpy(file.data(), &header, sizeof(header));
+  std::memcpy(file.data() + sizeof(header), levels.data(), sizeof(KTX2Level) * levels.size());
+  if (!keyValueData.empty()) {
+	std::memcpy(file.data() + header.kvdByteOffset, keyValueData.data(), keyValueData.size());
+  }
+  for (size_t i = 0; i < mips.size(); i++) {
+	std::memcpy(file.data() + levels[i].byteOffset, mips[i].data.data(), mips[i].data.size());
+  }
+
+  std::ofstream out(path, std::ios::binary);
+  if (!out) throw std::runtime_error("failed to open " + path + " for writing");
+  out.write(reinterpret_cast<const char *>(file.data()), file.size());
+}
+
+// the value for key, empty if it isn't there
+static std::vector<uint8_t> findKTX2Value(const uint8_t *file, size_t fileSize, const KTX2Header &header,
+										  const char *key) {
+  if (static_cast<uint64_t>(header.kvdByteOffset) + header.kvdByteLength > fileSize) return {};
+
+  size_t keyBytes = std::strlen(key) + 1;
+  size_t offset = header.kvdByteOffset, end = offset + header.kvdByteLength;
+  while (offset + 4 <= end) {
+	uint32_t length;
+	std::memcpy(&length, file + offset, 4);
+	offset += 4;
+	if (length > end - offset) break;
+
+	if (length >= keyBytes && std::memcmp(file + offset, key, keyBytes) == 0) {
+	  return std::vector<uint8_t>(file + offset + keyBytes, file + offset + length);
+	}
+	offset += (length + 3) / 4 * 4;
+  }
+  return {};
+}
+
+bool readKTX2(const std::string &path, TextureFormat &format, std::vector<TextureMip> &mips,
+			  std::vector<uint8_t> &palette) {
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  if (!in) return false;
+
+  std::vector<uint8_t> file(static_cast<size_t>(in.tellg()));
+  in.seekg(0);
+  in.read(reinterpret_cast<char *>(file.data()), file.size());
+
+  return readKTX2(file.data(), file.size(), path, format, mips, palette);
+}
+
+static bool badKTX2(const char *problem, const std::string &path, std::vector<TextureMip> &mips,
+					std::vector<uint8_t> &palette) {
+  std::printf("%s ktx2 file %s\n", problem, path.c_str());
+  mips.clear();
+  palette.clear();
+  return false;
+}
+
+bool readKTX2(const uint8_t *file, size_t fileSize, const std::string &path, TextureFormat &format,
+			  std::vector<TextureMip> &mips, std::vector<uint8_t> &palette) {
+  KTX2Header header;
+  if (fileSize < sizeof(header)) return badKTX2("truncated", path, mips, palette);
+  std::memcpy(&header, file, sizeof(header));
+  if (std::memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0 ||
+	  header.supercompressionScheme != 0 || header.levelCount == 0) {
+	return badKTX2("unsupported", path, mips, palette);
+  }
+
+  format = static_cast<TextureFormat>(header.vkFormat);
+  if (format != TextureRGBA8 && format != TextureBC1 && format != TextureBC7 && !isPaletteFormat(format)) {
+	return badKTX2("unsupported format in", path, mips, palette);
+  }
+
+  palette.clear();
+  if (isPaletteFormat(format)) {
+	palette = findKTX2Value(file, fileSize, header, KTX2_PALETTE_KEY);
+	if (palette.empty() || palette.size() % 4 != 0 || palette.size() > TEXTURE_PALETTE_MAX_COLORS * 4) {
+	  return badKTX2("missing or bad palette in", path, mips, palette);
+	}
+  }
+
+  if (fileSize < sizeof(header) + sizeof(KTX2Level) * header.levelCount) {
+	return badKTX2("truncated", path, mips, palette);
+  }
+
+  mips.resize(header.levelCount);
+  for (uint32_t i = 0; i < header.levelCount; i++) {
+	KTX2Level level;
+	std::memcpy(&level, file + sizeof(header) + sizeof(KTX2Level) * i, sizeof(level));
+
+	mips[i].width = std::max(header.pixelWidth >> i, 1u);
+	if (format == TexturePalette4) mips[i].width *= 2; // two indices per image texel
+	mips[i].height = std::max(header.pixelHeight >> i, 1u);
+	if (level.byteLength != textureMipBytes(format, mips[i].width, mips[i].height) ||
+		level.byteOffset + level.byteLength > fileSize) {
+	  return badKTX2("bad mip level in", path, mips, palette);
+	}
+	mips[i].data.assign(file + level.byteOffset, file + level.byteOffset + level.byteLength);
+  }
+  return true;
+}
+
+std::string cookedTexturePath(const std::string &sourcePath) {
+  size_t extension = sourcePath.find_last_of('.');
+  size_t directory = sourcePath.find_last_of("/\\");
+  if (extension == std::string::npos || (directory != std::string::npos && extension < directory)) {
+	return sourcePath + ".ktx2";
+  }
+  return sourcePath.substr(0, extension) + ".ktx2";
+}
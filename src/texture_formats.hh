@@ -0,0 +1,73 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+								  Texture Formats
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// NOTE: like mesh_optimizer.hh this knows nothing about vulkan, so the texture cooker
+// (tools/texture_cooker.cpp) can share the mip chain and the container code with the game.
+
+// values are the matching VkFormat so they can be cast straight across
+enum TextureFormat : uint32_t {
+  TexturePalette4 = 1,		// VK_FORMAT_R4G4_UNORM_PACK8, two palette indices per texel (r is the left one)
+  TexturePalette8 = 9,		// VK_FORMAT_R8_UNORM, one palette index per texel
+  TextureRGBA8 = 43,		// VK_FORMAT_R8G8B8A8_SRGB
+  TextureBC1 = 134,		// VK_FORMAT_BC1_RGBA_SRGB_BLOCK, 8 bytes per 4x4 block
+  TextureBC7 = 146,		// VK_FORMAT_BC7_SRGB_BLOCK, 16 bytes per 4x4 block
+};
+
+const uint32_t TEXTURE_PALETTE_MAX_COLORS = 256;
+
+// one mip level, either RGBA8 pixels, 4x4 blocks or palette indices depending on the format.
+// width is always in texels as the game sees them, see textureImageWidth.
+struct TextureMip {
+  uint32_t				width;
+  uint32_t				height;
+  std::vector<uint8_t>	data;
+};
+
+size_t 						textureMipBytes(TextureFormat format, uint32_t width, uint32_t height);
+uint32_t					textureImageWidth(TextureFormat format, uint32_t width); // palette4 is half as wide
+bool						isPaletteFormat(TextureFormat format);
+
+// full chain down to 1x1 from RGBA8 sRGB pixels, halving like vkCmdBlitImage (odd sizes round down)
+std::vector<TextureMip> 	buildMipChain(const uint8_t *pixels, uint32_t width, uint32_t height);
+
+// For flat colored art. If the image has TEXTURE_PALETTE_MAX_COLORS colors or less this
+// builds a chain of palette indices (4 bit when allowed, there are 16 colors or less and the
+// width is even, 8 bit otherwise) plus the RGBA8 sRGB palette. A single color comes back as a
+// 1x1 RGBA8 texture without a palette. Returns false, leaving everything alone, if there are
+// too many colors. Index mips take the most common of the four texels instead of averaging.
+bool						buildPaletteTexture(const uint8_t *pixels, uint32_t width, uint32_t height,
+												bool allow4Bit, TextureFormat &format,
+												std::vector<TextureMip> &mips,
+												std::vector<uint8_t> &palette);
+
+// KTX2 header, level index and data. We don't write a data format descriptor (the
+// vkFormat is all we read back), so strict KTX2 tools may complain about these files.
+// Palettes go in the key/value data under KTX2_PALETTE_KEY. Reading a file that's truncated,
+// corrupt or from an older cooker returns false with mips and palette empty, the caller
+// decodes the source image instead.
+const char *const			KTX2_PALETTE_KEY = "OrcHordePalette";
+
+void 						writeKTX2(const std::string &path, TextureFormat format,
+									  const std::vector<TextureMip> &mips,
+									  const std::vector<uint8_t> &palette);
+bool						readKTX2(const std::string &path, TextureFormat &format,
+									 std::vector<TextureMip> &mips,
+									 std::vector<uint8_t> &palette); // false if there's no such file
+bool						readKTX2(const uint8_t *file, size_t fileSize, const std::string &path,
+									 TextureFormat &format, std::vector<TextureMip> &mips,
+									 std::vector<uint8_t> &palette); // file already in memory, path is for errors
+
+std::string 				cookedTexturePath(const std::string &sourcePath); // foo.png -> foo.ktx2
@@ -12,6 +12,7 @@ SDG
 #include "vendor/tiny_obj_loader.h"
 
 #include "asset.hh"
+#include "profiler.hh"
 
 /* ========================== Asset Base Class ==========================*/
 Asset::Asset(GUID guid, AssetStore &assetStore, Renderer &renderer)
@@ -32,3 +33,39 @@ Asset::Asset(GUID guid, AssetStore &assetStore, Renderer &renderer)
 Asset::~Asset() {
   //if (loaded) unload(); // we MAY actually just want to have this in AssetStore instead
 }
+
+bool Asset::load() {
+  std::unique_lock<std::mutex> lock(stateMutex, std::try_to_lock);
+  if (!lock.owns_lock()) {
+	PROFILE_ZONE("asset load stall"); // the loader thread is in the middle of prefetching this
+	lock.lock();
+  }
+
+  if (loaded) return true;
+  if (failed) return false;
+  if (!prepared) prepared = prepare();
+  if (!prepared) return false;
+
+  upload();
+  prepared = false;
+  loaded = true;
+  return true;
+}
+
+bool Asset::prefetch() {
+  std::lock_guard<std::mutex> lock(stateMutex);
+  if (loaded || prepared) return true;
+  prepared = prepare();
+  return prepared;
+}
+
+void Asset::unload() {
+  std::lock_guard<std::mutex> lock(stateMutex);
+  if (!loaded) return;
+  release();
+  loaded = false;
+}
+
+int Asset::relinquish() {
+  return assetStore.relinquish(guid);
+}
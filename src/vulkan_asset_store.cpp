@@ -7,263 +7,643 @@ SDG
 	        					Asset Store (Vulkan Implementation)
 */
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
 #include "asset.hh"
+#include "profiler.hh"
 
 AssetStore::AssetStore(Renderer &renderer)
   :renderer(renderer)
 {
-  AssetInfo houseMeshInfo {
-	.type = Mesh_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = HOUSE_PATH,
-	.asset = nullptr
-  };
-  assetDb[HOUSE_GUID] = houseMeshInfo;
-
-  AssetInfo houseTextureInfo {
-	.type = Texture_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = HOUSE_TEXTURE_PATH,
-	.asset = nullptr,
-  };
-  assetDb[HOUSE_TEXTURE_GUID] = houseTextureInfo;
-
-  AssetInfo orcMeshInfo {
-	.type = Mesh_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = ORC_PATH,
-	.asset = nullptr
-  };
-  assetDb[ORC_GUID] = orcMeshInfo;
+  for (size_t i = 0; i < ASSET_MANIFEST_SIZE; i++) {
+	const AssetManifestEntry &entry = ASSET_MANIFEST[i];
+	manifestAssets[i] = AssetInfo {
+	  .type = entry.type,
+	  .locationType = entry.locationType,
+	  .assetSize = 0,
+	  .assetLocation = AssetLocation(entry.location),
+	  .asset = nullptr,
+	};
+  }
 
-  AssetInfo orcTextureInfo {
-	.type = Texture_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = ORC_TEXTURE_PATH,
-	.asset = nullptr,
-  };
-  assetDb[ORC_TEXTURE_GUID] = orcTextureInfo;
+  loaderThread = std::thread(&AssetStore::loaderMain, this);
+}
 
-  AssetInfo mapTextureInfo {
-	.type = Texture_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = MAP_TEXTURE_PATH,
-	.asset = nullptr,
-  };
-  assetDb[MAP_TEXTURE_GUID] = mapTextureInfo;
+AssetStore::~AssetStore() {
+  stopLoader();
+  forEachInfo([](AssetInfo &info) {
+	if (info.sharedWith.empty()) delete info.asset; // unloadAll has to have happened while the renderer was still around
+  });
+}
 
-  AssetInfo decoratorMeshInfo {
-	.type = Mesh_e,
-	.locationType = Computed_e,
+// NOTE: only the main thread adds, but the loader thread can be in lookup at the same time
+void AssetStore::addAsset(skyGUID guid, AssetType type, AssetLocationType locationType,
+						  AssetLocation location) {
+  std::lock_guard<std::mutex> lock(assetDbMutex);
+  if (findManifestAsset(guid) >= 0 || assetDb.contains(guid)) {
+	throw std::runtime_error("asset " + guid + " already exists");
+  }
+  assetDb[guid] = AssetInfo {
+	.type = type,
+	.locationType = locationType,
 	.assetSize = 0,
-	.assetLocation = "", // TODO(caleb): add a way to get a computed value here
+	.assetLocation = location,
 	.asset = nullptr,
   };
-  assetDb[DECORATOR_GUID] = decoratorMeshInfo;
+}
 
-  AssetInfo humanMeshInfo {
-	.type = Mesh_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = HUMAN_PATH,
-	.asset = nullptr
-  };
-  assetDb[HUMAN_GUID] = humanMeshInfo;
+// Built in assets are an index into manifestAssets through the manifest's perfect hash,
+// only guids from addAsset go through the map (whose nodes never move, so the reference
+// stays good after the lock).
+AssetInfo &AssetStore::lookup(skyGUIDView guid) {
+  int index = findManifestAsset(guid);
+  if (index >= 0) return manifestAssets[index];
+
+  std::lock_guard<std::mutex> lock(assetDbMutex);
+  auto found = assetDb.find(guid);
+  if (found == assetDb.end()) throw std::out_of_range("unknown asset " + skyGUID(guid));
+  return found->second;
+}
 
-  AssetInfo humanTextureInfo {
-	.type = Texture_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = HUMAN_TEXTURE_PATH,
-	.asset = nullptr,
-  };
-  assetDb[HUMAN_TEXTURE_GUID] = humanTextureInfo;
+bool AssetStore::load(skyGUIDView guid) {
+  Asset *asset = get(guid);
+  std::printf("loading %.*s\n", static_cast<int>(guid.size()), guid.data());
+  return asset->load();
+}
 
-  AssetInfo bulletRegularMeshInfo {
-	.type = Mesh_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = BULLET_MESH_PATH_REGULAR,
-	.asset = nullptr
-  };
-  assetDb[BULLET_MESH_GUID_REGULAR] = bulletRegularMeshInfo;
+bool AssetStore::load(std::vector<skyGUID> guids) {
+  bool allLoaded = true;
+  for ( skyGUID guid : guids ) {
+	allLoaded == allLoaded && load(guid);
+  }
+  return allLoaded;
+}
 
-  AssetInfo bulletRegularTextureInfo {
-	.type = Texture_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = BULLET_TEXTURE_PATH_REGULAR,
-	.asset = nullptr,
-  };
-  assetDb[BULLET_TEXTURE_GUID_REGULAR] = bulletRegularTextureInfo;
+Asset *AssetStore::get(skyGUIDView guid) {
+  // TODO(caleb): See how this is used
+  // because we may just want to load the asset here
+  return findOrCreate(guid);
+}
 
-  AssetInfo bulletSuperMeshInfo {
-	.type = Mesh_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = BULLET_MESH_PATH_SUPER,
-	.asset = nullptr
-  };
-  assetDb[BULLET_MESH_GUID_SUPER] = bulletSuperMeshInfo;
+/* ============================== Deduplication ============================== */
 
-  AssetInfo bulletSuperTextureInfo {
-	.type = Texture_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = BULLET_TEXTURE_PATH_SUPER,
-	.asset = nullptr,
-  };
-  assetDb[BULLET_TEXTURE_GUID_SUPER] = bulletSuperTextureInfo;
+static const AssetPackEntry *packedAsset(const AssetLocation &path) {
+  const AssetPack &pack = gameAssetPack();
+  return pack.isOpen() ? pack.find(assetPackName(path)) : nullptr;
+}
 
-  AssetInfo explosionMeshInfo {
-	.type = Mesh_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = EXPLOSION_PATH,
-	.asset = nullptr
-  };
-  assetDb[EXPLOSION_GUID] = explosionMeshInfo;
+// FNV-1a over the file and the asset type, only a bucket key for spotting identical files
+// (sameAssetBytes has the final say) so it doesn't need to be strong. Packed files have their hash in the pack index already. False if the
+// file can't be found. Fine on the loader thread, the pack never changes once it's open.
+static bool hashAssetFile(const AssetLocation &path, AssetType type, uint64_t &hash) {
+  const AssetPackEntry *entry = packedAsset(path);
+  if (entry != nullptr) {
+	hash = entry->contentHash;
+  } else {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) return false;
 
-  AssetInfo explosionTextureInfo {
-	.type = Texture_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = EXPLOSION_TEXTURE_PATH,
-	.asset = nullptr,
-  };
-  assetDb[EXPLOSION_TEXTURE_GUID] = explosionTextureInfo;
+	hash = ASSET_HASH_SEED;
+	char buffer[64 * 1024];
+	while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+	  hash = hashAssetBytes(reinterpret_cast<const uint8_t *>(buffer), static_cast<size_t>(file.gcount()), hash);
+	}
+  }
 
-  AssetInfo explosionSuperMeshInfo {
-	.type = Mesh_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = SUPER_EXPLOSION_PATH,
-	.asset = nullptr
-  };
-  assetDb[SUPER_EXPLOSION_GUID] = explosionSuperMeshInfo;
+  const uint8_t typeByte = static_cast<uint8_t>(type);
+  hash = hashAssetBytes(&typeByte, 1, hash);
+  return true;
+}
 
-  AssetInfo explosionSuperTextureInfo {
-	.type = Texture_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = SUPER_EXPLOSION_TEXTURE_PATH,
-	.asset = nullptr,
-  };
-  assetDb[SUPER_EXPLOSION_TEXTURE_GUID] = explosionSuperTextureInfo;
+// bytes in the pack or on disk, without reading them. False if it's in neither.
+static bool assetByteSize(const AssetLocation &path, uint64_t &size) {
+  const AssetPackEntry *entry = packedAsset(path);
+  if (entry != nullptr) {
+	size = entry->rawSize;
+	return true;
+  }
+  std::error_code error;
+  size = std::filesystem::file_size(path, error);
+  return !error;
+}
 
-  AssetInfo humanDeadMeshInfo {
-	.type = Mesh_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = HUMAN_DEAD_PATH,
-	.asset = nullptr
-  };
-  assetDb[HUMAN_DEAD_GUID] = humanDeadMeshInfo;
+// The hash only picks out candidates, two guids share an asset once their files are the
+// same byte for byte. Sizes first, they don't need a read.
+static bool sameAssetBytes(const AssetLocation &a, const AssetLocation &b) {
+  uint64_t sizeA, sizeB;
+  if (!assetByteSize(a, sizeA) || !assetByteSize(b, sizeB) || sizeA != sizeB) return false;
 
-  AssetInfo humanDeadTextureInfo{
-	.type = Texture_e,
-	.locationType = File_e,
-	.assetSize = 0,
-	.assetLocation = HUMAN_DEAD_TEXTURE_PATH,
-	.asset = nullptr
-  };
-  assetDb[HUMAN_DEAD_TEXTURE_GUID] = humanDeadTextureInfo;
+  AssetBytes bytesA, bytesB;
+  if (!readAssetBytes(a, bytesA) || !readAssetBytes(b, bytesB)) return false;
+  return bytesA.size == bytesB.size &&
+	(bytesA.size == 0 || std::memcmp(bytesA.data, bytesB.data, bytesA.size) == 0);
 }
 
-bool AssetStore::load(skyGUID guid) {
-  Asset *asset = get(guid);
-  std::printf("loading %s\n", guid.c_str());
-  return asset->load();
+AssetInfo &AssetStore::ownerInfo(skyGUIDView guid) {
+  AssetInfo &info = lookup(guid);
+  return info.sharedWith.empty() ? info : lookup(info.sharedWith);
 }
 
-bool AssetStore::load(std::vector<skyGUID> guids) {
-  bool allLoaded = true;
-  for ( skyGUID guid : guids ) {
-	allLoaded == allLoaded && load(guid);
-  }
-  return allLoaded;
+std::string AssetStore::pathKey(const AssetInfo &info) {
+  return std::to_string(info.type) + ":" + std::filesystem::path(info.assetLocation).lexically_normal().string();
 }
 
-Asset *AssetStore::get(skyGUID guid) {
-  AssetInfo info = assetDb.at(guid);
+// Different guids for the same file (or a byte for byte copy of it) share one Asset, so
+// they load and upload once and Mesh::display puts their instances into the same draw.
+// A loose file the loader thread already hashed (prefetchZone) isn't read again here.
+Asset *AssetStore::findOrCreate(skyGUIDView guid) {
+  AssetInfo &info = lookup(guid);
+  if (info.asset != nullptr) return info.asset;
+
+  if (info.locationType == File_e) {
+	skyGUID owner;
+	std::string key = pathKey(info);
+	uint64_t contentHash;
+
+	auto samePath = assetsByPath.find(key);
+	if (samePath != assetsByPath.end()) {
+	  owner = samePath->second;
+	} else {
+	  assetsByPath[key] = skyGUID(guid);
+	  auto prehashed = fileHashes.find(key);
+	  bool found = prehashed != fileHashes.end();
+	  if (found) {
+		contentHash = prehashed->second;
+		fileHashes.erase(prehashed);
+	  } else {
+		found = hashAssetFile(info.assetLocation, info.type, contentHash);
+	  }
+	  if (found) {
+		auto [candidate, last] = assetsByContent.equal_range(contentHash);
+		for (; candidate != last && owner.empty(); ++candidate) {
+		  const AssetInfo &other = lookup(candidate->second);
+		  if (other.type == info.type && sameAssetBytes(info.assetLocation, other.assetLocation)) {
+			owner = candidate->second;
+		  }
+		}
+		if (owner.empty()) assetsByContent.emplace(contentHash, skyGUID(guid));
+	  }
+	}
 
-  // TODO(caleb): See how this is used
-  // because we may just want to load the asset here
-  if (info.asset != nullptr) {
-	return info.asset;
-  } else {
-	Asset *asset;
-	switch (info.type) {
-	case Texture_e:
-	  asset = new Texture(guid, *this, renderer);
-	  break;
-	case Mesh_e:
-	  asset = new Mesh(guid, *this, renderer);
-	  break;
-	default:
-	  throw std::logic_error("other types of assets not yet defined!");
+	if (!owner.empty()) {
+	  std::printf("asset %.*s shares %s (%s)\n", static_cast<int>(guid.size()), guid.data(),
+				  owner.c_str(), info.assetLocation.c_str());
+	  info.sharedWith = owner;
+	  info.asset = findOrCreate(owner);
+	  return info.asset;
 	}
+  }
 
-	assetDb[guid].asset = asset;
-	return asset;
+  switch (info.type) {
+  case Texture_e:
+	info.asset = new Texture(skyGUID(guid), *this, renderer);
+	break;
+  case Mesh_e:
+	info.asset = new Mesh(skyGUID(guid), *this, renderer);
+	break;
+  default:
+	throw std::logic_error("other types of assets not yet defined!");
   }
+  return info.asset;
+}
+
+// NOTE: this never waits on the asset. If it isn't loaded (never was or got evicted) it goes
+// to the loader thread and shows up a few frames later, until then Mesh::display draws
+// nothing and Texture::getLayerOffset hands out the renderer's placeholder.
+Asset *AssetStore::claim(skyGUIDView guid) {
+  Asset *asset = findOrCreate(guid);
+  if (!asset->loaded) queueLoad(asset);
+  ownerInfo(guid).claims++;
+  return asset;
 }
 
-Texture *AssetStore::getTexture(skyGUID guid) {
-  AssetInfo info;
+Texture *AssetStore::getTexture(skyGUIDView guid) {
   try {
-	info = assetDb.at(guid);
-	if (info.type != Texture_e) {
-	  std::printf("Got bad GUID %s \n", guid.c_str());
+	AssetType type = lookup(guid).type;
+	if (type != Texture_e) {
+	  std::printf("Got bad GUID %.*s \n", static_cast<int>(guid.size()), guid.data());
 	}
-	assert(info.type == Texture_e);
+	assert(type == Texture_e);
   } catch (const std::out_of_range& ex) {
 	return nullptr; // TODO: remove this eventually
   }
 
-  if (info.asset != nullptr) {
-	return static_cast<Texture *>(info.asset);
-  } else {
-	assetDb[guid].asset = new Texture(guid, *this, renderer);
-	return static_cast<Texture *>(assetDb[guid].asset);
-  }
+  return static_cast<Texture *>(claim(guid));
 }
 
-Mesh *AssetStore::getMesh(skyGUID guid) {
-  AssetInfo info;
+Mesh *AssetStore::getMesh(skyGUIDView guid) {
   try {
-	info = assetDb.at(guid);
-	assert(info.type == Mesh_e);
+	AssetType type = lookup(guid).type;
+	assert(type == Mesh_e);
   } catch (const std::out_of_range& ex) {
 	return nullptr; // TODO: remove this eventually
   }
 
+  return static_cast<Mesh *>(claim(guid));
+}
 
-  if (info.asset != nullptr) {
-	return static_cast<Mesh *>(info.asset);
-  } else {
-	assetDb[guid].asset = new Mesh(guid, *this, renderer);
-	return static_cast<Mesh *>(assetDb[guid].asset);
+AssetLoad<Asset> AssetStore::loadAsync(skyGUIDView guid) {
+  return AssetLoad<Asset>{ .assetStore = *this, .asset = claim(guid) };
+}
+
+AssetLoad<Texture> AssetStore::loadTextureAsync(skyGUIDView guid) {
+  assert(lookup(guid).type == Texture_e);
+  return AssetLoad<Texture>{ .assetStore = *this, .asset = static_cast<Texture *>(claim(guid)) };
+}
+
+AssetLoad<Mesh> AssetStore::loadMeshAsync(skyGUIDView guid) {
+  assert(lookup(guid).type == Mesh_e);
+  return AssetLoad<Mesh>{ .assetStore = *this, .asset = static_cast<Mesh *>(claim(guid)) };
+}
+
+int AssetStore::relinquish(skyGUIDView guid) {
+  AssetInfo &info = ownerInfo(guid);
+  assert(info.claims > 0);
+  if (--info.claims == 0) info.releasedOnFrame = frame;
+  return info.claims;
+}
+
+void AssetStore::unload(skyGUIDView guid) {
+  AssetInfo &info = ownerInfo(guid);
+  if (info.claims > 0) {
+	std::printf("not unloading %.*s, it still has %d claims\n", static_cast<int>(guid.size()), guid.data(),
+				info.claims);
+	return;
   }
+  forceUnload(guid);
+}
+
+void AssetStore::forceUnload(skyGUIDView guid) {
+  unloadInfo(ownerInfo(guid));
+}
+
+void AssetStore::unloadInfo(AssetInfo &info) {
+  if (info.asset == nullptr || !info.asset->loaded) return;
+  info.asset->unload();
+  info.assetSize = 0;
+}
+
+void AssetStore::unloadAll() {
+  stopLoader();
+
+  // their frames go, the claims they had are reported below like any other
+  for (const AssetWaiter &waiter : waiters) waiter.handle.destroy();
+  waiters.clear();
+
+  forEachInfo([this](AssetInfo &info) {
+	if (!info.sharedWith.empty()) return;
+	if (info.claims > 0) std::printf("unloading %s with %d claims left\n", info.asset->guid.c_str(), info.claims);
+	unloadInfo(info);
+  });
 }
 
-AssetLocation AssetStore::getLocation(skyGUID guid) {
+// NOTE: these get called from the loader thread (Asset::prepare), so they only read the
+// fields that never change after the info is created.
+AssetLocation AssetStore::getLocation(skyGUIDView guid) {
   // TODO(caleb): AssetLocation is a string, should it be a struct
   // with AssetLocationType on it?
-  AssetInfo info = assetDb[guid];
-  return info.assetLocation;
+  return lookup(guid).assetLocation;
 }
 
 
-AssetLocationType AssetStore::getLocationType(skyGUID guid) {
+AssetLocationType AssetStore::getLocationType(skyGUIDView guid) {
   // TODO(caleb): AssetLocation is a string, should it be a struct
   // with AssetLocationType on it?
-  AssetInfo info = assetDb[guid];
-  return info.locationType;
+  return lookup(guid).locationType;
+}
+
+void AssetStore::update(const RenderState &renderState) {
+  frame++;
+  createHashed();
+  uploadPrefetched();
+  resumeWaiters();
+  if (failedAssets > 0) Profiler::addCounter("failed assets", static_cast<double>(failedAssets));
+  updateTextureStreaming(renderState);
+  evictUnused();
+}
+
+/* ================================= Zones ================================= */
+
+// Claiming the new zone before giving back the old one keeps assets both zones share from
+// ever dropping to zero claims. Whatever only the old zone needed (and no game object still
+// claims) is unloaded right away rather than waiting for evictUnused to run over budget.
+// Nothing here waits on a load, prefetched assets are uploaded over the next few frames.
+void AssetStore::enterZone(const ZoneManifest &next) {
+  PROFILE_ZONE("zone transition");
+  auto start = ProfileClock::now();
+
+  for (skyGUIDView guid : next.assets) claim(guid);
+
+  if (zone != nullptr) {
+	for (skyGUIDView guid : zone->assets) relinquish(guid);
+	for (skyGUIDView guid : zone->assets) {
+	  if (ownerInfo(guid).claims == 0) forceUnload(guid);
+	}
+  }
+  zone = &next;
+
+  std::chrono::duration<double, std::milli> elapsed = ProfileClock::now() - start;
+  Profiler::addCounter("zone transition ms", elapsed.count());
+  std::printf("entered zone %s in %.2f ms\n", next.name, elapsed.count());
+}
+
+// Nothing here reads a file. A loose file findOrCreate hasn't seen yet would have to be
+// hashed first, so that goes to the loader thread and createHashed takes it from there.
+void AssetStore::prefetchZone(const ZoneManifest &next) {
+  for (skyGUIDView guid : next.assets) {
+	AssetInfo &info = lookup(guid);
+	if (info.asset == nullptr && info.locationType == File_e && packedAsset(info.assetLocation) == nullptr) {
+	  std::string key = pathKey(info);
+	  if (!assetsByPath.contains(key) && !fileHashes.contains(key)) {
+		queueHash(guid);
+		continue;
+	  }
+	}
+	Asset *asset = findOrCreate(guid);
+	if (!asset->loaded) queueLoad(asset);
+  }
+}
+
+size_t AssetStore::residentCount(const ZoneManifest &zone) {
+  size_t resident = 0;
+  for (skyGUIDView guid : zone.assets) {
+	Asset *asset = ownerInfo(guid).asset;
+	if (asset != nullptr && asset->loaded) resident++;
+  }
+  return resident;
+}
+
+bool AssetStore::isResident(const ZoneManifest &zone) {
+  return residentCount(zone) == zone.assets.size();
+}
+
+// an asset already on its way (queued, being read or waiting for upload) isn't queued twice,
+// and one that failed isn't queued again
+void AssetStore::queueLoad(Asset *asset) {
+  if (asset->failed) return;
+  std::lock_guard<std::mutex> lock(loaderMutex);
+  if (asset->queued) return;
+  asset->queued = true;
+  prefetchQueue.push_back(asset);
+  loaderWake.notify_one();
+}
+
+void AssetStore::queueHash(skyGUIDView guid) {
+  std::lock_guard<std::mutex> lock(loaderMutex);
+  hashQueue.emplace_back(guid);
+  loaderWake.notify_one();
+}
+
+// the rest of prefetchZone for the files the loader thread hashed. A claim may have created
+// the asset in the meantime, then the hash is simply not needed anymore.
+void AssetStore::createHashed() {
+  std::deque<HashedFile> done;
+  {
+	std::lock_guard<std::mutex> lock(loaderMutex);
+	done.swap(hashed);
+  }
+  for (const HashedFile &file : done) {
+	AssetInfo &info = lookup(file.guid);
+	if (file.found && info.asset == nullptr) fileHashes[pathKey(info)] = file.hash;
+	Asset *asset = findOrCreate(file.guid);
+	if (!asset->loaded) queueLoad(asset);
+  }
+}
+
+void AssetStore::loaderMain() {
+  std::unique_lock<std::mutex> lock(loaderMutex);
+  while (true) {
+	loaderWake.wait(lock, [this] { return loaderQuit || !prefetchQueue.empty() || !hashQueue.empty(); });
+	if (loaderQuit) return;
+
+	// hashes first, their assets can't even be queued until they're done
+	if (!hashQueue.empty()) {
+	  skyGUID guid = std::move(hashQueue.front());
+	  hashQueue.pop_front();
+	  lock.unlock();
+
+	  const AssetInfo &info = lookup(guid);
+	  HashedFile file { .guid = guid, .found = false, .hash = 0 };
+	  file.found = hashAssetFile(info.assetLocation, info.type, file.hash);
+
+	  lock.lock();
+	  hashed.push_back(std::move(file));
+	  continue;
+	}
+
+	Asset *asset = prefetchQueue.front();
+	prefetchQueue.pop_front();
+	lock.unlock();
+
+	// failures go to the main thread too, uploadPrefetched gives up on the asset there
+	try {
+	  if (!asset->prefetch()) asset->failure = "nothing to load";
+	} catch (const std::exception &e) {
+	  asset->failure = e.what();
+	}
+
+	lock.lock();
+	prefetched.push_back(asset);
+  }
 }
 
+void AssetStore::stopLoader() {
+  if (!loaderThread.joinable()) return;
+  {
+	std::lock_guard<std::mutex> lock(loaderMutex);
+	loaderQuit = true;
+	for (Asset *asset : prefetchQueue) asset->queued = false;
+	prefetchQueue.clear();
+	hashQueue.clear();
+  }
+  loaderWake.notify_one();
+  loaderThread.join();
+}
+
+// Uploads are synchronous (single time commands), so they stop once a frame has spent
+// ASSET_UPLOAD_BUDGET_MS on them and the rest wait for the next frame. Uploaded assets count
+// as just released, otherwise evictUnused would throw them out first.
+void AssetStore::uploadPrefetched() {
+  PROFILE_ZONE("prefetch upload");
+  auto start = ProfileClock::now();
+
+  while (std::chrono::duration<double, std::milli>(ProfileClock::now() - start).count() < ASSET_UPLOAD_BUDGET_MS) {
+	Asset *asset;
+	{
+	  std::lock_guard<std::mutex> lock(loaderMutex);
+	  if (prefetched.empty()) return;
+	  asset = prefetched.front();
+	  prefetched.pop_front();
+	  asset->queued = false;
+	}
+	if (asset->loaded) continue; // something loaded it synchronously in the meantime
+	if (!asset->failure.empty()) {
+	  fail(asset, asset->failure);
+	  continue;
+	}
+
+	// NOTE: nothing thrown here may leave update, that would end the game over one bad file
+	try {
+	  if (!asset->load()) {
+		fail(asset, "nothing to load");
+		continue;
+	  }
+	} catch (const std::exception &e) {
+	  fail(asset, e.what());
+	  continue;
+	}
+	ownerInfo(asset->guid).releasedOnFrame = frame;
+  }
+}
+
+// Claims on it stay good and keep drawing with the placeholder, it just never loads. Tasks
+// waiting on it are let go (see resumeWaiters), with the placeholder too.
+void AssetStore::fail(Asset *asset, const std::string &why) {
+  if (asset->failed) return;
+  asset->failed = true;
+  failedAssets++;
+  std::printf("asset %s failed to load, keeping its placeholder: %s\n", asset->guid.c_str(), why.c_str());
+}
+
+// NOTE: uploads wait for their timeline value (endSingleTimeCommands), so a loaded asset's
+// upload is already done on the gpu. Resumed tasks can co_await again, those land in
+// waiters for a later frame rather than in the list we're going through.
+void AssetStore::resumeWaiters() {
+  if (waiters.empty()) return;
+  PROFILE_ZONE("asset task resume");
+
+  std::vector<std::coroutine_handle<>> ready;
+  std::erase_if(waiters, [&ready](const AssetWaiter &waiter) {
+	if (!waiter.asset->loaded && !waiter.asset->failed) return false;
+	ready.push_back(waiter.handle);
+	return true;
+  });
+  for (std::coroutine_handle<> handle : ready) handle.resume();
+
+  Profiler::addCounter("asset task frames", static_cast<double>(AssetTaskFramePool::framesInUse()));
+}
+
+/* ============================== Texture Streaming ============================== */
+
+// NOTE: uploads are still synchronous (single time commands), so we only stream one
+// texture per frame, picking whichever is furthest from the mip it wants.
+void AssetStore::updateTextureStreaming(const RenderState &renderState) {
+  PROFILE_ZONE("texture streaming");
+
+  std::vector<Texture *> textures;
+  residentTextureBytes = 0;
+  forEachInfo([&](AssetInfo &info) {
+	if (info.type != Texture_e || info.asset == nullptr || !info.asset->loaded) return;
+	if (!info.sharedWith.empty()) return;
+	Texture *texture = static_cast<Texture *>(info.asset);
+
+	auto demand = renderState.textureScreenSize.find(texture->getLayerOffset());
+	if (demand != renderState.textureScreenSize.end()) {
+	  texture->lastUsedFrame = frame;
+	  texture->wantedMip = texture->mipForScreenSize(demand->second);
+	}
+
+	residentTextureBytes += texture->residentBytes;
+	textures.push_back(texture);
+  });
+
+  Texture *request = nullptr;
+  for (Texture *texture : textures) {
+	if (texture->lastUsedFrame != frame || texture->wantedMip >= texture->residentMip) continue;
+	if (request == nullptr ||
+		texture->residentMip - texture->wantedMip > request->residentMip - request->wantedMip) {
+	  request = texture;
+	}
+  }
+
+  if (request != nullptr) {
+	VkDeviceSize budget = renderer.config.textureBudget;
+
+	// least recently used first, anything drawn this frame is left alone
+	std::sort(textures.begin(), textures.end(),
+			  [](Texture *a, Texture *b) { return a->lastUsedFrame < b->lastUsedFrame; });
+
+	VkDeviceSize needed = request->chainBytes(request->wantedMip) - request->residentBytes;
+	for (Texture *texture : textures) {
+	  if (residentTextureBytes + needed <= budget) break;
+	  if (texture->lastUsedFrame == frame || texture->residentMip == texture->baseMip()) continue;
+
+	  residentTextureBytes -= texture->residentBytes;
+	  texture->loadLOD(texture->baseMip());
+	  residentTextureBytes += texture->residentBytes;
+	}
+
+	// if the full request doesn't fit, settle for the finest mip that does
+	for (uint32_t mip = request->wantedMip; mip < request->residentMip; mip++) {
+	  VkDeviceSize bytes = request->chainBytes(mip);
+	  if (residentTextureBytes - request->residentBytes + bytes <= budget) {
+		residentTextureBytes -= request->residentBytes;
+		request->loadLOD(mip);
+		residentTextureBytes += request->residentBytes;
+		break;
+	  }
+	}
+  }
+
+  Profiler::addCounter("texture resident MB", residentTextureBytes / (1024.0 * 1024.0));
+}
+
+VkDeviceSize AssetStore::getResidentTextureBytes() {
+  return residentTextureBytes;
+}
+
+/* =============================== Eviction =============================== */
+
+// Totals are recomputed every frame, there are only a handful of assets. Sizes come from
+// the assets themselves (Asset::cpuSize/gpuSize) and end up in AssetInfo::assetSize.
+void AssetStore::evictUnused() {
+  PROFILE_ZONE("asset eviction");
+
+  struct Resident {
+	AssetInfo *	info;
+	AssetSize	cpu;
+	AssetSize	gpu;
+  };
+
+  std::vector<Resident> unclaimed;
+  AssetSize cpuBytes = 0, gpuBytes = 0;
+  forEachInfo([&](AssetInfo &info) {
+	if (info.asset == nullptr || !info.asset->loaded || !info.sharedWith.empty()) {
+	  info.assetSize = 0;
+	  return;
+	}
+
+	Resident resident { &info, info.asset->cpuSize(), info.asset->gpuSize() };
+	info.assetSize = resident.cpu + resident.gpu;
+	cpuBytes += resident.cpu;
+	gpuBytes += resident.gpu;
+	if (info.claims == 0) unclaimed.push_back(resident);
+  });
+
+  AssetSize cpuBudget = renderer.config.assetCpuBudget;
+  AssetSize gpuBudget = renderer.config.assetGpuBudget;
+  if (cpuBytes > cpuBudget || gpuBytes > gpuBudget) {
+	std::sort(unclaimed.begin(), unclaimed.end(), [](const Resident &a, const Resident &b) {
+	  return a.info->releasedOnFrame < b.info->releasedOnFrame;
+	});
+
+	for (const Resident &resident : unclaimed) {
+	  if (cpuBytes <= cpuBudget && gpuBytes <= gpuBudget) break;
+
+	  std::printf("evicting %s (%zu cpu bytes, %zu gpu bytes, unclaimed since frame %llu)\n",
+				  resident.info->asset->guid.c_str(), resident.cpu, resident.gpu,
+				  static_cast<unsigned long long>(resident.info->releasedOnFrame));
+	  resident.info->asset->unload();
+	  resident.info->assetSize = 0;
+	  cpuBytes -= resident.cpu;
+	  gpuBytes -= resident.gpu;
+	}
+  }
+
+  Profiler::addCounter("asset cpu MB", cpuBytes / (1024.0 * 1024.0));
+  Profiler::addCounter("asset gpu MB", gpuBytes / (1024.0 * 1024.0));
+}
@@ -7,79 +7,105 @@ SDG
 							  Vulkan Mesh Implementation
 */
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include "asset.hh"
+#include "mesh_optimizer.hh"
+#include "obj_loader.hh"
 
 Mesh::Mesh(skyGUID guid, AssetStore &assetStore, Renderer &renderer)
   : Asset(guid, assetStore, renderer)
 {}
 
-bool Mesh::load() {
-  if (loaded) return true;
-
+// runs on the loader thread when prefetched, parsing and optimizing is most of the work
+bool Mesh::prepare() {
   switch (assetStore.getLocationType(guid)) {
-  case File_e: 		return loadFromFile();
-  case Computed_e:	return loadComputed();
+  case File_e: 		return prepareFromFile();
+  case Computed_e:	return prepareComputed();
   default: 			throw std::logic_error("Only file and computed meshes can be loaded for meshes");
   }
-
-  return false;
 }
 
-bool Mesh::loadFromFile() {
+bool Mesh::prepareFromFile() {
   std::string modelPath = assetStore.getLocation(guid);
 
-  tinyobj::attrib_t attrib;
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
-  std::string err;
+  AssetBytes file;
+  if (!readAssetBytes(modelPath, file)) {
+	throw std::runtime_error("failed to open model " + modelPath);
+  }
 
-  if (!tinyobj::LoadObj(&attrib, &shapes, &materials,
-						 &err, modelPath.c_str())) {
-	throw std::runtime_error(err);
+  // parses straight out of the asset pack's mapping, corners already deduped
+  ObjMesh obj;
+  loadObj(file.data, file.size, modelPath.c_str(), obj);
+
+  std::vector<Vertex> vertices(obj.vertices.size());
+  for (size_t i = 0; i < obj.vertices.size(); i++) {
+	const ObjVertex &source = obj.vertices[i];
+	vertices[i].pos = { source.pos[0], source.pos[1], source.pos[2] };
+	vertices[i].texCoord = { source.texCoord[0], 1.0f - source.texCoord[1] };
+	vertices[i].color = { 1.0f, 1.0f, 1.0f };
   }
+  std::vector<Index> indices = std::move(obj.indices);
 
-  std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+  optimize(vertices, indices);
+  pendingVertices = std::move(vertices);
+  return true;
+}
 
-  std::vector<Vertex> vertices{};
-  std::vector<Index> indices{};
+// NOTE: this runs on every load for now, it's a few ms for the biggest model we have.
+// If that stops being true it should move into an offline cooking step.
+void Mesh::optimize(std::vector<Vertex> &vertices, std::vector<Index> &indices) {
+  // an empty (or all degenerate) OBJ, there's nothing to draw and no first vertex to point at
+  if (vertices.empty() || indices.empty()) {
+	throw std::runtime_error("mesh " + guid + " has no triangles");
+  }
+  const float *positions = &vertices.data()->pos.x;
+  float acmrBefore = computeACMR(indices, vertices.size());
 
-  for (const auto &shape : shapes) {
-	for (const auto &index : shape.mesh.indices) {
-	  Vertex vertex{};
+  optimizeVertexCache(indices, vertices.size());
+  optimizeOverdraw(indices, positions, sizeof(Vertex), vertices.size());
 
-	  vertex.pos = {
-		attrib.vertices[3 * index.vertex_index + 0],
-		attrib.vertices[3 * index.vertex_index + 1],
-		attrib.vertices[3 * index.vertex_index + 2]
-	  };
+  lod.clear();
+  lod.push_back(MeshLOD{ .indices = indices });
 
-	  vertex.texCoord = {
-		attrib.texcoords[2 * index.texcoord_index + 0],
-		1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-	  };
+  // every level is simplified from the full mesh so its error is against the real thing
+  size_t targetIndexCount = indices.size();
+  while (lod.size() < MESH_MAX_LODS) {
+	targetIndexCount = (targetIndexCount / 6) * 3;
+	if (targetIndexCount == 0) break;
 
-	  vertex.color = {1.0f, 1.0f, 1.0f};
+	float error;
+	auto simplified = simplifyMesh(indices, positions, sizeof(Vertex), vertices.size(),
+								   targetIndexCount, error);
+	if (simplified.size() > lod.back().indices.size() * MESH_LOD_MIN_REDUCTION) break;
 
-	  if (uniqueVertices.count(vertex) == 0) {
-		uniqueVertices[vertex] = static_cast<Index>(vertices.size());
-		vertices.push_back(vertex);
-	  }
+	optimizeVertexCache(simplified, vertices.size());
+	lod.push_back(MeshLOD{ .indices = simplified, .error = std::max(error, lod.back().error) });
+  }
 
-	  indices.push_back(uniqueVertices[vertex]);
-	}
+  // levels only drop vertices, so ordering by the full mesh keeps all of them valid
+  size_t usedVertexCount;
+  auto remap = optimizeVertexFetch(lod[0].indices, vertices.size(), usedVertexCount);
+  for (size_t level = 1; level < lod.size(); level++) {
+	for (Index &index : lod[level].indices) index = remap[index];
   }
+  vertices = remapVertices(vertices, remap, usedVertexCount);
 
-  vertices_st.size = static_cast<uint32_t>(vertices.size()); // not currently used
-  indices_st.size = static_cast<uint32_t>(indices.size());
-  renderer.createVertexBuffer(vertices, vertices_st.buffer, vertices_st.memory);
-  renderer.createIndexBuffer(indices, indices_st.buffer, indices_st.memory);
-  return true;
+  std::printf("mesh %s: %zu vertices, %zu triangles, ACMR %.3f -> %.3f\n",
+			  guid.c_str(), vertices.size(), lod[0].indices.size() / 3,
+			  acmrBefore, computeACMR(lod[0].indices, vertices.size()));
+  for (size_t level = 1; level < lod.size(); level++) {
+	std::printf("    lod %zu: %zu triangles, error %.4f\n",
+				level, lod[level].indices.size() / 3, lod[level].error);
+  }
 }
 
 // TODO(Caleb): You want to get passed a function pointer or something here
 // but right now the only thing we're computing is the Plane shape so we don't generalize it.
-bool Mesh::loadComputed() {
-  const std::vector<Vertex> vertices = {
+bool Mesh::prepareComputed() {
+  pendingVertices = {
 	/*     Position                 Color           Texture (UV) */
 	{ {-0.5f, -0.5f, 0.0f},	 {1.0f, 0.0f, 0.0f}, 	{0.0f, 1.0f} },
     { {0.5f, -0.5f, 0.0f},	 {0.0f, 1.0f, 0.0f}, 	{1.0f, 1.0f} },
@@ -88,33 +114,159 @@ bool Mesh::loadComputed() {
   };
   
   const std::vector<Index> indices = { 0, 1, 2, 2, 3, 0 };
-  
-  vertices_st.size = static_cast<uint32_t>(vertices.size()); // not currently used
-  indices_st.size = static_cast<uint32_t>(indices.size());
-  renderer.createVertexBuffer(vertices, vertices_st.buffer, vertices_st.memory);
-  renderer.createIndexBuffer(indices, indices_st.buffer, indices_st.memory);
+
+  lod.clear();
+  lod.push_back(MeshLOD{ .indices = indices });
   return true;
 }
 
-void Mesh::unload() {
-  renderer.destroyBuffer(vertices_st.buffer);
-  renderer.freeMemory(vertices_st.memory);
+// positions are stored as unorm16 within the mesh bounds, base.vert maps them
+// back with the MeshConstants pushed for each draw. The renderer's builtin meshes
+// go through here too.
+std::vector<QuantizedVertex> quantizeVertices(const std::vector<Vertex> &vertices,
+											  MeshConstants &meshConstants) {
+  glm::vec3 boundsMin(std::numeric_limits<float>::max());
+  glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+  for (const auto &vertex : vertices) {
+	boundsMin = glm::min(boundsMin, vertex.pos);
+	boundsMax = glm::max(boundsMax, vertex.pos);
+  }
+
+  glm::vec3 extent = boundsMax - boundsMin;
+  meshConstants.boundsMin = glm::vec4(boundsMin, 0.0f);
+  meshConstants.boundsExtent = glm::vec4(extent, 0.0f);
 
-  renderer.destroyBuffer(indices_st.buffer);
-  renderer.freeMemory(indices_st.memory);
+  // flat meshes (like the decorator plane) have no extent along one axis
+  glm::vec3 inverseExtent(extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+						  extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+						  extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+
+  std::vector<QuantizedVertex> quantized(vertices.size());
+  for (size_t i = 0; i < vertices.size(); i++) {
+	glm::vec3 normalized = glm::clamp((vertices[i].pos - boundsMin) * inverseExtent, 0.0f, 1.0f);
+	for (int axis = 0; axis < 3; axis++) {
+	  quantized[i].pos[axis] = static_cast<uint16_t>(std::round(normalized[axis] * 65535.0f));
+	}
+	quantized[i].pos[3] = 0;
+	quantized[i].texCoord = glm::packHalf2x16(vertices[i].texCoord);
+  }
+
+  return quantized;
+}
+
+void Mesh::upload() {
+  const std::vector<Vertex> &vertices = pendingVertices;
+  vertices_st.size = static_cast<uint32_t>(vertices.size()); // not currently used
+
+  radius = 0.0f;
+  for (const auto &vertex : vertices) radius = std::max(radius, glm::length(vertex.pos));
+
+  if (renderer.config.vertexFormat == VertexQuantized) {
+	auto quantized = quantizeVertices(vertices, meshConstants);
+	renderer.createVertexBuffer(quantized, vertices_st.buffer, vertices_st.memory);
+	std::printf("mesh %s: %zu vertices, %zu bytes quantized (%zu bytes unquantized)\n",
+				guid.c_str(), vertices.size(),
+				quantized.size() * sizeof(QuantizedVertex), vertices.size() * sizeof(Vertex));
+  } else {
+	meshConstants = MeshConstants{};
+	renderer.createVertexBuffer(vertices, vertices_st.buffer, vertices_st.memory);
+  }
+
+  indexType = vertices.size() <= UINT16_MAX ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+  // NOTE: the levels are small enough that we just keep all of them resident for now
+  for (size_t level = 0; level < lod.size(); level++) load(static_cast<LOD>(level));
+
+  pendingVertices.clear();
+  pendingVertices.shrink_to_fit();
+}
+
+void Mesh::release() {
+  // frames in flight may still be drawing with these
+  renderer.retireBuffer(vertices_st.buffer, vertices_st.memory);
+
+  for (size_t level = 0; level < lod.size(); level++) unload(static_cast<LOD>(level));
+  lod.clear();
+  lod.shrink_to_fit();
 
   // TODO(caleb): destroy instance memory here
 }
 
-void	Mesh::load(LOD lod) {}
-void	Mesh::unload(LOD lod){}
+AssetSize Mesh::cpuSize() {
+  AssetSize bytes = 0;
+  for (const auto &meshLOD : lod) bytes += meshLOD.indices.size() * sizeof(Index);
+  return bytes;
+}
+
+AssetSize Mesh::gpuSize() {
+  if (!loaded) return 0;
+  AssetSize bytes = renderer.getBufferMemorySize(vertices_st.buffer);
+  for (const auto &meshLOD : lod) {
+	if (meshLOD.loaded) bytes += renderer.getBufferMemorySize(meshLOD.indices_st.buffer);
+  }
+  return bytes;
+}
+
+void Mesh::load(LOD level) {
+  MeshLOD &meshLOD = lod.at(level);
+  if (meshLOD.loaded) return;
+
+  meshLOD.indices_st.size = static_cast<uint32_t>(meshLOD.indices.size());
+  if (indexType == VK_INDEX_TYPE_UINT16) {
+	std::vector<uint16_t> shortIndices(meshLOD.indices.begin(), meshLOD.indices.end());
+	renderer.createIndexBuffer(shortIndices, meshLOD.indices_st.buffer, meshLOD.indices_st.memory);
+  } else {
+	renderer.createIndexBuffer(meshLOD.indices, meshLOD.indices_st.buffer, meshLOD.indices_st.memory);
+  }
+  meshLOD.loaded = true;
+}
+
+void Mesh::unload(LOD level) {
+  MeshLOD &meshLOD = lod.at(level);
+  if (!meshLOD.loaded) return;
+
+  renderer.retireBuffer(meshLOD.indices_st.buffer, meshLOD.indices_st.memory);
+  meshLOD.loaded = false;
+}
+
+// coarsest loaded level whose error projects to at most LOD_ERROR_PIXELS
+LOD Mesh::selectLOD(const Camera &camera, const Instance &instance) {
+  LOD selected = -1;
+  for (size_t level = 0; level < lod.size(); level++) {
+	if (!lod[level].loaded) continue;
+	float projectedError = camera.projectedSize(instance.position, lod[level].error * instance.scale);
+	if (selected >= 0 && projectedError > LOD_ERROR_PIXELS) break;
+	selected = static_cast<LOD>(level);
+  }
+  return selected;
+}
 
 void Mesh::display (RenderState &renderState, Instance &thisInstance) {
+  LOD level = selectLOD(renderState.camera, thisInstance);
+  if (level < 0) { // nothing resident (yet, or it failed), it stands in as the placeholder cube
+	Renderable &placeholder = renderState.assets[PLACEHOLDER_MESH_RENDERABLE];
+	if (placeholder.lods.empty()) placeholder = renderer.getPlaceholderMesh();
+	placeholder.lods[0].instances.push_back(thisInstance);
+	return;
+  }
+
   Renderable &renderable = renderState.assets[guid];
-  if (renderable.numIndices != indices_st.size) {
+  if (renderable.lods.size() != lod.size()) {
 	renderable.vertexBuffer = vertices_st.buffer;
-	renderable.indexBuffer = indices_st.buffer;
-	renderable.numIndices = indices_st.size;
+	renderable.indexType = indexType;
+	renderable.meshConstants = meshConstants;
+	renderable.lods.resize(lod.size());
   }
-  renderable.instances.push_back(thisInstance);
+
+  DrawBucket &bucket = renderable.lods[level];
+  if (bucket.instances.empty()) {
+	bucket.indexBuffer = lod[level].indices_st.buffer;
+	bucket.numIndices = lod[level].indices_st.size;
+  }
+  bucket.instances.push_back(thisInstance);
+
+  // texture streaming wants to know how big the texture ends up on screen
+  float &screenSize = renderState.textureScreenSize[thisInstance.textureIndex];
+  screenSize = std::max(screenSize, renderState.camera.projectedSize(thisInstance.position,
+																	  2.0f * radius * thisInstance.scale));
 }
@@ -12,10 +12,12 @@ SDG
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <limits>
+#include <numbers>
 #include <set>
 #include <stdexcept>
 #include <unordered_map>
@@ -29,10 +31,8 @@ SDG
 
 #define STB_IMAGE_IMPLEMENTATION
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "vendor/tiny_obj_loader.h"
-
 #include "renderer.hh"
+#include "profiler.hh"
 
 /* ================== Pure functions that don't return any class specific data ================== */
 
@@ -61,7 +61,7 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance,
   }
 }
 
-bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
+bool checkDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*> &deviceExtensions) {
   uint32_t extensionCount;
   vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
   
@@ -77,23 +77,108 @@ bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+// "smallest three": drop the largest component (it can be rebuilt from the unit
+// length), store its index in the top 2 bits and the other three in 10 bits each.
+// the dropped component is always made positive since q and -q are the same rotation.
+static uint32_t packQuaternion(glm::vec4 q) {
+  int largest = 0;
+  for (int i = 1; i < 4; i++) {
+	if (std::abs(q[i]) > std::abs(q[largest])) largest = i;
+  }
+  if (q[largest] < 0.0f) q = -q;
+
+  uint32_t packed = static_cast<uint32_t>(largest) << 30;
+  int shift = 20;
+  for (int i = 0; i < 4; i++) {
+	if (i == largest) continue;
+	// the remaining components are in [-1/sqrt(2), 1/sqrt(2)]
+	float normalized = std::clamp(q[i] * std::numbers::sqrt2_v<float> * 0.5f + 0.5f, 0.0f, 1.0f);
+	packed |= static_cast<uint32_t>(std::round(normalized * 1023.0f)) << shift;
+	shift -= 10;
+  }
+  return packed;
+}
+
+VkVertexInputBindingDescription Vertex::getBindingDescription(VertexFormat format) {
+  return VkVertexInputBindingDescription {
+	.binding = 		0,
+	.stride = 		format == VertexQuantized ? sizeof(QuantizedVertex) : sizeof(Vertex),
+	.inputRate = 	VK_VERTEX_INPUT_RATE_VERTEX,
+  };
+}
+
+std::vector<VkVertexInputAttributeDescription> Vertex::getAttributeDescriptions(VertexFormat format) {
+  if (format == VertexQuantized) {
+	return {
+	  VkVertexInputAttributeDescription {  // positions, see MeshConstants
+		.location = 0,
+		.binding = 0,
+		.format = VK_FORMAT_R16G16B16A16_UNORM,
+		.offset = offsetof(QuantizedVertex, pos) },
+
+	  VkVertexInputAttributeDescription {  // textures
+		.location = 2,
+		.binding = 0,
+		.format = VK_FORMAT_R16G16_SFLOAT,
+		.offset = offsetof(QuantizedVertex, texCoord) },
+	};
+  }
+
+  return {
+	VkVertexInputAttributeDescription {  // positions
+	  .location = 0,
+	  .binding = 0,
+	  .format = VK_FORMAT_R32G32B32_SFLOAT,
+	  .offset = offsetof(Vertex, pos) },
+
+	VkVertexInputAttributeDescription {  // colors
+	  .location = 1,
+	  .binding = 0,
+	  .format = VK_FORMAT_R32G32B32_SFLOAT,
+	  .offset = offsetof(Vertex, color) },
+
+	VkVertexInputAttributeDescription {  // textures
+	  .location = 2,
+	  .binding = 0,
+	  .format = VK_FORMAT_R32G32_SFLOAT,
+	  .offset = offsetof(Vertex, texCoord) },
+  };
+}
+
+PackedInstance PackedInstance::fromInstance(const Instance &instance) {
+  return PackedInstance {
+	.positionXY = 		glm::packSnorm2x16(glm::vec2(instance.position) / INSTANCE_POSITION_RANGE),
+	.positionZScale = 	glm::packHalf2x16(glm::vec2(instance.position.z, instance.scale)),
+	.rotation = 		packQuaternion(instance.rotation),
+	.textureIndex = 	static_cast<uint16_t>(instance.textureIndex),
+	.padding = 			0,
+  };
+}
+
 /* ======================================== Render State ======================================== */
 
 std::vector<RenderOp> RenderState::getRenderOps(Renderer &renderer) {
   std::vector<RenderOp> renderOps;
 
   for (auto& [asset, renderable] : assets) {
-	auto slice = renderer.writeInstanceBuffer(renderable.instances);
-	RenderOp op {
-	  .type = DrawMeshInstanced,
-	  .vertexBuffer = renderable.vertexBuffer,
-	  .indexBuffer = renderable.indexBuffer,
-	  .numIndices = renderable.numIndices,
-	  .instanceBuffer = slice.buffer,
-	  .numInstances = static_cast<uint32_t>(renderable.instances.size()),
-	  .instanceOffset = slice.offset,
-	};
-	renderOps.push_back(op);
+	for (auto& bucket : renderable.lods) {
+	  if (bucket.instances.empty()) continue;
+
+	  auto slice = renderer.writeInstanceBuffer(bucket.instances);
+	  RenderOp op {
+		.type = DrawMeshInstanced,
+		.meshConstants = renderable.meshConstants,
+		.vertexBuffer = renderable.vertexBuffer,
+		.indexBuffer = bucket.indexBuffer,
+		.indexType = renderable.indexType,
+		.numIndices = bucket.numIndices,
+		.instanceBuffer = slice.buffer,
+		.numInstances = static_cast<uint32_t>(bucket.instances.size()),
+		.instanceOffset = slice.offset,
+	  };
+	  renderOps.push_back(op);
+	  Profiler::addCounter("triangles", (bucket.numIndices / 3.0) * bucket.instances.size());
+	}
   }
   assert(renderOps[0].type == DrawMeshInstanced);
   //std::printf("renderOps0 %d, %d vs renderOps1 %d, %d", op0.numInstances, op0.instanceOffset, op1.numInstances, op1.instanceOffset);
@@ -103,12 +188,13 @@ std::vector<RenderOp> RenderState::getRenderOps(Renderer &renderer) {
 /* ============================ Renderer Class Vulkan Implementation ============================ */
 
 void Renderer::initWindow() {
+  if (config.headless) return;
   std::printf("\n /* ------- INITIALIZING WINDOW ------- */ \n\n");
   glfwInit();
   
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
   
-  window = glfwCreateWindow(INIT_WIN_W, INIT_WIN_H, "Vulkan", nullptr, nullptr);
+  window = glfwCreateWindow(INIT_WIN_W, INIT_WIN_H, WINDOW_TITLE, nullptr, nullptr);
   glfwSetWindowUserPointer(window, this);
   glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
 }
@@ -117,7 +203,9 @@ void Renderer::initGraphics() {
   std::printf("\n /* ------- INITIALIZING GRAPHICS CONTEXT ------- */ \n\n");
   createInstance();
   setupDebugMessenger();
-  createSurface();
+  if (!config.headless) createSurface();
+  framesInFlight = std::clamp<uint32_t>(config.framesInFlight, MIN_FRAMES_IN_FLIGHT, MAX_FRAMES_IN_FLIGHT);
+  config.framesInFlight = framesInFlight;
   initVulkan();
 }
 
@@ -130,23 +218,33 @@ void Renderer::initVulkan() {
   createDescriptorSetLayout();
   createGraphicsPipeline();
   createCommandPool();
-  createColorResources();
-  createDepthResources();
-  createFramebuffers();
+  createQueryPools();
+  createRenderGraph();
+  setupDynamicResolution();
   createTextureSampler();
   createUniformBuffers();
+  createTextureInfoBuffer();
   createDescriptorPool();
   createDescriptorSets();
   createCommandBuffers();
   createSyncObjects();
   createInstanceBuffers();
+  createPlaceholderTexture();
+  createBuiltinMeshes();
 }
 
 void Renderer::getInput() {
+  if (config.headless) return;
   glfwPollEvents();
 }
 
+void Renderer::setWindowTitle(const std::string &title) {
+  if (config.headless) return;
+  glfwSetWindowTitle(window, title.c_str());
+}
+
 bool Renderer::shouldClose() {
+  if (config.headless) return frameNumber >= config.headlessFrames;
   return glfwWindowShouldClose(window);
 }
 
@@ -161,7 +259,7 @@ void Renderer::createInstance() {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  appInfo.apiVersion = VK_API_VERSION_1_2; // descriptor indexing, see createDescriptorSetLayout
   
   VkInstanceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -213,11 +311,13 @@ void Renderer::setupDebugMessenger() {
 }
 
 std::vector<const char*> Renderer::getRequiredExtensions() {
-  uint32_t glfwExtensionCount = 0;
-  const char** glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-  
-  std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  std::vector<const char*> extensions;
+  if (!config.headless) { // the surface extensions
+	uint32_t glfwExtensionCount = 0;
+	const char** glfwExtensions;
+	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
   if (enableValidationLayers) {
 	extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
   }
@@ -225,6 +325,11 @@ std::vector<const char*> Renderer::getRequiredExtensions() {
   return extensions;
 }
 
+std::vector<const char*> Renderer::getRequiredDeviceExtensions() {
+  if (config.headless) return {}; // no swapchain
+  return deviceExtensions;
+}
+
 bool Renderer::checkValidationLayerSupport() {
   uint32_t layerCount;
   vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
@@ -306,18 +411,73 @@ void Renderer::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
   
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
   VkPhysicalDeviceFeatures deviceFeatures{};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
   deviceFeatures.sampleRateShading = VK_TRUE;
+  deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC; // optional, see supportsTextureFormat
+  textureCompressionBC = supportedFeatures.textureCompressionBC;
+  deviceFeatures.pipelineStatisticsQuery = config.pipelineStatistics && supportedFeatures.pipelineStatisticsQuery;
+  pipelineStatisticsQuery = deviceFeatures.pipelineStatisticsQuery;
+
+  // all required, rateDeviceSuitability checks for them
+  VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures {
+	.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+	.timelineSemaphore = VK_TRUE,
+  };
+  VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures {
+	.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+	.pNext = &timelineFeatures,
+	.shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+	.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+	.descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
+	.descriptorBindingPartiallyBound = VK_TRUE,
+  };
+
+  // optional, both get chained on after the required ones if we're using them. Shader
+  // objects only work inside dynamic rendering.
+  bool hasDynamicRendering = checkDeviceExtensionSupport(physicalDevice, { VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME });
+  bool hasShaderObject = hasDynamicRendering &&
+	checkDeviceExtensionSupport(physicalDevice, { VK_EXT_SHADER_OBJECT_EXTENSION_NAME });
+  VkPhysicalDeviceShaderObjectFeaturesEXT shaderObjectFeatures {
+	.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT,
+  };
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures {
+	.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR,
+	.pNext = hasShaderObject ? &shaderObjectFeatures : nullptr,
+  };
+  VkPhysicalDeviceFeatures2 optionalFeatures {
+	.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+	.pNext = hasDynamicRendering ? &dynamicRenderingFeatures : nullptr,
+  };
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &optionalFeatures);
+  dynamicRendering = config.dynamicRendering && hasDynamicRendering && dynamicRenderingFeatures.dynamicRendering;
+  shaderObjects = config.shaderObjects && dynamicRendering && hasShaderObject && shaderObjectFeatures.shaderObject;
+  std::printf("rendering with %s and %s\n", dynamicRendering ? "dynamic rendering" : "a render pass",
+			  shaderObjects ? "shader objects" : "pipelines");
+
+  std::vector<const char*> extensions = getRequiredDeviceExtensions();
+  if (dynamicRendering) {
+	timelineFeatures.pNext = &dynamicRenderingFeatures;
+	dynamicRenderingFeatures.pNext = nullptr;
+	extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+  }
+  if (shaderObjects) {
+	dynamicRenderingFeatures.pNext = &shaderObjectFeatures;
+	extensions.push_back(VK_EXT_SHADER_OBJECT_EXTENSION_NAME);
+  }
   
   VkDeviceCreateInfo createInfo {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext = &indexingFeatures;
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pEnabledFeatures = &deviceFeatures;
   
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+  createInfo.ppEnabledExtensionNames = extensions.data();
   
   // deprecated fields
   if (enableValidationLayers) {
@@ -335,6 +495,19 @@ void Renderer::createLogicalDevice() {
   
   vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
   vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+
+  loadDeviceExtensionFunctions();
+}
+
+void Renderer::loadDeviceExtensionFunctions() {
+#define LOAD_DEVICE_FUNCTION(name) ext.name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name));
+  if (dynamicRendering) {
+	DYNAMIC_RENDERING_FUNCTIONS(LOAD_DEVICE_FUNCTION)
+  }
+  if (shaderObjects) {
+	SHADER_OBJECT_FUNCTIONS(LOAD_DEVICE_FUNCTION)
+  }
+#undef LOAD_DEVICE_FUNCTION
 }
 
 void Renderer::createSurface() {
@@ -354,9 +527,15 @@ VkSurfaceFormatKHR Renderer::chooseSwapSurfaceFormat(const std::vector<VkSurface
   }
   return availableFormats[0];
 }
+// FIFO waits for vblank (and is the only mode every surface has), MAILBOX replaces the
+// queued image so latency stays low without tearing, IMMEDIATE tears. The main loop's
+// FramePacer caps the frame rate on top of whichever one we get.
 VkPresentModeKHR Renderer::chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes) {
   for (const auto &availablePresentMode : availablePresentModes) {
-	if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) return availablePresentMode;
+	if (availablePresentMode == config.presentMode) return availablePresentMode;
+  }
+  if (config.presentMode != VK_PRESENT_MODE_FIFO_KHR) {
+	std::printf("present mode %d not supported, using FIFO\n", config.presentMode);
   }
   return VK_PRESENT_MODE_FIFO_KHR;
 }
@@ -381,6 +560,11 @@ VkExtent2D Renderer::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabiliti
 }
 
 void Renderer::createSwapChain() {
+  if (config.headless) {
+	createOffscreenTargets();
+	return;
+  }
+
   SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
   
   VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
@@ -403,6 +587,14 @@ void Renderer::createSwapChain() {
   createInfo.imageExtent = extent;
   createInfo.imageArrayLayers = 1;
   createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  if (config.dynamicResolution) { // the scene gets blitted in
+	if (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) {
+	  createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	} else {
+	  std::printf("swapchain images can't be blitted to, no dynamic resolution\n");
+	  config.dynamicResolution = false;
+	}
+  }
   
   QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
   uint32_t queueFamilyIndices[] = {
@@ -425,7 +617,7 @@ void Renderer::createSwapChain() {
   
   createInfo.presentMode = presentMode;
   createInfo.clipped = VK_TRUE;
-  createInfo.oldSwapchain = VK_NULL_HANDLE; // necessary for handling resizes
+  createInfo.oldSwapchain = swapChain; // VK_NULL_HANDLE the first time, see recreateSwapChain
   
   
   if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) !=
@@ -440,6 +632,24 @@ void Renderer::createSwapChain() {
   swapChainExtent = extent;
 }
 
+// Headless stand in for the swapchain images, one per frame in flight so the frame's timeline
+// value is all drawFrame needs to wait on before reusing one. The resolve leaves them in
+// TRANSFER_SRC instead of PRESENT_SRC (see createRenderPass) for dumpFrame.
+void Renderer::createOffscreenTargets() {
+  swapChainImageFormat = HEADLESS_IMAGE_FORMAT;
+  swapChainExtent = config.headlessExtent;
+  swapChainImages.resize(framesInFlight);
+  offscreenImageMemory.resize(framesInFlight);
+  for (size_t i = 0; i < framesInFlight; i++) {
+	createImage(swapChainExtent.width, swapChainExtent.height, 1, VK_SAMPLE_COUNT_1_BIT,
+				swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+				VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				swapChainImages[i], offscreenImageMemory[i]);
+  }
+}
+
 VkImageView Renderer::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
   VkImageViewCreateInfo createInfo {};
   createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -475,12 +685,16 @@ void Renderer::createImageViews() {
   }
 }
 
+// only without dynamic rendering, beginRendering describes the attachments otherwise. The
+// attachments end up where the frame graph expects them after the pass, it does the rest.
 void Renderer::createRenderPass() {
+  if (dynamicRendering) return;
+
   VkAttachmentDescription colorAttachment{};
   colorAttachment.format = swapChainImageFormat;
   colorAttachment.samples = msaaSamples;
   colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; // only the resolve is kept, so it can stay lazily allocated
   colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -498,7 +712,7 @@ void Renderer::createRenderPass() {
   colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // frameGraph takes it to present
   
   VkAttachmentReference colorAttachmentResolveRef{};
   colorAttachmentResolveRef.attachment = 2;
@@ -568,10 +782,38 @@ void Renderer:: createDescriptorSetLayout() {
 	.pImmutableSamplers = 	nullptr,
   };
   
-  std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
+  VkDescriptorSetLayoutBinding textureInfoLayoutBinding {
+	.binding = 				2,
+	.descriptorType = 		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+	.descriptorCount = 		1,
+	.stageFlags = 			VK_SHADER_STAGE_FRAGMENT_BIT,
+	.pImmutableSamplers = 	nullptr,
+  };
+  
+  std::array<VkDescriptorSetLayoutBinding, 3> bindings = {uboLayoutBinding, samplerLayoutBinding,
+														  textureInfoLayoutBinding};
+
+  // The texture array is written while the sets are bound and in flight: a slot that no
+  // pending frame samples can be pointed at a new image right away (UPDATE_UNUSED_WHILE_PENDING),
+  // and slots that were never written or whose image is gone are fine as long as nothing
+  // samples them (PARTIALLY_BOUND). So textures come and go without waiting on the device.
+  std::array<VkDescriptorBindingFlags, 3> bindingFlags = {
+	0,
+	VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+	VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
+	0,
+  };
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo {
+	.sType = 				VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+	.bindingCount = 		static_cast<uint32_t>(bindingFlags.size()),
+	.pBindingFlags = 		bindingFlags.data(),
+  };
   
   VkDescriptorSetLayoutCreateInfo layoutInfo {
 	.sType = 				VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+	.pNext = 				&bindingFlagsInfo,
+	.flags = 				VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
 	.bindingCount = 		static_cast<uint32_t>(bindings.size()),
 	.pBindings = 			bindings.data(),
   };
@@ -594,28 +836,152 @@ void Renderer::createGraphicsPipeline() {
 	simpleAttribute.push_back(description);
   }
 
-  createGraphicsPipeline("shaders/triangle_vert.spv", "shaders/triangle_frag.spv",
-						 simpleBinding, simpleAttribute,
-						 pipelineLayout, graphicsPipeline);
+  createPipelineLayout(pipelineLayout);
+  if (shaderObjects) {
+	createShaderProgram("shaders/triangle_vert.spv", "shaders/triangle_frag.spv",
+						simpleBinding, simpleAttribute, simpleShaders);
+  } else {
+	createGraphicsPipeline("shaders/triangle_vert.spv", "shaders/triangle_frag.spv",
+						   simpleBinding, simpleAttribute,
+						   pipelineLayout, graphicsPipeline);
+  }
+
+  bool packed = config.instanceFormat == InstancePacked;
 
   std::vector<VkVertexInputBindingDescription> instanceBinding {
-	Vertex::getBindingDescription(),
-	Instance::getBindingDescription()
+	Vertex::getBindingDescription(config.vertexFormat),
+	packed ? PackedInstance::getBindingDescription() : Instance::getBindingDescription()
   };
 
   std::vector<VkVertexInputAttributeDescription> instanceAttribute;
-  for (const auto& description : Vertex::getAttributeDescriptions()) {
+  for (const auto& description : Vertex::getAttributeDescriptions(config.vertexFormat)) {
 	instanceAttribute.push_back(description);
   }
-  for (const auto& description : Instance::getAttributeDescriptions()) {
-  	instanceAttribute.push_back(description);
+  if (packed) {
+	for (const auto& description : PackedInstance::getAttributeDescriptions()) {
+	  instanceAttribute.push_back(description);
+	}
+  } else {
+	for (const auto& description : Instance::getAttributeDescriptions()) {
+	  instanceAttribute.push_back(description);
+	}
+  }
+
+  assert(instanceAttribute.size() == (Vertex::getAttributeDescriptions(config.vertexFormat).size() + Instance::getAttributeDescriptions().size()));
+
+  createPipelineLayout(instancedPipelineLayout);
+  if (shaderObjects) {
+	createShaderProgram(packed ? "shaders/base_packed_vert.spv" : "shaders/base_vert.spv",
+						"shaders/base_frag.spv",
+						instanceBinding, instanceAttribute, instancedShaders);
+  } else {
+	createGraphicsPipeline(packed ? "shaders/base_packed_vert.spv" : "shaders/base_vert.spv",
+						   "shaders/base_frag.spv",
+						   instanceBinding, instanceAttribute,
+						   instancedPipelineLayout, instancedGraphicsPipeline);
+  }
+}
+
+// both programs share the one descriptor set layout and the MeshConstants push constants
+void Renderer::createPipelineLayout(VkPipelineLayout &layout) {
+  VkPushConstantRange meshConstantsRange {
+	.stageFlags = 	VK_SHADER_STAGE_VERTEX_BIT,
+	.offset = 		0,
+	.size = 		sizeof(MeshConstants),
+  };
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &meshConstantsRange;
+  
+  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) {
+	throw std::runtime_error("failed to create pipeline layout");
+  }
+}
+
+// Both stages are created unlinked, so either can be swapped for another variant on its
+// own. The layout info has to match createPipelineLayout's for the descriptor sets and push
+// constants bound with it to be compatible.
+void Renderer::createShaderProgram(const std::string &vertShader, const std::string &fragShader,
+								   const std::vector<VkVertexInputBindingDescription> &bindingDescriptions,
+								   const std::vector<VkVertexInputAttributeDescription> &attributeDescriptions,
+								   ShaderProgram &program) {
+  auto vertShaderByteCode = readBinAsset(vertShader);
+  auto fragShaderByteCode = readBinAsset(fragShader);
+
+  VkPushConstantRange meshConstantsRange {
+	.stageFlags = 	VK_SHADER_STAGE_VERTEX_BIT,
+	.offset = 		0,
+	.size = 		sizeof(MeshConstants),
+  };
+
+  std::array<VkShaderCreateInfoEXT, 2> shaderInfos {
+	VkShaderCreateInfoEXT {
+	  .sType = 					VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+	  .stage = 					VK_SHADER_STAGE_VERTEX_BIT,
+	  .nextStage = 				VK_SHADER_STAGE_FRAGMENT_BIT,
+	  .codeType = 				VK_SHADER_CODE_TYPE_SPIRV_EXT,
+	  .codeSize = 				vertShaderByteCode.size,
+	  .pCode = 					vertShaderByteCode.data,
+	  .pName = 					"main",
+	  .setLayoutCount = 		1,
+	  .pSetLayouts = 			&descriptorSetLayout,
+	  .pushConstantRangeCount = 1,
+	  .pPushConstantRanges = 	&meshConstantsRange,
+	},
+	VkShaderCreateInfoEXT {
+	  .sType = 					VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+	  .stage = 					VK_SHADER_STAGE_FRAGMENT_BIT,
+	  .nextStage = 				0,
+	  .codeType = 				VK_SHADER_CODE_TYPE_SPIRV_EXT,
+	  .codeSize = 				fragShaderByteCode.size,
+	  .pCode = 					fragShaderByteCode.data,
+	  .pName = 					"main",
+	  .setLayoutCount = 		1,
+	  .pSetLayouts = 			&descriptorSetLayout,
+	  .pushConstantRangeCount = 1,
+	  .pPushConstantRanges = 	&meshConstantsRange,
+	},
+  };
+
+  std::array<VkShaderEXT, 2> shaders {};
+  if (ext.vkCreateShadersEXT(device, static_cast<uint32_t>(shaderInfos.size()), shaderInfos.data(),
+							 nullptr, shaders.data()) != VK_SUCCESS) {
+	throw std::runtime_error("failed to create shader objects! " + vertShader + " " + fragShader);
   }
+  program.vertex = shaders[0];
+  program.fragment = shaders[1];
 
-  assert(instanceAttribute.size() == (Vertex::getAttributeDescriptions().size() + Instance::getAttributeDescriptions().size()));
+  program.bindings.clear();
+  for (const auto &binding : bindingDescriptions) {
+	program.bindings.push_back(VkVertexInputBindingDescription2EXT {
+		.sType = 		VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT,
+		.binding = 		binding.binding,
+		.stride = 		binding.stride,
+		.inputRate = 	binding.inputRate,
+		.divisor = 		1,
+	  });
+  }
+  program.attributes.clear();
+  for (const auto &attribute : attributeDescriptions) {
+	program.attributes.push_back(VkVertexInputAttributeDescription2EXT {
+		.sType = 		VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT,
+		.location = 	attribute.location,
+		.binding = 		attribute.binding,
+		.format = 		attribute.format,
+		.offset = 		attribute.offset,
+	  });
+  }
+}
 
-  createGraphicsPipeline("shaders/base_vert.spv", "shaders/base_frag.spv",
-						 instanceBinding, instanceAttribute,
-						 instancedPipelineLayout, instancedGraphicsPipeline);
+void Renderer::destroyShaderProgram(ShaderProgram &program) {
+  if (!shaderObjects) return;
+  ext.vkDestroyShaderEXT(device, program.vertex, nullptr);
+  ext.vkDestroyShaderEXT(device, program.fragment, nullptr);
+  program = ShaderProgram {};
 }
 
 void Renderer::createGraphicsPipeline(const std::string &vertShader,
@@ -623,7 +989,7 @@ void Renderer::createGraphicsPipeline(const std::string &vertShader,
 									  const std::vector<VkVertexInputBindingDescription> bindingDescriptions,
 									  const std::vector<VkVertexInputAttributeDescription> attributeDescriptions,
 									  
-									  VkPipelineLayout &pipelineLayout,
+									  VkPipelineLayout pipelineLayout,
 									  VkPipeline &graphicsPipeline) {
   auto vertShaderByteCode = readBinAsset(vertShader);
   auto fragShaderByteCode = readBinAsset(fragShader);
@@ -748,19 +1114,19 @@ void Renderer::createGraphicsPipeline(const std::string &vertShader,
   colorBlending.blendConstants[2] = 0.0f;  // used for bitwise
   colorBlending.blendConstants[3] = 0.0f;  // used for bitwise
   
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 1;
-  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-  pipelineLayoutInfo.pushConstantRangeCount = 0;
-  pipelineLayoutInfo.pPushConstantRanges = nullptr;
-  
-  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-	throw std::runtime_error("failed to create pipeline layout");
-  }
+  // with dynamic rendering the pipeline gets the attachment formats instead of a render pass
+  VkFormat depthFormat = findDepthFormat();
+  VkPipelineRenderingCreateInfoKHR renderingInfo {
+	.sType = 					VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+	.colorAttachmentCount = 	1,
+	.pColorAttachmentFormats = 	&swapChainImageFormat,
+	.depthAttachmentFormat = 	depthFormat,
+	.stencilAttachmentFormat = 	VK_FORMAT_UNDEFINED,
+  };
   
   VkGraphicsPipelineCreateInfo pipelineInfo{};
   pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.pNext = dynamicRendering ? &renderingInfo : nullptr;
   pipelineInfo.stageCount = 2;
   pipelineInfo.pStages = shaderStages;
   pipelineInfo.pVertexInputState = &vertexInputInfo;
@@ -772,7 +1138,7 @@ void Renderer::createGraphicsPipeline(const std::string &vertShader,
   pipelineInfo.pColorBlendState = &colorBlending;
   pipelineInfo.pDynamicState = &dynamicState;
   pipelineInfo.layout = pipelineLayout;
-  pipelineInfo.renderPass = renderPass;
+  pipelineInfo.renderPass = renderPass; // VK_NULL_HANDLE with dynamic rendering
   pipelineInfo.subpass = 0;
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
   pipelineInfo.basePipelineIndex = -1;
@@ -785,11 +1151,11 @@ void Renderer::createGraphicsPipeline(const std::string &vertShader,
   vkDestroyShaderModule(device, fragShaderModule, nullptr);
 }
 
-VkShaderModule Renderer::createShaderModule(const std::vector<char> &byteCode) {
+VkShaderModule Renderer::createShaderModule(const AssetBytes &byteCode) {
   VkShaderModuleCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = byteCode.size();
-  createInfo.pCode = reinterpret_cast<const uint32_t*>(byteCode.data());
+  createInfo.codeSize = byteCode.size;
+  createInfo.pCode = reinterpret_cast<const uint32_t*>(byteCode.data);
   
   VkShaderModule shaderModule;
   if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
@@ -798,13 +1164,15 @@ VkShaderModule Renderer::createShaderModule(const std::vector<char> &byteCode) {
   return shaderModule;
 }
 
-void Renderer::createFramebuffers() {
+// only without dynamic rendering, and only once frameGraph has the targets (see recordCommandBuffer).
+// The resolve goes to each swapchain image, or to resolveView for every one of them if it's set.
+void Renderer::createFramebuffers(VkImageView colorView, VkImageView depthView, VkImageView resolveView) {
   swapChainFramebuffers.resize(swapChainImageViews.size());
   for (size_t i = 0; i < swapChainImageViews.size(); i++) {
 	std::array<VkImageView, 3> attachments = {
-	  colorImageView,
-	  depthImageView,
-	  swapChainImageViews[i]
+	  colorView,
+	  depthView,
+	  resolveView != VK_NULL_HANDLE ? resolveView : swapChainImageViews[i]
 	};
 	
 	VkFramebufferCreateInfo framebufferInfo{};
@@ -835,25 +1203,48 @@ void Renderer::createCommandPool() {
   }
 }
 
-void Renderer::createColorResources() {
-  VkFormat colorFormat = swapChainImageFormat;
-  
-  createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples,
-			  colorFormat, VK_IMAGE_TILING_OPTIMAL,
-			  VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-			  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			  colorImage, colorImageMemory);
-  colorImageView = createImageView(colorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+// the graph's transients can be rebuilt while frames in flight still use the old ones
+void Renderer::createRenderGraph() {
+  frameGraph.init(device, physicalDevice, [this](VkImage image, VkDeviceMemory memory, VkImageView imageView) {
+	retireImage(image, memory, imageView);
+  });
 }
 
-void Renderer::createDepthResources() {
-  VkFormat depthFormat = findDepthFormat();
-  createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples,
-			  depthFormat, VK_IMAGE_TILING_OPTIMAL,
-			  VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-			  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			  depthImage, depthImageMemory);
-  depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+// With dynamicResolution the scene renders into an offscreen target at renderScale of the
+// swapchain extent, and a blit scales it up into the swapchain image (see recordCommandBuffer).
+// The gpu frame time it's driven by comes from the same timestamps --profile uses. The MSAA
+// level only moves with shader objects, since the pipelines and the render pass bake it in.
+void Renderer::setupDynamicResolution() {
+  if (!config.dynamicResolution) return;
+
+  VkFormatProperties props;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, swapChainImageFormat, &props);
+  VkFormatFeatureFlags blit = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+  if ((props.optimalTilingFeatures & blit) != blit) {
+	std::printf("swapchain format can't be blitted, no dynamic resolution\n");
+	config.dynamicResolution = false;
+	return;
+  }
+  if (gpuFrameQueries[0].timestamps == VK_NULL_HANDLE) {
+	std::printf("no gpu timestamps to measure with, no dynamic resolution\n");
+	config.dynamicResolution = false;
+	return;
+  }
+  bool linear = props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  upscaleFilter = linear ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+  VkSampleCountFlags sampleCounts = shaderObjects ? getUsableSampleCounts() : msaaSamples;
+  resolution = ResolutionController(config.gpuFrameBudgetMs, config.minRenderScale, sampleCounts, msaaSamples);
+  std::printf("dynamic resolution: %.1f ms gpu budget, %.0f%% to 100%% scale, sample counts 0x%x\n",
+			  config.gpuFrameBudgetMs, config.minRenderScale * 100.0f, sampleCounts);
+}
+
+// what the scene is drawn at, the top left of the full size targets
+VkExtent2D Renderer::renderExtent() {
+  return VkExtent2D {
+	.width = std::max<uint32_t>(1, static_cast<uint32_t>(std::lround(swapChainExtent.width * renderScale))),
+	.height = std::max<uint32_t>(1, static_cast<uint32_t>(std::lround(swapChainExtent.height * renderScale))),
+  };
 }
 
 VkFormat Renderer::findSupportedFormat(const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
@@ -895,94 +1286,316 @@ void Renderer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t image
 	throw std::runtime_error("failed to begin recording command buffer!");
   }
   
-  std::array<VkClearValue, 2> clearValues;
-  clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
-  clearValues[1].depthStencil = {1.0f, 0};
-  
-  
-  VkRenderPassBeginInfo renderPassInfo {
-	.sType = 			VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-	.renderPass = 		renderPass,
-	.framebuffer = 		swapChainFramebuffers[imageIndex],
-	.renderArea 		{ .offset = {0,0},
-				 		  .extent = swapChainExtent },
-	.clearValueCount = 	static_cast<uint32_t>(clearValues.size()),
-	.pClearValues = 	clearValues.data(),
-  };
-  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-  
-  // TODO(caleb): allow shader objects or pipelines specified from the op here
-  // we could replace this with a dynamic call to any number of shader objects
-  // see: https://www.khronos.org/blog/you-can-use-vulkan-without-pipelines-today
-  
-  // need to set these because we're using a dynamic viewport
-  VkViewport viewport{
-	.x = 			0.0f,
-	.y = 			0.0f,
-	.width = 		static_cast<float>(swapChainExtent.width),
-	.height = 		static_cast<float>(swapChainExtent.height),
-	.minDepth = 	0.0f,
-	.maxDepth = 	1.0f,
-  };
+  // only profiled frames are timed, see readGpuFrameQueries, except that dynamic resolution
+  // needs the frame time every frame. The draws and statistics are only for the profile.
+  // The frame time itself is taken around the scene pass, see there.
+  GpuFrameQueries &queries = gpuFrameQueries[currentFrame];
+  bool profiled = queries.timestamps != VK_NULL_HANDLE && Profiler::isEnabled();
+  bool timed = queries.timestamps != VK_NULL_HANDLE && (profiled || config.dynamicResolution);
+  bool statistics = profiled && queries.statistics != VK_NULL_HANDLE;
+  uint32_t numDraws = static_cast<uint32_t>(renderOps.size());
+  uint32_t drawsPerRange = std::max(1u, (numDraws + GPU_TIMED_RANGES - 1) / GPU_TIMED_RANGES);
+  uint32_t timedRanges = profiled ? (numDraws + drawsPerRange - 1) / drawsPerRange : 0;
+  if (timed) {
+	vkCmdResetQueryPool(commandBuffer, queries.timestamps, 0, 2 + timedRanges);
+	if (statistics) {
+	  vkCmdResetQueryPool(commandBuffer, queries.statistics, 0, 1);
+	  vkCmdBeginQuery(commandBuffer, queries.statistics, 0, 0);
+	}
+  }
+
+  recordInstanceCopies(commandBuffer);
+
+  // The scene draws into a multisampled color target that resolves into the swapchain
+  // image, or straight into the swapchain image without MSAA. The render pass always has
+  // the resolve attachment. With dynamic resolution the offscreen scene target takes the
+  // swapchain image's place, and the upscale pass blits it across. Every target stays at
+  // the full extent so a new scale doesn't reallocate anything, only the top left
+  // renderExtent of them gets drawn.
+  bool resolve = msaaSamples != VK_SAMPLE_COUNT_1_BIT || !dynamicRendering;
+  VkExtent2D extent = config.dynamicResolution ? renderExtent() : swapChainExtent;
+  VkFormat depthFormat = findDepthFormat();
+  VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+  if (hasStencilComponent(depthFormat)) depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+  // headless there's no present, dumpFrame copies out of it instead
+  RenderGraphImage target = frameGraph.importImage(swapChainImages[imageIndex], swapChainImageViews[imageIndex],
+												   VK_IMAGE_ASPECT_COLOR_BIT, 1,
+												   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+												   config.headless ? AccessTransferSrc : AccessPresent);
+  RenderGraphImage depth = frameGraph.createTransient(RenderGraphTransientDesc{
+	  .format = depthFormat,
+	  .extent = swapChainExtent,
+	  .samples = msaaSamples,
+	  .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+	  .aspect = depthAspect,
+	});
+  RenderGraphImage scene = target;
+  if (config.dynamicResolution) {
+	scene = frameGraph.createTransient(RenderGraphTransientDesc{
+		.format = swapChainImageFormat,
+		.extent = swapChainExtent,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		.aspect = VK_IMAGE_ASPECT_COLOR_BIT,
+	  });
+  }
+  std::vector<RenderGraphUse> sceneUses { {scene, AccessColorAttachment}, {depth, AccessDepthAttachment} };
+  std::optional<RenderGraphImage> color;
+  if (resolve) {
+	color = frameGraph.createTransient(RenderGraphTransientDesc{
+		.format = swapChainImageFormat,
+		.extent = swapChainExtent,
+		.samples = msaaSamples,
+		.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+		.aspect = VK_IMAGE_ASPECT_COLOR_BIT,
+	  });
+	sceneUses.push_back({*color, AccessColorAttachment});
+  }
+
+  frameGraph.addPass("scene", sceneUses, [&](VkCommandBuffer commandBuffer) {
+	// The frame time mustn't include waiting on the acquire semaphore (most of a frame under
+	// vsync), so drawing into the swapchain image it starts at the stage the acquire gates.
+	// The dynamic resolution scene target isn't gated, only the upscale is, so that's left out.
+	if (timed) {
+	  VkPipelineStageFlagBits start = config.dynamicResolution ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
+		: VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	  vkCmdWriteTimestamp(commandBuffer, start, queries.timestamps, 0);
+	}
+	beginRendering(commandBuffer, imageIndex, frameGraph.view(scene),
+				   color ? frameGraph.view(*color) : VK_NULL_HANDLE, frameGraph.view(depth), extent);
+  
+	// TODO(caleb): allow shader objects or pipelines specified from the op here. With
+	// shader objects (see createShaderProgram) that's just another ShaderProgram to bind.
+  
+	// need to set these because we're using a dynamic viewport
+	VkViewport viewport{
+	  .x = 			0.0f,
+	  .y = 			0.0f,
+	  .width = 		static_cast<float>(extent.width),
+	  .height = 		static_cast<float>(extent.height),
+	  .minDepth = 	0.0f,
+	  .maxDepth = 	1.0f,
+	};
   
-  VkRect2D scissor{
-	.offset = 		{0, 0},
-	.extent = 		swapChainExtent,
-  };
+	VkRect2D scissor{
+	  .offset = 		{0, 0},
+	  .extent = 		extent,
+	};
+
+	if (shaderObjects) setShaderObjectState(commandBuffer, viewport, scissor);
   
-  for (const auto& op : renderOps) {
+	for (uint32_t drawIndex = 0; drawIndex < renderOps.size(); drawIndex++) {
+	  const RenderOp &op = renderOps[drawIndex];
 	
-	//Vkcmddraw(commandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
-	switch (op.type) {
-	case DrawMeshSimple: {
-	  std::printf("\n\n\nDRAWING SIMPLE MESH\n\n\n");
-	  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-
-	  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-	  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-	  VkBuffer vertexBuffers[] = {op.vertexBuffer};
-	  VkDeviceSize offsets[] = {0};
-	  vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+	  //Vkcmddraw(commandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
+	  switch (op.type) {
+	  case DrawMeshSimple: {
+		std::printf("\n\n\nDRAWING SIMPLE MESH\n\n\n");
+		if (shaderObjects) bindShaderProgram(commandBuffer, simpleShaders);
+		else vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		VkBuffer vertexBuffers[] = {op.vertexBuffer};
+		VkDeviceSize offsets[] = {0};
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 	  
-	  vkCmdBindIndexBuffer(commandBuffer, op.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdBindIndexBuffer(commandBuffer, op.indexBuffer, 0, op.indexType);
 	  
-	  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-							  pipelineLayout, 0, 1,
-							  &descriptorSets[currentFrame], 0, nullptr);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+								pipelineLayout, 0, 1,
+								&descriptorSets[currentFrame], 0, nullptr);
 	  
-	  vkCmdDrawIndexed(commandBuffer, op.numIndices, 1, 0, 0, 0);
-	} break;
-	case DrawMeshInstanced: {	//
-	  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, instancedGraphicsPipeline);
-
-	  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-	  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-	  VkBuffer vertexBuffers[] = {op.vertexBuffer, op.instanceBuffer};
-	  VkDeviceSize offsets[] = {0, op.instanceOffset};
-	  vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+		vkCmdDrawIndexed(commandBuffer, op.numIndices, 1, 0, 0, 0);
+		renderStats.draws++;
+		renderStats.instances++;
+	  } break;
+	  case DrawMeshInstanced: {	//
+		if (shaderObjects) bindShaderProgram(commandBuffer, instancedShaders);
+		else vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, instancedGraphicsPipeline);
+
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		VkBuffer vertexBuffers[] = {op.vertexBuffer, op.instanceBuffer};
+		VkDeviceSize offsets[] = {0, op.instanceOffset};
+		vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
 	  
-	  vkCmdBindIndexBuffer(commandBuffer, op.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdBindIndexBuffer(commandBuffer, op.indexBuffer, 0, op.indexType);
 	  
-	  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-							  pipelineLayout, 0, 1,
-							  &descriptorSets[currentFrame], 0, nullptr);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+								pipelineLayout, 0, 1,
+								&descriptorSets[currentFrame], 0, nullptr);
+
+		vkCmdPushConstants(commandBuffer, instancedPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,
+						   0, sizeof(MeshConstants), &op.meshConstants);
 	  
-	  vkCmdDrawIndexed(commandBuffer, op.numIndices, op.numInstances, 0, 0, 0);
-	} break;
+		vkCmdDrawIndexed(commandBuffer, op.numIndices, op.numInstances, 0, 0, 0);
+		renderStats.draws++;
+		renderStats.instances += op.numInstances;
+	  } break;
+	  }
+
+	  bool rangeEnds = (drawIndex + 1) % drawsPerRange == 0 || drawIndex + 1 == numDraws;
+	  if (timedRanges > 0 && rangeEnds) {
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, queries.timestamps,
+							2 + drawIndex / drawsPerRange);
+	  }
 	}
-  }
   
-  vkCmdEndRenderPass(commandBuffer);
+	endRendering(commandBuffer);
+	if (timed) vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queries.timestamps, 1);
+  });
+
+  if (config.dynamicResolution) {
+	frameGraph.addPass("upscale", { {scene, AccessTransferSrc}, {target, AccessTransferDst} }, [&](VkCommandBuffer commandBuffer) {
+	  VkImageBlit region {
+		.srcSubresource = 	{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+		.srcOffsets = 		{ {0, 0, 0}, {static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1} },
+		.dstSubresource = 	{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+		.dstOffsets = 		{ {0, 0, 0}, {static_cast<int32_t>(swapChainExtent.width),
+										  static_cast<int32_t>(swapChainExtent.height), 1} },
+	  };
+	  vkCmdBlitImage(commandBuffer, frameGraph.image(scene), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					 swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, upscaleFilter);
+	});
+  }
+  frameGraph.execute(commandBuffer);
+
+  if (timed) {
+	if (statistics) vkCmdEndQuery(commandBuffer, queries.statistics, 0);
+	queries.timestampsWritten = 2 + timedRanges;
+	queries.statisticsWritten = statistics;
+  }
   
   if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
 	throw std::runtime_error("failed to record command buffer!");
   }
 }
 
+// Runs inside the frame graph's scene pass, so the targets are already in their attachment
+// layouts. targetView is the swapchain image or the dynamic resolution scene target, and
+// colorView the multisampled target that resolves into it, VK_NULL_HANDLE when targetView is
+// drawn to directly. Only extent of them is drawn. The framebuffers hold on to the graph's
+// transients, so they're rebuilt along with them.
+void Renderer::beginRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkImageView targetView,
+							  VkImageView colorView, VkImageView depthView, VkExtent2D extent) {
+  VkClearValue colorClear {};
+  colorClear.color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+  VkClearValue depthClear {};
+  depthClear.depthStencil = {1.0f, 0};
+  VkRect2D renderArea { .offset = {0, 0}, .extent = extent };
+
+  if (!dynamicRendering) {
+	if (swapChainFramebuffers.empty() || framebufferGeneration != frameGraph.generation()) {
+	  if (!swapChainFramebuffers.empty()) {
+		retiredSwapChains.push_back(RetiredSwapChain{
+			.swapChain = VK_NULL_HANDLE,
+			.imageViews = {},
+			.framebuffers = std::move(swapChainFramebuffers),
+			.timelineValue = TIMELINE_PENDING,
+		  });
+	  }
+	  createFramebuffers(colorView, depthView, config.dynamicResolution ? targetView : VK_NULL_HANDLE);
+	  framebufferGeneration = frameGraph.generation();
+	}
+
+	std::array<VkClearValue, 2> clearValues { colorClear, depthClear };
+	VkRenderPassBeginInfo renderPassInfo {
+	  .sType = 			VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+	  .renderPass = 		renderPass,
+	  .framebuffer = 		swapChainFramebuffers[imageIndex],
+	  .renderArea = 		renderArea,
+	  .clearValueCount = 	static_cast<uint32_t>(clearValues.size()),
+	  .pClearValues = 	clearValues.data(),
+	};
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	return;
+  }
+
+  bool resolve = colorView != VK_NULL_HANDLE;
+  VkRenderingAttachmentInfoKHR colorAttachment {
+	.sType = 				VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+	.imageView = 			resolve ? colorView : targetView,
+	.imageLayout = 			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+	.resolveMode = 			resolve ? VK_RESOLVE_MODE_AVERAGE_BIT : VK_RESOLVE_MODE_NONE,
+	.resolveImageView = 	resolve ? targetView : VK_NULL_HANDLE,
+	.resolveImageLayout = 	VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+	.loadOp = 				VK_ATTACHMENT_LOAD_OP_CLEAR,
+	.storeOp = 				resolve ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,
+	.clearValue = 			colorClear,
+  };
+
+  VkRenderingAttachmentInfoKHR depthAttachment {
+	.sType = 				VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+	.imageView = 			depthView,
+	.imageLayout = 			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+	.resolveMode = 			VK_RESOLVE_MODE_NONE,
+	.loadOp = 				VK_ATTACHMENT_LOAD_OP_CLEAR,
+	.storeOp = 				VK_ATTACHMENT_STORE_OP_DONT_CARE,
+	.clearValue = 			depthClear,
+  };
+
+  VkRenderingInfoKHR renderingInfo {
+	.sType = 				VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+	.renderArea = 			renderArea,
+	.layerCount = 			1,
+	.colorAttachmentCount = 1,
+	.pColorAttachments = 	&colorAttachment,
+	.pDepthAttachment = 	&depthAttachment,
+  };
+  ext.vkCmdBeginRenderingKHR(commandBuffer, &renderingInfo);
+}
+
+// the frame graph takes the swapchain image on to present (or TRANSFER_SRC headless)
+void Renderer::endRendering(VkCommandBuffer commandBuffer) {
+  if (dynamicRendering) ext.vkCmdEndRenderingKHR(commandBuffer);
+  else vkCmdEndRenderPass(commandBuffer);
+}
+
+// Everything createGraphicsPipeline bakes into a pipeline, as dynamic state. It stays set
+// across shader binds, so once per command buffer is enough. There's no dynamic state for
+// sample shading, so unlike the pipelines this doesn't get minSampleShading.
+void Renderer::setShaderObjectState(VkCommandBuffer commandBuffer, const VkViewport &viewport, const VkRect2D &scissor) {
+  VkSampleMask sampleMask = ~0u;
+  VkBool32 blendEnable = VK_FALSE;
+  VkColorComponentFlags colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+	VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+  ext.vkCmdSetViewportWithCountEXT(commandBuffer, 1, &viewport);
+  ext.vkCmdSetScissorWithCountEXT(commandBuffer, 1, &scissor);
+  ext.vkCmdSetRasterizerDiscardEnableEXT(commandBuffer, VK_FALSE);
+  ext.vkCmdSetPrimitiveTopologyEXT(commandBuffer, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+  ext.vkCmdSetPrimitiveRestartEnableEXT(commandBuffer, VK_FALSE);
+  ext.vkCmdSetPolygonModeEXT(commandBuffer, VK_POLYGON_MODE_FILL);
+  ext.vkCmdSetCullModeEXT(commandBuffer, VK_CULL_MODE_BACK_BIT);
+  ext.vkCmdSetFrontFaceEXT(commandBuffer, VK_FRONT_FACE_COUNTER_CLOCKWISE);
+  ext.vkCmdSetDepthBiasEnableEXT(commandBuffer, VK_FALSE);
+  ext.vkCmdSetRasterizationSamplesEXT(commandBuffer, msaaSamples);
+  ext.vkCmdSetSampleMaskEXT(commandBuffer, msaaSamples, &sampleMask);
+  ext.vkCmdSetAlphaToCoverageEnableEXT(commandBuffer, VK_FALSE);
+  ext.vkCmdSetDepthTestEnableEXT(commandBuffer, VK_TRUE);
+  ext.vkCmdSetDepthWriteEnableEXT(commandBuffer, VK_TRUE);
+  ext.vkCmdSetDepthCompareOpEXT(commandBuffer, VK_COMPARE_OP_LESS);
+  ext.vkCmdSetDepthBoundsTestEnableEXT(commandBuffer, VK_FALSE);
+  ext.vkCmdSetStencilTestEnableEXT(commandBuffer, VK_FALSE);
+  ext.vkCmdSetColorBlendEnableEXT(commandBuffer, 0, 1, &blendEnable);
+  ext.vkCmdSetColorWriteMaskEXT(commandBuffer, 0, 1, &colorWriteMask);
+}
+
+void Renderer::bindShaderProgram(VkCommandBuffer commandBuffer, const ShaderProgram &program) {
+  std::array<VkShaderStageFlagBits, 2> stages { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+  std::array<VkShaderEXT, 2> shaders { program.vertex, program.fragment };
+  ext.vkCmdBindShadersEXT(commandBuffer, static_cast<uint32_t>(stages.size()), stages.data(), shaders.data());
+  ext.vkCmdSetVertexInputEXT(commandBuffer,
+							 static_cast<uint32_t>(program.bindings.size()), program.bindings.data(),
+							 static_cast<uint32_t>(program.attributes.size()), program.attributes.data());
+}
+
 void Renderer::createCommandBuffers() {
-  commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+  commandBuffers.resize(framesInFlight);
   
   VkCommandBufferAllocateInfo allocInfo{
 	.sType = 				VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -1061,10 +1674,27 @@ void Renderer::createImage(uint32_t width, uint32_t height, uint32_t mipLevels,
   vkBindImageMemory(device, image, imageMemory, 0);
 }
 
-void Renderer::createTextureImage(stbi_uc *pixels, int texWidth, int texHeight, int texChannels,
+// NOTE: mips come from the CPU (buildMipChain or a cooked .ktx2, see texture_formats.hh)
+// so that the streamer can create an image holding only the levels it wants resident.
+bool Renderer::supportsTextureFormat(TextureFormat format) {
+  if (format == TextureRGBA8 || format == TexturePalette8) return true; // both are required formats
+  if ((format == TextureBC1 || format == TextureBC7) && !textureCompressionBC) return false;
+
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, static_cast<VkFormat>(format), &formatProperties);
+  return formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+}
+
+void Renderer::createTextureImage(const std::vector<TextureMip> &mips, uint32_t firstMip,
+								  TextureFormat format,
 								  VkImage &textureImage, VkDeviceMemory &textureImageMemory,
 								  VkImageView &textureImageView) {
-  VkDeviceSize imageSize = texWidth * texHeight * 4;
+  assert(firstMip < mips.size());
+  auto mipLevels = static_cast<uint32_t>(mips.size()) - firstMip;
+  auto imageFormat = static_cast<VkFormat>(format);
+
+  VkDeviceSize imageSize = 0;
+  for (uint32_t i = firstMip; i < mips.size(); i++) imageSize += mips[i].data.size();
  
   VkBuffer stagingBuffer;
   VkDeviceMemory stagingBufferMemory;
@@ -1072,132 +1702,55 @@ void Renderer::createTextureImage(stbi_uc *pixels, int texWidth, int texHeight,
   createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			   stagingBuffer, stagingBufferMemory);
-  
+
+  std::vector<VkBufferImageCopy> regions;
   void *data;
   vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-  memcpy(data, pixels, static_cast<size_t>(imageSize));
+  VkDeviceSize offset = 0;
+  for (uint32_t i = firstMip; i < mips.size(); i++) {
+	memcpy(static_cast<char *>(data) + offset, mips[i].data.data(), mips[i].data.size());
+	regions.push_back(VkBufferImageCopy {
+		.bufferOffset = 		offset,
+		.bufferRowLength = 		0,
+		.bufferImageHeight = 	0,
+		.imageSubresource = 	{ VK_IMAGE_ASPECT_COLOR_BIT, i - firstMip, 0, 1 },
+		.imageOffset = 			{ 0, 0, 0 },
+		.imageExtent = 			{ textureImageWidth(format, mips[i].width), mips[i].height, 1 },
+	  });
+	offset += mips[i].data.size();
+  }
   vkUnmapMemory(device, stagingBufferMemory);
   
-  
-  auto mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
-  
-  createImage(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT,
-			  VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-			  VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+  createImage(textureImageWidth(format, mips[firstMip].width), mips[firstMip].height,
+			  mipLevels, VK_SAMPLE_COUNT_1_BIT,
+			  imageFormat, VK_IMAGE_TILING_OPTIMAL,
 			  VK_IMAGE_USAGE_TRANSFER_DST_BIT |
 			  VK_IMAGE_USAGE_SAMPLED_BIT,
 			  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			  textureImage, textureImageMemory);
 
-  transitionImageLayout(textureImage,
-						VK_FORMAT_R8G8B8A8_SRGB,
-						VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-						mipLevels);
-  copyBufferToImage(stagingBuffer, textureImage,
-					static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-  
-  // this is now done automatically due to generating mipmaps
-  //transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB,
-  //VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
-  generateMipmaps(textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
+  // one submit for the copy and both transitions, the graph works those out
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+  RenderGraph upload;
+  RenderGraphImage texture = upload.importImage(textureImage, VK_NULL_HANDLE, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels,
+												VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, AccessSampled);
+  upload.addPass("texture upload", { {texture, AccessTransferDst} }, [&](VkCommandBuffer commandBuffer) {
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, textureImage,
+						   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						   static_cast<uint32_t>(regions.size()), regions.data());
+  });
+  upload.execute(commandBuffer);
+  endSingleTimeCommands(commandBuffer);
   
   vkDestroyBuffer(device, stagingBuffer, nullptr);
   vkFreeMemory(device, stagingBufferMemory, nullptr);
 
-  textureImageView = createImageView(textureImage, VK_FORMAT_R8G8B8A8_SRGB,
+  textureImageView = createImageView(textureImage, imageFormat,
 									 VK_IMAGE_ASPECT_COLOR_BIT,
 									 mipLevels);
 
 }
 
-// This should be done somewhere before we ever get here.
-void Renderer::generateMipmaps(VkImage image, VkFormat imageFormat,
-							   int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
-  VkFormatProperties formatProperties;
-  vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
-  
-  if (!(formatProperties.optimalTilingFeatures &
-		VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-	throw std::runtime_error("texture image format does not support linear blitting!");
-  }
-  
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-  
-  VkImageMemoryBarrier barrier{};
-  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  barrier.image = image;
-  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  barrier.subresourceRange.baseArrayLayer = 0;
-  barrier.subresourceRange.layerCount = 1;
-  barrier.subresourceRange.levelCount = 1;
-  
-  int32_t mipWidth = texWidth;
-  int32_t mipHeight = texHeight;
-  
-  for (uint32_t i = 1; i < mipLevels; i++) {
-	barrier.subresourceRange.baseMipLevel = i -1;
-	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-	
-	vkCmdPipelineBarrier(commandBuffer,
-						 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-						 0, nullptr,
-						 0, nullptr,
-						 1, &barrier);
-	VkImageBlit blit{};
-	blit.srcOffsets[0] = { 0, 0, 0 };
-	blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
-	blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	blit.srcSubresource.mipLevel = i - 1;
-	blit.srcSubresource.baseArrayLayer = 0;
-	blit.srcSubresource.layerCount = 1;
-	blit.dstOffsets[0] = { 0, 0, 0 };
-	blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
-	blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	blit.dstSubresource.mipLevel = i;
-	blit.dstSubresource.baseArrayLayer = 0;
-	blit.dstSubresource.layerCount = 1;
-	
-	vkCmdBlitImage(commandBuffer,
-				   image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				   image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				   1, &blit,
-				   VK_FILTER_LINEAR);
-	
-	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	
-	vkCmdPipelineBarrier(commandBuffer,
-						 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-						 0, nullptr,
-						 0, nullptr,
-						 1, &barrier);
-	
-	if (mipWidth > 1) { mipWidth /= 2; } 
-	if (mipHeight > 1) { mipHeight /= 2; }
-  }
-  
-  barrier.subresourceRange.baseMipLevel = mipLevels -1;
-  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-  
-  vkCmdPipelineBarrier(commandBuffer,
-					   VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-					   0, nullptr,
-					   0, nullptr,
-					   1, &barrier);
-  
-  endSingleTimeCommands(commandBuffer);
-}
-
 void Renderer::createTextureSampler() {
   
   VkPhysicalDeviceProperties properties{};
@@ -1226,10 +1779,8 @@ void Renderer::createTextureSampler() {
   }
 }
 
-void Renderer::createVertexBuffer(std::vector<Vertex> vertices,
-								  VkBuffer &vertexBuffer, VkDeviceMemory &vertexBufferMemory) {
-  VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-  
+void Renderer::createDeviceLocalBuffer(const void *data, VkDeviceSize bufferSize, VkBufferUsageFlags usage,
+									   VkBuffer &buffer, VkDeviceMemory &bufferMemory) {
   VkBuffer stagingBuffer;
   VkDeviceMemory stagingBufferMemory;
   
@@ -1237,46 +1788,54 @@ void Renderer::createVertexBuffer(std::vector<Vertex> vertices,
 			   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			   stagingBuffer, stagingBufferMemory);
   
-  void* data;
-  vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, vertices.data(), (size_t) bufferSize);
+  void* mapped;
+  vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &mapped);
+  memcpy(mapped, data, (size_t) bufferSize);
   vkUnmapMemory(device, stagingBufferMemory);
   
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
 			   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			   vertexBuffer, vertexBufferMemory);
-  copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
+			   buffer, bufferMemory);
+  copyBuffer(stagingBuffer, buffer, bufferSize);
   
   vkDestroyBuffer(device, stagingBuffer, nullptr);
   vkFreeMemory(device, stagingBufferMemory, nullptr);
 }
 
+void Renderer::createVertexBuffer(std::vector<Vertex> vertices,
+								  VkBuffer &vertexBuffer, VkDeviceMemory &vertexBufferMemory) {
+  createDeviceLocalBuffer(vertices.data(), sizeof(vertices[0]) * vertices.size(),
+						  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+						  vertexBuffer, vertexBufferMemory);
+}
+
+void Renderer::createVertexBuffer(std::vector<QuantizedVertex> vertices,
+								  VkBuffer &vertexBuffer, VkDeviceMemory &vertexBufferMemory) {
+  createDeviceLocalBuffer(vertices.data(), sizeof(vertices[0]) * vertices.size(),
+						  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+						  vertexBuffer, vertexBufferMemory);
+}
+
 void Renderer::createIndexBuffer(std::vector<uint32_t> indices,
 								 VkBuffer &indexBuffer, VkDeviceMemory &indexBufferMemory) {
-  VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-  
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			   stagingBuffer, stagingBufferMemory);
-  
-  void* data;
-  vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, indices.data(), (size_t) bufferSize);
-  vkUnmapMemory(device, stagingBufferMemory);
-  
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-			   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			   indexBuffer, indexBufferMemory);
-  copyBuffer(stagingBuffer, indexBuffer, bufferSize);
-  
-  vkDestroyBuffer(device, stagingBuffer, nullptr);
-  vkFreeMemory(device, stagingBufferMemory, nullptr);
+  createDeviceLocalBuffer(indices.data(), sizeof(indices[0]) * indices.size(),
+						  VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+						  indexBuffer, indexBufferMemory);
+}
+
+void Renderer::createIndexBuffer(std::vector<uint16_t> indices,
+								 VkBuffer &indexBuffer, VkDeviceMemory &indexBufferMemory) {
+  createDeviceLocalBuffer(indices.data(), sizeof(indices[0]) * indices.size(),
+						  VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+						  indexBuffer, indexBufferMemory);
+}
+
+VkDeviceSize Renderer::instanceStride() {
+  return config.instanceFormat == InstancePacked ? sizeof(PackedInstance) : sizeof(Instance);
 }
 
 BufferSlice Renderer::writeInstanceBuffer(std::vector<Instance> instances) {
-  VkDeviceSize bufferSize = sizeof(instances[0]) * instances.size();
+  VkDeviceSize bufferSize = instanceStride() * instances.size();
   VkBuffer stagingBuffer;
   VkDeviceMemory stagingBufferMemory;
   createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
@@ -1288,49 +1847,84 @@ BufferSlice Renderer::writeInstanceBuffer(std::vector<Instance> instances) {
   // when specific elements move
   void* data;
   vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, instances.data(), (size_t) bufferSize);
+  if (config.instanceFormat == InstancePacked) {
+	PackedInstance *packed = static_cast<PackedInstance*>(data);
+	for (size_t i = 0; i < instances.size(); i++) {
+	  packed[i] = PackedInstance::fromInstance(instances[i]);
+	}
+  } else {
+	memcpy(data, instances.data(), (size_t) bufferSize);
+  }
   vkUnmapMemory(device, stagingBufferMemory);
-  
-  // TODO(caleb): we may also want to consider adding some kind of synchronization here
-  // so that the vertex buffer isn't read until the copy buffer is finished, but this may
-  // be a complete non-issue
-  VkBuffer instanceBuffer = instanceBufferPool[currentFrame].buffer;
-  uint32_t &currentOffset = instanceBufferPool[currentFrame].offset;
-
-  copyBuffer(stagingBuffer, instanceBuffer, bufferSize, currentOffset);
+  Profiler::addCounter("instance upload bytes", static_cast<double>(bufferSize));
+  
+  // NOTE: the copy is recorded into this frame's command buffer ahead of the render pass
+  // (recordInstanceCopies), so the instance buffer is only ever written once the frame that
+  // last read it is done, and the staging buffer is retired with the frame
+  BufferAllocation &instanceAlloc = instanceBufferPool[currentFrame];
+  if (instanceAlloc.offset + bufferSize > instanceAlloc.capacity) growInstanceBuffer(instanceAlloc, bufferSize);
+  VkBuffer instanceBuffer = instanceAlloc.buffer;
+  uint32_t &currentOffset = instanceAlloc.offset;
+
+  pendingInstanceCopies.push_back(InstanceCopy{
+	  .stagingBuffer = stagingBuffer,
+	  .stagingMemory = stagingBufferMemory,
+	  .instanceBuffer = instanceBuffer,
+	  .offset = currentOffset,
+	  .size = bufferSize,
+	});
 
   BufferSlice slice {
 	.offset = currentOffset,
 	.buffer = instanceBuffer
   };
-  
-  vkDestroyBuffer(device, stagingBuffer, nullptr);
-  vkFreeMemory(device, stagingBufferMemory, nullptr);
-
-  std::printf("Writing buffer at offset %d, with size: %zd and first position %f, %f, %fi\n", currentOffset, instances.size(), instances[0].position.x, instances[0].position.y, instances[0].position.z);
 
-  currentOffset += bufferSize; // TODO(caleb): Handle case where we can overflow this
-  assert(currentOffset <= (MAX_GAME_OBJECTS * sizeof(Instance)));
+  currentOffset += bufferSize;
 
   return slice;
 }
 
+// Swaps in a buffer at least twice the size (and at least big enough for needed). The ops
+// already written this frame keep their slices of the old one, which is retired like any
+// other buffer, so the new one starts empty. It never shrinks back.
+void Renderer::growInstanceBuffer(BufferAllocation &instanceAlloc, VkDeviceSize needed) {
+  VkDeviceSize capacity = std::max(instanceAlloc.capacity * 2, needed);
+  if (capacity > std::numeric_limits<uint32_t>::max()) { // BufferSlice offsets are 32 bit
+	throw std::runtime_error("instance buffer can't grow past 4GB!");
+  }
+
+  retireBuffer(instanceAlloc.buffer, instanceAlloc.memory);
+  createBuffer(capacity, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			   instanceAlloc.buffer, instanceAlloc.memory);
+  instanceAlloc.capacity = capacity;
+  instanceAlloc.offset = 0;
+
+  Profiler::addCounter("instance buffer capacity", static_cast<double>(capacity / instanceStride()));
+}
+
 void Renderer::createDescriptorPool() {
   VkDescriptorPoolSize uboDescriptorPoolSize{};
   uboDescriptorPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  uboDescriptorPoolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+  uboDescriptorPoolSize.descriptorCount = framesInFlight;
   
   VkDescriptorPoolSize textureDescriptorPoolSize{};
   textureDescriptorPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  textureDescriptorPoolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+  textureDescriptorPoolSize.descriptorCount = MAX_TEXTURES_LOADED * framesInFlight;
+  
+  VkDescriptorPoolSize textureInfoDescriptorPoolSize{};
+  textureInfoDescriptorPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  textureInfoDescriptorPoolSize.descriptorCount = framesInFlight;
   
-  std::array<VkDescriptorPoolSize, 2> poolSizes = {uboDescriptorPoolSize, textureDescriptorPoolSize};
+  std::array<VkDescriptorPoolSize, 3> poolSizes = {uboDescriptorPoolSize, textureDescriptorPoolSize,
+												   textureInfoDescriptorPoolSize};
   
   VkDescriptorPoolCreateInfo poolInfo{};
   poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
   poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
   poolInfo.pPoolSizes = poolSizes.data();
-  poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+  poolInfo.maxSets = framesInFlight;
   
   if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
 	throw std::runtime_error("failed to create descriptor pool!");
@@ -1338,20 +1932,20 @@ void Renderer::createDescriptorPool() {
 }
 
 void Renderer::createDescriptorSets() {
-  std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
+  std::vector<VkDescriptorSetLayout> layouts(framesInFlight, descriptorSetLayout);
   VkDescriptorSetAllocateInfo allocInfo{
 	.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
 	.descriptorPool = descriptorPool,
-	.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT),
+	.descriptorSetCount = framesInFlight,
 	.pSetLayouts = layouts.data(),
   };
   
-  descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+  descriptorSets.resize(framesInFlight);
   if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
 	throw std::runtime_error("failed to allocate descriptor sets!");
   }
   
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < framesInFlight; i++) {
 	VkDescriptorBufferInfo bufferInfo{
 	  .buffer = uniformBuffers[i],
 	  .offset = 0,
@@ -1368,27 +1962,27 @@ void Renderer::createDescriptorSets() {
 	  .pBufferInfo = &bufferInfo,
 	};
 
-	VkDescriptorImageInfo imageInfo[MAX_TEXTURES_LOADED] {};
-	for (size_t i = 0; i < MAX_TEXTURES_LOADED; i++) {
-	  imageInfo[i] = VkDescriptorImageInfo {
-		.sampler = textureSampler,
-		.imageView = VK_NULL_HANDLE,
-		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-	  };
-	}
+	// NOTE: the texture array starts out unwritten, addTextureImageToDescriptorSet fills slots
+	// as textures are uploaded
 	
-	VkWriteDescriptorSet textureDescriptorWrite{
+	VkDescriptorBufferInfo textureInfoBufferInfo{
+	  .buffer = textureInfoBuffer,
+	  .offset = 0,
+	  .range = VK_WHOLE_SIZE,
+	};
+
+	VkWriteDescriptorSet textureInfoDescriptorWrite{
 	  .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 	  .dstSet = descriptorSets[i],
-	  .dstBinding = 1,
+	  .dstBinding = 2,
 	  .dstArrayElement = 0,
-	  .descriptorCount = MAX_TEXTURES_LOADED,
-	  .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-	  .pImageInfo = imageInfo,
+	  .descriptorCount = 1,
+	  .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+	  .pBufferInfo = &textureInfoBufferInfo,
 	};
 	
 	std::array<VkWriteDescriptorSet, 2> descriptorWrites { uboDescriptorWrite,
-														   textureDescriptorWrite, };
+														   textureInfoDescriptorWrite, };
 	
 	vkUpdateDescriptorSets(device,
 						   static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(),
@@ -1396,8 +1990,19 @@ void Renderer::createDescriptorSets() {
   }
 }
 
+// Slots given back with releaseTextureSlot are reused first. Nothing in flight samples a
+// free slot, so it's written into every frame's set right away (the binding is
+// UPDATE_UNUSED_WHILE_PENDING, see createDescriptorSetLayout).
 void Renderer::addTextureImageToDescriptorSet(VkImageView &imageView, uint32_t &offset) {
-  assert(numTextures + 1 < MAX_TEXTURES_LOADED);
+  uint32_t slot;
+  if (!freeTextureSlots.empty()) {
+	slot = freeTextureSlots.back();
+	freeTextureSlots.pop_back();
+  } else if (numTextures < MAX_TEXTURES_LOADED) {
+	slot = numTextures++;
+  } else {
+	throw std::runtime_error("out of texture slots!");
+  }
 	
   VkDescriptorImageInfo imageInfo{
 	.sampler = textureSampler,
@@ -1406,14 +2011,103 @@ void Renderer::addTextureImageToDescriptorSet(VkImageView &imageView, uint32_t &
   };
   
   
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-	// TODO(caleb): We may want to check a freelist before assigning an image view
-	// to a texture image in the texture array
+  for (size_t i = 0; i < framesInFlight; i++) {
 	VkWriteDescriptorSet textureDescriptorWrite{
 	  .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 	  .dstSet = descriptorSets[i],
 	  .dstBinding = 1,
-	  .dstArrayElement = numTextures,
+	  .dstArrayElement = slot,
+	  .descriptorCount = 1,
+	  .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+	  .pImageInfo = &imageInfo,
+	};
+
+	vkUpdateDescriptorSets(device, 1, &textureDescriptorWrite, 0, nullptr);
+  }
+
+  textureInfoMapped[slot] = 0; // ordinary texture until setTexturePalette says otherwise
+  offset = slot;
+}
+
+// The slot may still be sampled by the frames in flight, so it only goes back on the free
+// list once destroyRetired sees they're done. A setTextureSlot for it that some frame's set
+// hasn't picked up yet is dropped, it would otherwise land on whoever gets the slot next.
+// The owner stops drawing with it right away.
+void Renderer::releaseTextureSlot(uint32_t slot) {
+  assert(slot < numTextures && slot != placeholderTextureSlot);
+  for (auto &pending : pendingTextureSlots) {
+	std::erase_if(pending, [slot](const TextureSlotWrite &write) { return write.slot == slot; });
+  }
+  retiredTextureSlots.push_back(RetiredTextureSlot{
+	  .slot = slot,
+	  .timelineValue = TIMELINE_PENDING,
+	});
+}
+
+// NOTE: the info buffer is shared by every frame and written straight through the mapping,
+// so nothing in flight may read slot's entry. A slot only gets here fresh from
+// addTextureImageToDescriptorSet, and a released one is only handed out again once
+// destroyRetired sees the timeline past the last frame that could draw with it. The first
+// frame drawing with the new entry is submitted after this, which makes the write visible.
+void Renderer::setTexturePalette(uint32_t slot, uint32_t paletteSlot, TextureFormat format) {
+  assert(slot < numTextures && paletteSlot < numTextures && isPaletteFormat(format));
+  uint32_t indexBits = format == TexturePalette4 ? 4 : 8;
+  textureInfoMapped[slot] = (paletteSlot << TEXTURE_INFO_PALETTE_SHIFT) | indexBits;
+}
+
+// NOTE: this points an existing slot at a new image (see Texture::loadLOD). The old
+// image has to stay alive until every frame that could sample it is done, use retireImage.
+void Renderer::setTextureSlot(uint32_t slot, VkImageView imageView) {
+  assert(slot < numTextures);
+  for (uint32_t i = 0; i < framesInFlight; i++) {
+	pendingTextureSlots[i].push_back(TextureSlotWrite{ .slot = slot, .imageView = imageView });
+  }
+}
+
+void Renderer::retireImage(VkImage image, VkDeviceMemory memory, VkImageView imageView) {
+  retiredImages.push_back(RetiredImage{
+	  .image = image,
+	  .memory = memory,
+	  .imageView = imageView,
+	  .timelineValue = TIMELINE_PENDING,
+	});
+}
+
+void Renderer::retireBuffer(VkBuffer buffer, VkDeviceMemory memory) {
+  retiredBuffers.push_back(RetiredBuffer{
+	  .buffer = buffer,
+	  .memory = memory,
+	  .timelineValue = TIMELINE_PENDING,
+	});
+}
+
+VkDeviceSize Renderer::getImageMemorySize(VkImage image) {
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(device, image, &memRequirements);
+  return memRequirements.size;
+}
+
+VkDeviceSize Renderer::getBufferMemorySize(VkBuffer buffer) {
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+  return memRequirements.size;
+}
+
+// called once this frame's timeline value is reached, so its descriptor set is not in use
+void Renderer::applyPendingTextureSlots() {
+  auto &pending = pendingTextureSlots[currentFrame];
+  for (const auto &write : pending) {
+	VkDescriptorImageInfo imageInfo{
+	  .sampler = textureSampler,
+	  .imageView = write.imageView,
+	  .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	};
+
+	VkWriteDescriptorSet textureDescriptorWrite{
+	  .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+	  .dstSet = descriptorSets[currentFrame],
+	  .dstBinding = 1,
+	  .dstArrayElement = write.slot,
 	  .descriptorCount = 1,
 	  .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 	  .pImageInfo = &imageInfo,
@@ -1421,19 +2115,164 @@ void Renderer::addTextureImageToDescriptorSet(VkImageView &imageView, uint32_t &
 
 	vkUpdateDescriptorSets(device, 1, &textureDescriptorWrite, 0, nullptr);
   }
+  pending.clear();
+}
+
+// Anything retired while building frame N is done with once the timeline reaches frame N's
+// value: every frame that could have used it was submitted before it. A descriptor set
+// still pointing at a destroyed image is fine, it gets its pending write before it's
+// bound again (applyPendingTextureSlots), and released slots have none left.
+void Renderer::destroyRetired(bool all) {
+  uint64_t completed = 0;
+  vkGetSemaphoreCounterValue(device, timeline, &completed);
+  auto done = [&](uint64_t value) { return all || (value != TIMELINE_PENDING && value <= completed); };
+
+  size_t kept = 0;
+  for (auto &retired : retiredImages) {
+	if (done(retired.timelineValue)) {
+	  vkDestroyImageView(device, retired.imageView, nullptr);
+	  vkDestroyImage(device, retired.image, nullptr);
+	  vkFreeMemory(device, retired.memory, nullptr);
+	} else {
+	  retiredImages[kept++] = retired;
+	}
+  }
+  retiredImages.resize(kept);
+
+  kept = 0;
+  for (auto &retired : retiredBuffers) {
+	if (done(retired.timelineValue)) {
+	  vkDestroyBuffer(device, retired.buffer, nullptr);
+	  vkFreeMemory(device, retired.memory, nullptr);
+	} else {
+	  retiredBuffers[kept++] = retired;
+	}
+  }
+  retiredBuffers.resize(kept);
+
+  kept = 0;
+  for (auto &retired : retiredTextureSlots) {
+	if (done(retired.timelineValue)) {
+	  freeTextureSlots.push_back(retired.slot);
+	} else {
+	  retiredTextureSlots[kept++] = retired;
+	}
+  }
+  retiredTextureSlots.resize(kept);
+
+  // NOTE: the presentation engine may hold on to an old image a little past the last frame
+  // rendered to it, but not past a frame on the new swapchain being done
+  std::erase_if(retiredSwapChains, [&](const RetiredSwapChain &retired) {
+	if (!done(retired.timelineValue)) return false;
+	for (auto framebuffer : retired.framebuffers) vkDestroyFramebuffer(device, framebuffer, nullptr);
+	for (auto imageView : retired.imageViews) vkDestroyImageView(device, imageView, nullptr);
+	vkDestroySwapchainKHR(device, retired.swapChain, nullptr);
+	return true;
+  });
+}
+
+// called right after a frame is submitted with value
+void Renderer::stampRetired(uint64_t value) {
+  auto stamp = [value](auto &retiredList) {
+	for (auto &retired : retiredList) {
+	  if (retired.timelineValue == TIMELINE_PENDING) retired.timelineValue = value;
+	}
+  };
+  stamp(retiredImages);
+  stamp(retiredBuffers);
+  stamp(retiredTextureSlots);
+  stamp(retiredSwapChains);
+}
+
+// For a frame that never gets submitted (the swapchain is out of date or the window is
+// minimized). Nothing on the gpu saw its instance uploads, so they're just dropped.
+void Renderer::skipFrame() {
+  for (const InstanceCopy &copy : pendingInstanceCopies) {
+	vkDestroyBuffer(device, copy.stagingBuffer, nullptr);
+	vkFreeMemory(device, copy.stagingMemory, nullptr);
+  }
+  pendingInstanceCopies.clear();
+  instanceBufferPool[currentFrame].offset = 0;
+}
+
+// Copies a headless frame out and writes it as a binary PPM. This waits for the frame (the
+// copy runs as single time commands after it on the same queue), so it's for checking what
+// a benchmark drew, not for timing it.
+void Renderer::dumpFrame(uint32_t imageIndex) {
+  VkDeviceSize size = static_cast<VkDeviceSize>(swapChainExtent.width) * swapChainExtent.height * 4;
+  VkBuffer stagingBuffer;
+  VkDeviceMemory stagingBufferMemory;
+  createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			   stagingBuffer, stagingBufferMemory);
+
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
-  offset = numTextures++;
+  // the frame graph already left the image in TRANSFER_SRC, this only orders the copy after it
+  VkImageMemoryBarrier barrier {
+	.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+	.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+	.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+	.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+	.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+	.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+	.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+	.image = swapChainImages[imageIndex],
+	.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+  };
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+					   0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+  VkBufferImageCopy region {
+	.bufferOffset = 0,
+	.bufferRowLength = 0,
+	.bufferImageHeight = 0,
+	.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+	.imageOffset = { 0, 0, 0 },
+	.imageExtent = { swapChainExtent.width, swapChainExtent.height, 1 },
+  };
+  vkCmdCopyImageToBuffer(commandBuffer, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+						 stagingBuffer, 1, &region);
+
+  endSingleTimeCommands(commandBuffer);
+
+  char path[64];
+  std::snprintf(path, sizeof(path), "frame_%06llu.ppm", static_cast<unsigned long long>(frameNumber));
+  FILE *file = std::fopen(path, "wb");
+  if (!file) {
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	throw std::runtime_error(std::string("failed to open ") + path);
+  }
+
+  void *data;
+  vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data);
+  const uint8_t *bgra = static_cast<const uint8_t *>(data); // HEADLESS_IMAGE_FORMAT
+  std::vector<uint8_t> rgb(static_cast<size_t>(swapChainExtent.width) * swapChainExtent.height * 3);
+  for (size_t i = 0; i < rgb.size() / 3; i++) {
+	rgb[i * 3 + 0] = bgra[i * 4 + 2];
+	rgb[i * 3 + 1] = bgra[i * 4 + 1];
+	rgb[i * 3 + 2] = bgra[i * 4 + 0];
+  }
+  vkUnmapMemory(device, stagingBufferMemory);
+
+  std::fprintf(file, "P6\n%u %u\n255\n", swapChainExtent.width, swapChainExtent.height);
+  std::fwrite(rgb.data(), 1, rgb.size(), file);
+  std::fclose(file);
+
+  vkDestroyBuffer(device, stagingBuffer, nullptr);
+  vkFreeMemory(device, stagingBufferMemory, nullptr);
 }
 
 
 void Renderer::createUniformBuffers() {
   VkDeviceSize bufferSize = sizeof(UniformBufferObject);
   
-  uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-  uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-  uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+  uniformBuffers.resize(framesInFlight);
+  uniformBuffersMemory.resize(framesInFlight);
+  uniformBuffersMapped.resize(framesInFlight);
   
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < framesInFlight; i++) {
 	createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 				 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 				 uniformBuffers[i], uniformBuffersMemory[i]);
@@ -1442,34 +2281,223 @@ void Renderer::createUniformBuffers() {
   }
 }
 
+void Renderer::createTextureInfoBuffer() {
+  VkDeviceSize bufferSize = MAX_TEXTURES_LOADED * sizeof(uint32_t);
+  createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			   textureInfoBuffer, textureInfoBufferMemory);
+
+  void *mapped;
+  vkMapMemory(device, textureInfoBufferMemory, 0, bufferSize, 0, &mapped);
+  textureInfoMapped = static_cast<uint32_t *>(mapped);
+  memset(textureInfoMapped, 0, bufferSize);
+}
+
+// Slot 0 is a flat grey texel that textures point instances at until they're uploaded
+// (see Texture::getLayerOffset), so nothing waits on a texture to start drawing.
+void Renderer::createPlaceholderTexture() {
+  std::vector<TextureMip> mips { TextureMip{
+	  .width = 1,
+	  .height = 1,
+	  .data = { 0x80, 0x80, 0x80, 0xFF },
+	} };
+  createTextureImage(mips, 0, TextureRGBA8, placeholderImage, placeholderImageMemory, placeholderImageView);
+  addTextureImageToDescriptorSet(placeholderImageView, placeholderTextureSlot);
+
+  mips[0].data = { 0xE0, 0xE0, 0xE0, 0xFF }; // light enough to read against the placeholder
+  createTextureImage(mips, 0, TextureRGBA8, progressImage, progressImageMemory, progressImageView);
+  addTextureImageToDescriptorSet(progressImageView, progressTextureSlot);
+}
+
+// The cube is centered on the origin like the models are, one unit on a side so an
+// instance's scale is roughly its size. Every face has its own corners for the uvs,
+// counter clockwise seen from outside like the models.
+void Renderer::createBuiltinMeshes() {
+  const glm::vec3 axes[6][3] { // normal, then u and v with u x v = normal
+	{ { 1, 0, 0}, {0, 1, 0}, {0, 0, 1} },
+	{ {-1, 0, 0}, {0, 0, 1}, {0, 1, 0} },
+	{ { 0, 1, 0}, {0, 0, 1}, {1, 0, 0} },
+	{ { 0,-1, 0}, {1, 0, 0}, {0, 0, 1} },
+	{ { 0, 0, 1}, {1, 0, 0}, {0, 1, 0} },
+	{ { 0, 0,-1}, {0, 1, 0}, {1, 0, 0} },
+  };
+  const glm::vec2 corners[4] { {0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f} };
+
+  std::vector<Vertex> vertices;
+  std::vector<Index> indices;
+  for (const auto &face : axes) {
+	Index first = static_cast<Index>(vertices.size());
+	for (const glm::vec2 &corner : corners) {
+	  glm::vec3 pos = 0.5f * face[0] + (corner.x - 0.5f) * face[1] + (corner.y - 0.5f) * face[2];
+	  vertices.push_back(Vertex{ .pos = pos, .color = {1.0f, 1.0f, 1.0f}, .texCoord = corner });
+	}
+	for (Index corner : { 0, 1, 2, 2, 3, 0 }) indices.push_back(first + corner);
+  }
+  createBuiltinMesh(vertices, indices, placeholderMesh);
+
+  // the +z face on its own, flat at z = 0 like the decorator plane
+  std::vector<Vertex> quad(vertices.begin() + 16, vertices.begin() + 20);
+  for (Vertex &vertex : quad) vertex.pos.z = 0.0f;
+  createBuiltinMesh(quad, { 0, 1, 2, 2, 3, 0 }, quadMesh);
+}
+
+void Renderer::createBuiltinMesh(const std::vector<Vertex> &vertices, const std::vector<Index> &indices,
+								 BuiltinMesh &mesh) {
+  if (config.vertexFormat == VertexQuantized) {
+	createVertexBuffer(quantizeVertices(vertices, mesh.meshConstants), mesh.vertexBuffer, mesh.vertexMemory);
+  } else {
+	mesh.meshConstants = MeshConstants{};
+	createVertexBuffer(vertices, mesh.vertexBuffer, mesh.vertexMemory);
+  }
+  createIndexBuffer(indices, mesh.indexBuffer, mesh.indexMemory);
+  mesh.numIndices = static_cast<uint32_t>(indices.size());
+}
+
+void Renderer::destroyBuiltinMesh(BuiltinMesh &mesh) {
+  vkDestroyBuffer(device, mesh.vertexBuffer, nullptr);
+  vkFreeMemory(device, mesh.vertexMemory, nullptr);
+  vkDestroyBuffer(device, mesh.indexBuffer, nullptr);
+  vkFreeMemory(device, mesh.indexMemory, nullptr);
+}
+
+Renderable BuiltinMesh::renderable() const {
+  return Renderable{
+	.meshConstants = meshConstants,
+	.vertexBuffer = vertexBuffer,
+	.indexType = VK_INDEX_TYPE_UINT32,
+	.lods = { DrawBucket{ .indexBuffer = indexBuffer, .numIndices = numIndices } },
+  };
+}
+
+// Without timestamps on the graphics queue there are just no gpu times in the profile.
+// Pipeline statistics are only queried if the device feature got enabled (createLogicalDevice).
+void Renderer::createQueryPools() {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  timestampPeriod = properties.limits.timestampPeriod;
+
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+  uint32_t validBits = queueFamilies[findQueueFamilies(physicalDevice).graphicsFamily.value()].timestampValidBits;
+  if (validBits == 0) {
+	std::printf("graphics queue has no timestamps, the profile won't have gpu times\n");
+	return;
+  }
+  timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+  VkQueryPoolCreateInfo timestampInfo {
+	.sType = 				VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+	.queryType = 			VK_QUERY_TYPE_TIMESTAMP,
+	.queryCount = 			GPU_FRAME_TIMESTAMPS,
+  };
+
+  VkQueryPoolCreateInfo statisticsInfo {
+	.sType = 				VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+	.queryType = 			VK_QUERY_TYPE_PIPELINE_STATISTICS,
+	.queryCount = 			1,
+	.pipelineStatistics = 	VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+							VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT,
+  };
+
+  for (uint32_t i = 0; i < framesInFlight; i++) {
+	GpuFrameQueries &queries = gpuFrameQueries[i];
+	if (vkCreateQueryPool(device, &timestampInfo, nullptr, &queries.timestamps) != VK_SUCCESS ||
+		(pipelineStatisticsQuery &&
+		 vkCreateQueryPool(device, &statisticsInfo, nullptr, &queries.statistics) != VK_SUCCESS)) {
+	  throw std::runtime_error("failed to create query pool!");
+	}
+  }
+
+  timestampInfo.queryCount = 2;
+  if (vkCreateQueryPool(device, &timestampInfo, nullptr, &uploadQueryPool) != VK_SUCCESS) {
+	throw std::runtime_error("failed to create query pool!");
+  }
+}
+
+// called once this frame's timeline value is reached, so what it wrote last time around is done.
+// A new render scale or MSAA level from the resolution controller applies to the frame being
+// built, the settle time in ResolutionController covers the frames already in flight.
+void Renderer::readGpuFrameQueries() {
+  GpuFrameQueries &queries = gpuFrameQueries[currentFrame];
+  if (queries.timestampsWritten > 0) {
+	std::array<uint64_t, GPU_FRAME_TIMESTAMPS> timestamps;
+	if (vkGetQueryPoolResults(device, queries.timestamps, 0, queries.timestampsWritten,
+							  queries.timestampsWritten * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+							  VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+	  double frameMs = timestampMs(timestamps[0], timestamps[1]);
+	  if (config.dynamicResolution && resolution.update(frameMs)) {
+		renderScale = resolution.scale();
+		msaaSamples = static_cast<VkSampleCountFlagBits>(resolution.samples());
+	  }
+	  Profiler::recordGpuFrame(frameMs);
+	  // the first range starts with the pass, so it has the clear in it too
+	  for (uint32_t i = 2; i < queries.timestampsWritten; i++) {
+		uint64_t rangeStart = i == 2 ? timestamps[0] : timestamps[i - 1];
+		Profiler::recordZone("gpu draw range", timestampMs(rangeStart, timestamps[i]));
+	  }
+	}
+  }
+
+  if (queries.statisticsWritten) {
+	uint64_t invocations[2]; // in bit order: vertex, then fragment
+	if (vkGetQueryPoolResults(device, queries.statistics, 0, 1, sizeof(invocations), invocations,
+							  sizeof(invocations), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+	  Profiler::addCounter("gpu vertex invocations", static_cast<double>(invocations[0]));
+	  Profiler::addCounter("gpu fragment invocations", static_cast<double>(invocations[1]));
+	}
+  }
+
+  if (config.dynamicResolution) {
+	Profiler::addCounter("render scale %", renderScale * 100.0);
+	Profiler::addCounter("msaa samples", static_cast<double>(msaaSamples));
+  }
+
+  queries.timestampsWritten = 0;
+  queries.statisticsWritten = false;
+}
+
+double Renderer::timestampMs(uint64_t begin, uint64_t end) {
+  return static_cast<double>((end - begin) & timestampMask) * timestampPeriod / 1e6;
+}
+
+// The binary semaphores are only for the swapchain, which can't take timeline ones.
+// Everything else waits on the timeline.
 void Renderer::createSyncObjects() {
-  imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+  imageAvailableSemaphores.resize(framesInFlight);
+  renderFinishedSemaphores.resize(framesInFlight);
   
   VkSemaphoreCreateInfo semaphoreInfo{};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
   
-  VkFenceCreateInfo fenceInfo{};
-  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-  
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < framesInFlight; i++) {
 	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-		vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-		vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+		vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS) {
 	  throw std::runtime_error("failed to create semaphores!");
 	}
   }
+
+  VkSemaphoreTypeCreateInfo timelineInfo {
+	.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+	.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+	.initialValue = 0,
+  };
+  semaphoreInfo.pNext = &timelineInfo;
+  if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS) {
+	throw std::runtime_error("failed to create timeline semaphore!");
+  }
 }
 
 void Renderer::createInstanceBuffers() {
-  VkDeviceSize bufferSize = MAX_GAME_OBJECTS * sizeof(instance);
-  for (auto& instanceAlloc : instanceBufferPool) {
+  VkDeviceSize bufferSize = INSTANCE_BUFFER_INITIAL_CAPACITY * instanceStride();
+  for (uint32_t i = 0; i < framesInFlight; i++) {
+	BufferAllocation &instanceAlloc = instanceBufferPool[i];
 	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 				 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 				 instanceAlloc.buffer, instanceAlloc.memory);
 	instanceAlloc.offset = 0;
+	instanceAlloc.capacity = bufferSize;
   }
 }
   
@@ -1489,24 +2517,110 @@ VkCommandBuffer Renderer::beginSingleTimeCommands(){
   beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
   
   vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+  // uploads go through here, endSingleTimeCommands reads the time back
+  uploadTimed = uploadQueryPool != VK_NULL_HANDLE && Profiler::isEnabled();
+  if (uploadTimed) {
+	vkCmdResetQueryPool(commandBuffer, uploadQueryPool, 0, 2);
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, uploadQueryPool, 0);
+  }
   
   return commandBuffer;
 }
 
 void Renderer::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
+  if (uploadTimed) vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, uploadQueryPool, 1);
   vkEndCommandBuffer(commandBuffer);
-  
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &commandBuffer;
-  
-  vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(graphicsQueue);
+
+  // NOTE: the queue runs in order, so this also waits out the frames submitted before it
+  waitTimeline(submitTimeline(commandBuffer, VK_NULL_HANDLE, VK_NULL_HANDLE));
+
+  // already waited on, so this doesn't stall any more than the upload did
+  uint64_t timestamps[2];
+  if (uploadTimed &&
+	  vkGetQueryPoolResults(device, uploadQueryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+							VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+	Profiler::recordZone("gpu upload", timestampMs(timestamps[0], timestamps[1]));
+  }
+  uploadTimed = false;
   
   vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
 
+// Every queue submission goes through here and signals the next timeline value, which is
+// returned. The binary semaphores, when not VK_NULL_HANDLE, are the swapchain's acquire
+// and present ones.
+uint64_t Renderer::submitTimeline(VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, VkSemaphore signalSemaphore) {
+  uint64_t value = timelineValue + 1;
+  VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  std::array<VkSemaphore, 2> signalSemaphores { timeline, signalSemaphore };
+  std::array<uint64_t, 2> signalValues { value, 0 }; // binary semaphores ignore theirs
+  uint32_t signalCount = signalSemaphore == VK_NULL_HANDLE ? 1 : 2;
+
+  VkTimelineSemaphoreSubmitInfo timelineInfo {
+	.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+	.waitSemaphoreValueCount = 0,
+	.pWaitSemaphoreValues = nullptr,
+	.signalSemaphoreValueCount = signalCount,
+	.pSignalSemaphoreValues = signalValues.data(),
+  };
+
+  VkSubmitInfo submitInfo {
+	.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+	.pNext = &timelineInfo,
+	.waitSemaphoreCount = waitSemaphore == VK_NULL_HANDLE ? 0u : 1u,
+	.pWaitSemaphores = &waitSemaphore,
+	.pWaitDstStageMask = &waitStage,
+	.commandBufferCount = 1,
+	.pCommandBuffers = &commandBuffer,
+	.signalSemaphoreCount = signalCount,
+	.pSignalSemaphores = signalSemaphores.data(),
+  };
+
+  if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+	throw std::runtime_error("failed to submit command buffer!");
+  }
+  timelineValue = value;
+  return value;
+}
+
+void Renderer::waitTimeline(uint64_t value) {
+  VkSemaphoreWaitInfo waitInfo {
+	.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+	.semaphoreCount = 1,
+	.pSemaphores = &timeline,
+	.pValues = &value,
+  };
+  if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+	throw std::runtime_error("failed to wait on timeline semaphore!");
+  }
+}
+
+// The instance uploads writeInstanceBuffer queued for this frame, ahead of the render pass.
+// Their staging buffers are retired with the frame.
+void Renderer::recordInstanceCopies(VkCommandBuffer commandBuffer) {
+  if (pendingInstanceCopies.empty()) return;
+
+  for (const InstanceCopy &copy : pendingInstanceCopies) {
+	VkBufferCopy copyRegion {
+	  .srcOffset = 0,
+	  .dstOffset = copy.offset,
+	  .size = copy.size,
+	};
+	vkCmdCopyBuffer(commandBuffer, copy.stagingBuffer, copy.instanceBuffer, 1, &copyRegion);
+	retireBuffer(copy.stagingBuffer, copy.stagingMemory);
+  }
+  pendingInstanceCopies.clear();
+
+  VkMemoryBarrier barrier {
+	.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+	.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+	.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+  };
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+					   0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
 void Renderer::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, uint32_t dstOffset) {
   VkCommandBuffer commandBuffer = beginSingleTimeCommands();
   
@@ -1542,6 +2656,12 @@ void Renderer::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width,
 }
 
 
+Camera Renderer::getCamera() {
+  Camera current = camera;
+  current.viewportHeight = static_cast<float>(swapChainExtent.height);
+  return current;
+}
+
 void Renderer::updateUniformBuffer(uint32_t currentImage) {
   static auto startTime = std::chrono::high_resolution_clock::now();
   
@@ -1558,15 +2678,13 @@ void Renderer::updateUniformBuffer(uint32_t currentImage) {
   //							  0.1f,
   //							  100.0f);
 
-  // NOTE(caleb): this is the top down view
-  ubo.view = glm::lookAt(glm::vec3(0.0f, 0.1f, 10.0f), // TODO(caleb): WRITE YOUR OWN MATH
-  						 glm::vec3(0.0f, 0.0f, 0.0f),
-  						 glm::vec3(0.0f, 0.0f, -1.0f));
+  // NOTE(caleb): the default camera is the top down view
+  ubo.view = glm::lookAt(camera.position, camera.target, camera.up); // TODO(caleb): WRITE YOUR OWN MATH
     
-  ubo.proj = glm::perspective(glm::radians(45.0f),
+  ubo.proj = glm::perspective(camera.fovY,
   							  swapChainExtent.width / (float) swapChainExtent.height,
-							  0.1f,
-							  100.0f);
+							  camera.nearPlane,
+							  camera.farPlane);
 
   ubo.proj[1][1] *= -1;
   
@@ -1574,153 +2692,111 @@ void Renderer::updateUniformBuffer(uint32_t currentImage) {
   memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
 }
 
-void Renderer::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
-  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-  
-  VkImageMemoryBarrier barrier{};
-  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  barrier.oldLayout = oldLayout;
-  barrier.newLayout = newLayout;
-  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.image = image;
-  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  barrier.subresourceRange.baseMipLevel = 0;
-  barrier.subresourceRange.levelCount = mipLevels;
-  barrier.subresourceRange.baseArrayLayer = 0;
-  barrier.subresourceRange.layerCount = 1;
-  
-  VkPipelineStageFlags sourceStage, destinationStage;
-  
-  if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-	barrier.srcAccessMask = 0;
-	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	
-	sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-	destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-  } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	
-	sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-	destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-  } else {
-	throw std::invalid_argument("unimplemented layout transition!");
-  }
-  
-  vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-  
-  endSingleTimeCommands(commandBuffer);
-}
-
 void Renderer::drawFrame(std::vector<RenderOp> renderOps) {
-  vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+  PROFILE_ZONE("drawFrame");
+  waitTimeline(frameTimelineValues[currentFrame]);
+
+  applyPendingTextureSlots();
+  destroyRetired();
+  readGpuFrameQueries();
+
+  if (swapChainSuspended) {
+	recreateSwapChain();
+	if (swapChainSuspended) {
+	  skipFrame();
+	  return;
+	}
+  }
   
-  uint32_t imageIndex;
+  uint32_t imageIndex = currentFrame; // headless, the offscreen target is free once the frame's value is reached
   
   // get swapchain image
-  switch (vkAcquireNextImageKHR(device, swapChain,
-								UINT64_MAX, imageAvailableSemaphores[currentFrame],
-								VK_NULL_HANDLE,
-								&imageIndex)) {
-  case VK_SUCCESS:
-    break;
-  case VK_SUBOPTIMAL_KHR:
-    break;
-  case VK_ERROR_OUT_OF_DATE_KHR:
-    recreateSwapChain();
-    return;
-  default:
-    throw std::runtime_error("failed to acquire swap chain image!");
-  }
-  
-  vkResetFences(device, 1, &inFlightFences[currentFrame]);
+  if (!config.headless) {
+	switch (vkAcquireNextImageKHR(device, swapChain,
+								  UINT64_MAX, imageAvailableSemaphores[currentFrame],
+								  VK_NULL_HANDLE,
+								  &imageIndex)) {
+	case VK_SUCCESS:
+	  break;
+	case VK_SUBOPTIMAL_KHR: // still presentable, rebuild after this frame
+	  framebufferResized = true;
+	  break;
+	case VK_ERROR_OUT_OF_DATE_KHR:
+	  recreateSwapChain();
+	  skipFrame();
+	  return;
+	default:
+	  throw std::runtime_error("failed to acquire swap chain image!");
+	}
+  }
   
   vkResetCommandBuffer(commandBuffers[currentFrame], 0);
   recordCommandBuffer(commandBuffers[currentFrame], imageIndex, renderOps);
   updateUniformBuffer(currentFrame);
   
-  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-  VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+  // headless there's nothing to acquire or present, so only the timeline gets signalled
   VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
+  frameTimelineValues[currentFrame] =
+	submitTimeline(commandBuffers[currentFrame],
+				   config.headless ? VK_NULL_HANDLE : imageAvailableSemaphores[currentFrame],
+				   config.headless ? VK_NULL_HANDLE : signalSemaphores[0]);
+  stampRetired(frameTimelineValues[currentFrame]);
+
+  if (config.headless) {
+	if (config.dumpFrameInterval > 0 && frameNumber % config.dumpFrameInterval == 0) dumpFrame(imageIndex);
+  } else {
+	VkSwapchainKHR swapChains[] = {swapChain};
+  
+	VkPresentInfoKHR presentInfo {
+	  .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+	  .waitSemaphoreCount = 1,
+	  .pWaitSemaphores = signalSemaphores,
+	  .swapchainCount = 1,
+	  .pSwapchains = swapChains,
+	  .pImageIndices = &imageIndex,
+	  .pResults = nullptr,
+	};
   
-  VkSubmitInfo submitInfo {
-	.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-	.waitSemaphoreCount = 1,
-	.pWaitSemaphores = waitSemaphores,
-	.pWaitDstStageMask = waitStages,
-	.commandBufferCount = 1,
-	.pCommandBuffers = &commandBuffers[currentFrame],
-	.signalSemaphoreCount = 1,
-	.pSignalSemaphores = signalSemaphores,
-  };
-  
-  if (auto res = vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]);
-	  res != VK_SUCCESS) {
-	throw std::runtime_error("failed to submit draw command buffer!");
-  }
-  
-  VkSwapchainKHR swapChains[] = {swapChain};
-  
-  VkPresentInfoKHR presentInfo {
-	.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-	.waitSemaphoreCount = 1,
-	.pWaitSemaphores = signalSemaphores,
-	.swapchainCount = 1,
-	.pSwapchains = swapChains,
-	.pImageIndices = &imageIndex,
-	.pResults = nullptr,
-  };
-  
-  // present image
-  switch (vkQueuePresentKHR(presentQueue, &presentInfo)) {
-  case VK_SUCCESS:
-    break;
-  case VK_ERROR_OUT_OF_DATE_KHR:
-    recreateSwapChain();
-  case VK_SUBOPTIMAL_KHR:
-    recreateSwapChain();
-  default:
-    throw std::runtime_error("failed to present swap chain image!");
-  }
-  
-  if (framebufferResized) {
-    framebufferResized = false;
-    recreateSwapChain();
+	// present image, the frame was submitted either way so it still counts below
+	VkResult presentResult = vkQueuePresentKHR(presentQueue, &presentInfo);
+	if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR || framebufferResized) {
+	  recreateSwapChain();
+	} else if (presentResult != VK_SUCCESS) {
+	  throw std::runtime_error("failed to present swap chain image!");
+	}
   }
 
+  renderStats.frames++;
   instanceBufferPool[currentFrame].offset = 0;
-  currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  currentFrame = (currentFrame + 1) % framesInFlight;
+  frameNumber++;
 }
 
+// Builds the new swapchain from the old one, so presentation carries on while it's
+// replaced, and retires the old one along with everything sized to its extent instead of
+// waiting for the device to go idle. Minimized there's nothing to build, so it just
+// marks the swapchain suspended and drawFrame tries again next frame.
 void Renderer::recreateSwapChain() {
-  int width, height = 0;
+  framebufferResized = false;
+  int width = 0, height = 0;
   glfwGetFramebufferSize(window, &width, &height);
-  while (width == 0 || height == 0) {
-    glfwGetFramebufferSize(window, &width, &height);
-    glfwWaitEvents();
-  }
-  
-  vkDeviceWaitIdle(device);
-  
-  cleanupSwapChain();
-  
+  swapChainSuspended = width == 0 || height == 0;
+  if (swapChainSuspended) return;
+
+  RetiredSwapChain retired {
+	.swapChain = swapChain,
+	.imageViews = std::move(swapChainImageViews),
+	.framebuffers = std::move(swapChainFramebuffers),
+	.timelineValue = TIMELINE_PENDING,
+  };
+
   createSwapChain();
-  createImageViews();
-  createColorResources();
-  createDepthResources();
-  createFramebuffers();
+  retiredSwapChains.push_back(std::move(retired)); // retired by vkCreateSwapchainKHR, not yet destroyed
+  createImageViews(); // frameGraph rebuilds the targets and beginRendering the framebuffers
 }
 
 void Renderer::cleanupSwapChain() {
-  
-  vkDestroyImageView(device, colorImageView, nullptr);
-  vkDestroyImage(device, colorImage, nullptr);
-  vkFreeMemory(device, colorImageMemory, nullptr);
-  
-  vkDestroyImageView(device, depthImageView, nullptr);
-  vkDestroyImage(device, depthImage, nullptr);
-  vkFreeMemory(device, depthImageMemory, nullptr);
+  frameGraph.destroy();
   
   for (auto framebuffer : swapChainFramebuffers) {
     vkDestroyFramebuffer(device, framebuffer, nullptr);
@@ -1729,6 +2805,14 @@ void Renderer::cleanupSwapChain() {
   for (auto imageView : swapChainImageViews) {
     vkDestroyImageView(device, imageView, nullptr);
   }
+
+  if (config.headless) { // we own the images, not a swapchain
+	for (size_t i = 0; i < swapChainImages.size(); i++) {
+	  vkDestroyImage(device, swapChainImages[i], nullptr);
+	  vkFreeMemory(device, offscreenImageMemory[i], nullptr);
+	}
+	return;
+  }
   vkDestroySwapchainKHR(device, swapChain, nullptr);
 }
 
@@ -1739,10 +2823,25 @@ void Renderer::cleanup() {
   vkDeviceWaitIdle(device);
   
   cleanupSwapChain();
+
+  skipFrame();
+  destroyRetired(true);
+
+  vkDestroyImageView(device, placeholderImageView, nullptr);
+  vkDestroyImage(device, placeholderImage, nullptr);
+  vkFreeMemory(device, placeholderImageMemory, nullptr);
+  vkDestroyImageView(device, progressImageView, nullptr);
+  vkDestroyImage(device, progressImage, nullptr);
+  vkFreeMemory(device, progressImageMemory, nullptr);
+  destroyBuiltinMesh(placeholderMesh);
+  destroyBuiltinMesh(quadMesh);
   
   vkDestroySampler(device, textureSampler, nullptr);
+
+  vkDestroyBuffer(device, textureInfoBuffer, nullptr);
+  vkFreeMemory(device, textureInfoBufferMemory, nullptr);
   
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < framesInFlight; i++) {
 	vkDestroyBuffer(device, uniformBuffers[i], nullptr);
 	vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
 
@@ -1760,14 +2859,23 @@ void Renderer::cleanup() {
   vkDestroyPipeline(device, instancedGraphicsPipeline, nullptr);
   vkDestroyPipelineLayout(device, instancedPipelineLayout, nullptr);
 
+  destroyShaderProgram(simpleShaders);
+  destroyShaderProgram(instancedShaders);
+
   
   vkDestroyRenderPass(device, renderPass, nullptr);
   
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < framesInFlight; i++) {
 	vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
 	vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-	vkDestroyFence(device, inFlightFences[i], nullptr);
   }
+  vkDestroySemaphore(device, timeline, nullptr);
+  
+  for (auto &queries : gpuFrameQueries) {
+	vkDestroyQueryPool(device, queries.timestamps, nullptr);
+	vkDestroyQueryPool(device, queries.statistics, nullptr);
+  }
+  vkDestroyQueryPool(device, uploadQueryPool, nullptr);
   
   vkDestroyCommandPool(device, commandPool, nullptr);
   
@@ -1777,8 +2885,10 @@ void Renderer::cleanup() {
 	DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
   }
   
-  vkDestroySurfaceKHR(instance, surface, nullptr);
+  if (!config.headless) vkDestroySurfaceKHR(instance, surface, nullptr);
   vkDestroyInstance(instance, nullptr);
+
+  if (config.headless) return;
   
   glfwDestroyWindow(window);
   
@@ -1827,8 +2937,8 @@ QueueFamilyIndices Renderer::findQueueFamilies(VkPhysicalDevice device) {
       indices.graphicsFamily = i;
     }
 	
-	VkBool32 presentSupport = false;
-	vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+	VkBool32 presentSupport = config.headless; // nothing to present to, any family will do
+	if (!config.headless) vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
     if (presentSupport) {
       indices.presentFamily = i;
     }
@@ -1850,17 +2960,51 @@ int Renderer::rateDeviceSuitability(VkPhysicalDevice device) {
   if (QueueFamilyIndices indices = findQueueFamilies(device); !indices.isComplete()) return 0;
   
   // if the GPU does not have the required extensions, the GPU is unsuitable (return 0)
-  if (!checkDeviceExtensionSupport(device)) return 0;
+  if (!checkDeviceExtensionSupport(device, getRequiredDeviceExtensions())) return 0;
   
   // if the GPU does not have the required features, the GPU is unsuitable (return 0)
   VkPhysicalDeviceFeatures supportedFeatures;
   vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
   if (!(supportedFeatures.samplerAnisotropy &&
 		supportedFeatures.sampleRateShading)) return 0;
-  
+
+  // the texture array needs descriptor indexing (see createDescriptorSetLayout) and frames
+  // sync on a timeline semaphore (see submitTimeline), both core in 1.2
+  if (deviceProperties.apiVersion < VK_API_VERSION_1_2) return 0;
+  VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures {
+	.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+  };
+  VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures {
+	.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+	.pNext = &timelineFeatures,
+  };
+  VkPhysicalDeviceFeatures2 supportedFeatures2 {
+	.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+	.pNext = &indexingFeatures,
+  };
+  vkGetPhysicalDeviceFeatures2(device, &supportedFeatures2);
+  if (!(indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+		indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+		indexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+		indexingFeatures.descriptorBindingPartiallyBound &&
+		timelineFeatures.timelineSemaphore)) return 0;
+
+  VkPhysicalDeviceDescriptorIndexingProperties indexingProperties {
+	.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES,
+  };
+  VkPhysicalDeviceProperties2 deviceProperties2 {
+	.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+	.pNext = &indexingProperties,
+  };
+  vkGetPhysicalDeviceProperties2(device, &deviceProperties2);
+  if (indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers < MAX_TEXTURES_LOADED ||
+	  indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages < MAX_TEXTURES_LOADED) return 0;
+
   // if the GPU does not have swap chain support, the GPU is unsuitable (return 0)
-  SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
-  if ( swapChainSupport.formats.empty() || swapChainSupport.presentModes.empty()) return 0;
+  if (!config.headless) {
+	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
+	if ( swapChainSupport.formats.empty() || swapChainSupport.presentModes.empty()) return 0;
+  }
   
   // Discrete GPUs have a significant performance advantage
   if (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) score += 1000;
@@ -1895,13 +3039,17 @@ uint32_t Renderer::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags pro
   throw std::runtime_error("failed to find suitable gpu memory type!");
 }
 
-VkSampleCountFlagBits Renderer::getMaxUsableSampleCount() {
+// the sample counts both the color and the depth target can have
+VkSampleCountFlags Renderer::getUsableSampleCounts() {
   VkPhysicalDeviceProperties physicalDeviceProperties;
   vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
   
-  VkSampleCountFlags counts =
-	physicalDeviceProperties.limits.framebufferColorSampleCounts &
+  return physicalDeviceProperties.limits.framebufferColorSampleCounts &
 	physicalDeviceProperties.limits.framebufferDepthSampleCounts;
+}
+
+VkSampleCountFlagBits Renderer::getMaxUsableSampleCount() {
+  VkSampleCountFlags counts = getUsableSampleCounts();
 
   if (counts & VK_SAMPLE_COUNT_64_BIT)  return VK_SAMPLE_COUNT_64_BIT;
   if (counts & VK_SAMPLE_COUNT_32_BIT)  return VK_SAMPLE_COUNT_32_BIT;
@@ -1932,6 +3080,7 @@ void Renderer::destroyImageView(VkImageView imageView) {
 
 void Renderer::setCursorMovementCallback(GLFWcursor *cursor,
 										  CursorPositionCallback cursorPositionCallback){
+  if (config.headless) return;
   if (cursor != nullptr) {
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
 	glfwSetCursor(window, cursor);
@@ -1946,10 +3095,12 @@ void Renderer::setCursorMovementCallback(GLFWcursor *cursor,
 
 
 void Renderer::setMouseButtonCallback(MouseButtonCallback mouseButtonCallback){
+  if (config.headless) return;
   glfwSetMouseButtonCallback(window, mouseButtonCallback);
 }
 
 GLFWcursor *Renderer::createCursor(unsigned char pixels[16*16*4]) {
+  if (config.headless) return nullptr;
   GLFWimage image;
   image.width = 16;
   image.height = 16;
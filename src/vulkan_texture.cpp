@@ -7,6 +7,10 @@ SDG
 							  Vulkan Texture Implementation
 */
 
+#include <algorithm>
+#include <cmath>
+#include <string>
+
 #include "vendor/stb_image.h"
 
 #include "asset.hh"
@@ -14,50 +18,160 @@ SDG
 Texture::Texture(skyGUID guid, AssetStore &assetStore, Renderer &renderer)
   : Asset(guid, assetStore, renderer) {}
 
-bool Texture::load(){
-  if (loaded) return true;
+/* ================================ Residency ================================ */
 
+// runs on the loader thread when prefetched, so only files and decoding in here
+bool Texture::prepare() {
   std::string texturePath = assetStore.getLocation(guid); // TODO(caleb): get rid or std::string
 
-  int texWidth, texHeight, texChannels;
-  stbi_uc *pixels = stbi_load(texturePath.c_str(),
-							  &texWidth, &texHeight,
-							  &texChannels, STBI_rgb_alpha);
-  size_t imageSize = imageSize = texWidth * texHeight * 4;
+  // prefer the cooked texture (tools/texture_cooker), it has its mips already and
+  // doesn't need decoding. Devices without BC (or 4 bit) support get the png instead.
+  std::string cookedPath = cookedTexturePath(texturePath);
+  AssetBytes cookedFile;
+  bool cooked = readAssetBytes(cookedPath, cookedFile);
+  cooked = cooked && readKTX2(cookedFile.data, cookedFile.size, cookedPath, format, mips, palette);
+  if (cooked && !renderer.supportsTextureFormat(format)) {
+	std::printf("texture %s: format %u not supported, decoding the png\n", guid.c_str(), format);
+	cooked = false;
+  }
+  if (!cooked) {
+	mips.clear();
+	palette.clear();
+	decodeSource(texturePath);
+  }
+
+  std::printf("texture %s: %ux%u %s, %zu mips, %zu palette colors\n", guid.c_str(),
+			  mips[0].width, mips[0].height, cooked ? cookedPath.c_str() : "(decoded)",
+			  mips.size(), palette.size() / 4);
+  return true;
+}
+
+void Texture::upload() {
+  if (!palette.empty()) {
+	std::vector<TextureMip> paletteMip { TextureMip{
+		.width = static_cast<uint32_t>(palette.size() / 4),
+		.height = 1,
+		.data = palette,
+	  } };
+	renderer.createTextureImage(paletteMip, 0, TextureRGBA8,
+								paletteImage.image, paletteImage.memory, paletteImage.imageView);
+	renderer.addTextureImageToDescriptorSet(paletteImage.imageView, paletteImage.layerOffset);
+  }
 
-  std::printf("imageSize %d\n", imageSize);
+  // start with only the small mips, AssetStore::updateTextureStreaming brings in the rest
+  residentMip = wantedMip = baseMip();
+  residentBytes = chainBytes(residentMip);
+  renderer.createTextureImage(mips, residentMip, format, image.image, image.memory, image.imageView);
+  renderer.addTextureImageToDescriptorSet(image.imageView, image.layerOffset);
+  if (!palette.empty()) renderer.setTexturePalette(image.layerOffset, paletteImage.layerOffset, format);
+}
+
+void Texture::decodeSource(const std::string &texturePath) {
+  AssetBytes file;
+  int texWidth, texHeight, texChannels;
+  stbi_uc *pixels = nullptr;
+  if (readAssetBytes(texturePath, file)) {
+	pixels = stbi_load_from_memory(file.data, static_cast<int>(file.size),
+								   &texWidth, &texHeight,
+								   &texChannels, STBI_rgb_alpha);
+  }
 
   if (!pixels) { // TODO(caleb): Maybe assert instead  of throwing errors?
 	char dst[500];
 	// TODO(caleb): get rid of std::string
-	std::sprintf(dst, "failed to load texture image! path: %s", texturePath.c_str()); 
+	std::sprintf(dst, "failed to load texture image! path: %s", texturePath.c_str());
 	throw std::runtime_error(dst);
   }
 
+  // flat colored art is lossless and 4-8x smaller as palette indices, everything else is RGBA8
+  if (!buildPaletteTexture(pixels, texWidth, texHeight, renderer.supportsTextureFormat(TexturePalette4),
+						   format, mips, palette)) {
+	format = TextureRGBA8;
+	mips = buildMipChain(pixels, texWidth, texHeight);
+	palette.clear();
+  }
+  stbi_image_free(pixels);
+}
 
-  // TODO(caleb): Right now this doesn't store the miplevels because we're generating them
-  // at load time. We may need that later
-  renderer.createTextureImage(pixels, texWidth, texHeight, texChannels,
-							  image.image, image.memory, image.imageView);
+// the slots go back to the renderer too, getLayerOffset hands out the placeholder until
+// the texture is uploaded again (into whatever slots are free then)
+void Texture::release() {
+  renderer.retireImage(image.image, image.memory, image.imageView);
+  renderer.releaseTextureSlot(image.layerOffset);
+  if (!palette.empty()) {
+	renderer.retireImage(paletteImage.image, paletteImage.memory, paletteImage.imageView);
+	renderer.releaseTextureSlot(paletteImage.layerOffset);
+  }
+  mips.clear();
+  mips.shrink_to_fit();
+  palette.clear();
+  residentBytes = 0;
+}
 
-  renderer.addTextureImageToDescriptorSet(image.imageView, image.layerOffset);
+AssetSize Texture::cpuSize() {
+  if (!loaded) return 0;
+  AssetSize bytes = palette.size();
+  for (const auto &mip : mips) bytes += mip.data.size();
+  return bytes;
+}
 
-  stbi_image_free(pixels);
-  return true;
+AssetSize Texture::gpuSize() {
+  if (!loaded) return 0;
+  AssetSize bytes = renderer.getImageMemorySize(image.image);
+  if (!palette.empty()) bytes += renderer.getImageMemorySize(paletteImage.image);
+  return bytes;
 }
 
-void Texture::unload(){
-  renderer.destroyImageView(image.imageView);
-  renderer.destroyImage(image.image);
-  renderer.freeMemory(image.memory);
+void Texture::loadLOD(LOD lod){
+  if (!loaded) return;
+
+  uint32_t mip = std::min(static_cast<uint32_t>(std::max(lod, 0)), baseMip());
+  if (mip == residentMip) return;
+
+  // the slot stays the same, so instances that already have our layer offset are fine
+  Image_st next { .layerOffset = image.layerOffset };
+  renderer.createTextureImage(mips, mip, format, next.image, next.memory, next.imageView);
+  renderer.setTextureSlot(image.layerOffset, next.imageView);
+  renderer.retireImage(image.image, image.memory, image.imageView);
+
+  std::printf("texture %s: mip %u -> %u (%ux%u)\n", guid.c_str(),
+			  residentMip, mip, mips[mip].width, mips[mip].height);
+
+  image = next;
+  residentMip = mip;
+  residentBytes = chainBytes(mip);
 }
 
-// TODO(caleb): implement all these
-void Texture::loadLOD(LOD lod){}
-void Texture::loadLOD(LOD lod[]){}
-void Texture::unloadLOD(LOD lod){}
-void Texture::unloadLOD(LOD lod[]){}
+void Texture::unloadLOD(LOD lod){
+  if (lod >= static_cast<LOD>(residentMip)) loadLOD(lod + 1);
+}
+
+// finest mip that still fits in TEXTURE_STREAM_BASE_SIZE
+uint32_t Texture::baseMip() {
+  uint32_t mip = 0;
+  while (mip + 1 < mips.size() &&
+		 std::max(mips[mip].width, mips[mip].height) > TEXTURE_STREAM_BASE_SIZE) {
+	mip++;
+  }
+  return mip;
+}
+
+// NOTE: assumes the texture is spread once over the object, which holds for
+// everything we have right now (one atlas per model).
+uint32_t Texture::mipForScreenSize(float pixels) {
+  if (pixels <= 1.0f) return baseMip();
+  float texels = static_cast<float>(std::max(mips[0].width, mips[0].height));
+  auto mip = static_cast<uint32_t>(std::max(std::floor(std::log2(texels / pixels)), 0.0f));
+  return std::min(mip, baseMip());
+}
+
+VkDeviceSize Texture::chainBytes(uint32_t firstMip) {
+  VkDeviceSize bytes = palette.size();
+  for (uint32_t i = firstMip; i < mips.size(); i++) bytes += mips[i].data.size();
+  return bytes;
+}
 
+// until the texture is uploaded (or after it's been evicted) instances get the placeholder
 uint32_t Texture::getLayerOffset() {
-  return image.layerOffset;
+  return loaded ? image.layerOffset : renderer.getPlaceholderTextureSlot();
 }
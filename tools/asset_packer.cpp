@@ -0,0 +1,165 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+									 Asset Packer
+*/
+
+// Builds the asset pack (see asset_pack.hh) the game maps at startup.
+//
+//   asset_packer out.pack directories...
+//
+// Every model, texture and shader under the directories goes in, named by its path
+// relative to the directory's parent, so "models" or "../models" both give "models/...".
+// Run it after the shaders are compiled and the textures cooked, the asset_pack target
+// does that from the game's working directory.
+//
+// Entries are LZ4 compressed when that saves at least a quarter of their size (the OBJs
+// do, pngs and BC blocks mostly don't), everything else is stored so the game can use
+// it straight out of the mapping.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "asset_pack.hh"
+
+const double LZ4_MIN_SAVING = 0.25;
+
+struct PackFile {
+  std::string				name;
+  std::vector<uint8_t>		data;		// what goes into the pack
+  AssetPackEntry			entry {};
+};
+
+static bool readFile(const std::filesystem::path &path, std::vector<uint8_t> &data) {
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  if (!in) return false;
+  data.resize(static_cast<size_t>(in.tellg()));
+  in.seekg(0);
+  in.read(reinterpret_cast<char *>(data.data()), data.size());
+  return static_cast<bool>(in);
+}
+
+static void padTo(std::ofstream &out, uint64_t &offset, uint64_t alignment) {
+  static const char zeros[ASSET_PACK_ALIGNMENT] = {};
+  uint64_t padding = (alignment - offset % alignment) % alignment;
+  out.write(zeros, padding);
+  offset += padding;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+	std::printf("usage: %s out.pack directories...\n", argv[0]);
+	return 1;
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+
+  std::vector<PackFile> files;
+  for (int i = 2; i < argc; i++) {
+	std::filesystem::path directory = std::filesystem::path(argv[i]).lexically_normal();
+	if (!std::filesystem::is_directory(directory)) {
+	  std::printf("%s: not a directory, skipping\n", argv[i]);
+	  continue;
+	}
+	std::filesystem::path root = directory.parent_path();
+	if (root.empty()) root = ".";
+
+	for (const auto &item : std::filesystem::recursive_directory_iterator(directory)) {
+	  if (!item.is_regular_file()) continue;
+	  AssetPackFormat format = assetPackFormat(item.path().string());
+	  if (format == AssetPackOther) continue; // blend files, mtls and the like
+
+	  PackFile file;
+	  file.name = assetPackName(std::filesystem::relative(item.path(), root).string());
+	  if (!readFile(item.path(), file.data)) {
+		std::printf("%s: failed to read\n", item.path().string().c_str());
+		return 1;
+	  }
+	  file.entry.format = format;
+	  files.push_back(std::move(file));
+	}
+  }
+
+  // find does a binary search over the names, so they're sorted bytewise like string_view compares
+  std::sort(files.begin(), files.end(), [](const PackFile &a, const PackFile &b) { return a.name < b.name; });
+  for (size_t i = 1; i < files.size(); i++) {
+	if (files[i].name == files[i - 1].name) {
+	  std::printf("%s is in the pack twice\n", files[i].name.c_str());
+	  return 1;
+	}
+  }
+
+  std::string names;
+  uint64_t rawBytes = 0;
+  for (PackFile &file : files) {
+	AssetPackEntry &entry = file.entry;
+	entry.rawSize = file.data.size();
+	entry.contentHash = hashAssetBytes(file.data.data(), file.data.size());
+	entry.nameOffset = static_cast<uint32_t>(names.size());
+	entry.nameSize = static_cast<uint32_t>(file.name.size());
+	names += file.name;
+
+	entry.compression = AssetPackStored;
+	if (!file.data.empty()) {
+	  std::vector<uint8_t> compressed = compressLZ4(file.data.data(), file.data.size());
+	  if (compressed.size() <= file.data.size() * (1.0 - LZ4_MIN_SAVING)) {
+		entry.compression = AssetPackLZ4;
+		file.data = std::move(compressed);
+	  }
+	}
+	entry.size = file.data.size();
+	rawBytes += entry.rawSize;
+  }
+
+  AssetPackHeader header {};
+  std::memcpy(header.magic, ASSET_PACK_MAGIC, sizeof(ASSET_PACK_MAGIC));
+  header.version = ASSET_PACK_VERSION;
+  header.entryCount = static_cast<uint32_t>(files.size());
+  header.namesOffset = sizeof(header) + sizeof(AssetPackEntry) * files.size();
+  header.namesSize = names.size();
+
+  uint64_t offset = header.namesOffset + header.namesSize;
+  for (PackFile &file : files) {
+	offset = (offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+	file.entry.offset = offset;
+	offset += file.entry.size;
+  }
+
+  std::ofstream out(argv[1], std::ios::binary);
+  if (!out) {
+	std::printf("%s: failed to open for writing\n", argv[1]);
+	return 1;
+  }
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  for (const PackFile &file : files) {
+	out.write(reinterpret_cast<const char *>(&file.entry), sizeof(file.entry));
+  }
+  out.write(names.data(), names.size());
+
+  uint64_t written = header.namesOffset + header.namesSize;
+  for (const PackFile &file : files) {
+	padTo(out, written, ASSET_PACK_ALIGNMENT);
+	out.write(reinterpret_cast<const char *>(file.data.data()), file.data.size());
+	written += file.data.size();
+
+	std::printf("%-56s %9zu -> %9zu %s\n", file.name.c_str(), static_cast<size_t>(file.entry.rawSize),
+				static_cast<size_t>(file.entry.size), file.entry.compression == AssetPackLZ4 ? "lz4" : "");
+  }
+  if (!out) {
+	std::printf("%s: write failed\n", argv[1]);
+	return 1;
+  }
+
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+  std::printf("%s: %zu files, %zu bytes -> %zu bytes in %.1f ms\n", argv[1], files.size(),
+			  static_cast<size_t>(rawBytes), static_cast<size_t>(written), elapsed.count());
+  return 0;
+}
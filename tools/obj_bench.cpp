@@ -0,0 +1,218 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+									  OBJ Bench
+*/
+
+// Compares src/obj_loader.cpp with the path Mesh used before it: tinyobj::LoadObj and
+// an unordered_map<Vertex> keyed with glm's hash (recreated here so this doesn't need glm).
+//
+//   obj_bench [--runs N] [--threads N] models...
+//
+// Without models it runs over every OBJ in the repo. For each one it prints the best of
+// N runs for both loaders, checks they come out with the same vertices and indices, checks
+// every number parseObjFloat reads against strtof, and shows how the two hashes spread the
+// unique vertices over a power of two table (what unordered_map and loadObj index with).
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "vendor/tiny_obj_loader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "asset_pack.hh"
+#include "obj_loader.hh"
+
+const char *DEFAULT_MODELS[] = {
+  "models/viking_room/viking_room.obj",
+  "models/maneki_neko/source/neko.obj",
+  "models/orc_low_poly/orc_low_poly.obj",
+  "models/human_low_poly/human_low_poly.obj",
+  "models/bullet/bullet.obj",
+  "models/explosion/explosion_regular.obj",
+};
+
+typedef std::chrono::high_resolution_clock BenchClock;
+
+/* ============================ The Old Path ============================ */
+
+struct LegacyVertex {
+  float						pos[3];
+  float						color[3];
+  float						texCoord[2];
+  bool operator==(const LegacyVertex &other) const {
+	return std::equal(pos, pos + 3, other.pos) && std::equal(color, color + 3, other.color) &&
+	  std::equal(texCoord, texCoord + 2, other.texCoord);
+  }
+};
+
+// glm::hash<vec3> / <vec2> (hash_combine over std::hash<float>) and renderer.hh's combine
+static size_t glmHash(const float *values, int count) {
+  size_t seed = 0;
+  std::hash<float> hasher;
+  for (int i = 0; i < count; i++) seed ^= hasher(values[i]) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+  return seed;
+}
+
+struct LegacyVertexHash {
+  size_t operator()(const LegacyVertex &vertex) const {
+	return ((glmHash(vertex.pos, 3) ^ (glmHash(vertex.color, 3) << 1)) >> 1) ^ (glmHash(vertex.texCoord, 2) << 1);
+  }
+};
+
+static void loadLegacy(const char *path, std::vector<LegacyVertex> &vertices, std::vector<uint32_t> &indices) {
+  tinyobj::attrib_t attrib;
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  std::string err;
+  if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, path)) throw std::runtime_error(err);
+
+  std::unordered_map<LegacyVertex, uint32_t, LegacyVertexHash> uniqueVertices;
+  vertices.clear();
+  indices.clear();
+  for (const auto &shape : shapes) {
+	for (const auto &index : shape.mesh.indices) {
+	  LegacyVertex vertex {};
+	  std::memcpy(vertex.pos, &attrib.vertices[3 * index.vertex_index], sizeof(vertex.pos));
+	  vertex.texCoord[0] = attrib.texcoords[2 * index.texcoord_index + 0];
+	  vertex.texCoord[1] = 1.0f - attrib.texcoords[2 * index.texcoord_index + 1];
+	  vertex.color[0] = vertex.color[1] = vertex.color[2] = 1.0f;
+
+	  if (uniqueVertices.count(vertex) == 0) {
+		uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+		vertices.push_back(vertex);
+	  }
+	  indices.push_back(uniqueVertices[vertex]);
+	}
+  }
+}
+
+/* ================================ Checks ================================ */
+
+// largest difference in ulps between parseObjFloat and strtof over every number on v/vt lines
+static int checkFloats(const AssetBytes &file, size_t &numbers) {
+  const char *p = reinterpret_cast<const char *>(file.data), *end = p + file.size;
+  int worst = 0;
+  numbers = 0;
+  while (p < end) {
+	const char *lineEnd = static_cast<const char *>(std::memchr(p, '\n', end - p));
+	if (lineEnd == nullptr) lineEnd = end;
+	if (lineEnd - p > 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == 't')) {
+	  std::string line(p + 2, lineEnd);
+	  const char *q = line.c_str(), *qEnd = q + line.size();
+	  while (true) {
+		while (q < qEnd && (*q == ' ' || *q == '\r')) q++;
+		if (q >= qEnd) break;
+		char *expectedEnd;
+		float expected = std::strtof(q, &expectedEnd), value;
+		const char *next = parseObjFloat(q, qEnd, value);
+		if (next != expectedEnd) return 1 << 30;
+
+		int32_t a, b;
+		std::memcpy(&a, &expected, 4);
+		std::memcpy(&b, &value, 4);
+		worst = std::max(worst, std::abs(a - b));
+		numbers++;
+		q = next;
+	  }
+	}
+	p = lineEnd + 1;
+  }
+  return worst;
+}
+
+// distinct buckets the low bits of a hash hit in a power of two table twice the vertex
+// count, per vertex. A perfectly random hash gets about 2 (1 - e^-0.5) = 79%.
+template <typename Hash>
+static double tableFill(size_t count, Hash hash) {
+  size_t size = 1;
+  while (size < count * 2) size *= 2;
+  std::unordered_set<size_t> used;
+  for (size_t i = 0; i < count; i++) used.insert(hash(i) & (size - 1));
+  return static_cast<double>(used.size()) / count;
+}
+
+/* ================================= Main ================================= */
+
+int main(int argc, char *argv[]) {
+  int runs = 5;
+  unsigned threads = 0;
+  std::vector<std::string> models;
+  for (int i = 1; i < argc; i++) {
+	std::string arg = argv[i];
+	if (arg == "--runs" && i + 1 < argc) runs = std::max(std::atoi(argv[++i]), 1);
+	else if (arg == "--threads" && i + 1 < argc) threads = static_cast<unsigned>(std::atoi(argv[++i]));
+	else models.push_back(arg);
+  }
+  if (models.empty()) models.assign(std::begin(DEFAULT_MODELS), std::end(DEFAULT_MODELS));
+
+  std::printf("%-44s %10s %10s %10s %8s %10s %12s\n", "model", "tinyobj", "obj 1T", "obj MT",
+			  "speedup", "max ulps", "fill old/new");
+
+  int failures = 0;
+  for (const std::string &model : models) {
+	AssetBytes file;
+	if (!readAssetBytes(model, file)) {
+	  std::printf("%s: not found\n", model.c_str());
+	  failures++;
+	  continue;
+	}
+
+	std::vector<LegacyVertex> legacyVertices;
+	std::vector<uint32_t> legacyIndices;
+	ObjMesh mesh;
+	double legacyBest = 1e30, singleBest = 1e30, multiBest = 1e30;
+	for (int run = 0; run < runs; run++) {
+	  auto start = BenchClock::now();
+	  loadLegacy(model.c_str(), legacyVertices, legacyIndices);
+	  auto legacyDone = BenchClock::now();
+	  loadObj(file.data, file.size, model.c_str(), mesh, 1);
+	  auto singleDone = BenchClock::now();
+	  loadObj(file.data, file.size, model.c_str(), mesh, threads);
+	  auto multiDone = BenchClock::now();
+
+	  legacyBest = std::min(legacyBest, std::chrono::duration<double, std::milli>(legacyDone - start).count());
+	  singleBest = std::min(singleBest, std::chrono::duration<double, std::milli>(singleDone - legacyDone).count());
+	  multiBest = std::min(multiBest, std::chrono::duration<double, std::milli>(multiDone - singleDone).count());
+	}
+
+	// tinyobj includes the file read, so time just the read for a fair comparison
+	auto readStart = BenchClock::now();
+	AssetBytes reread;
+	readAssetBytes(model, reread);
+	double readMs = std::chrono::duration<double, std::milli>(BenchClock::now() - readStart).count();
+
+	bool same = legacyVertices.size() == mesh.vertices.size() && legacyIndices == mesh.indices;
+	for (size_t i = 0; same && i < mesh.vertices.size(); i++) {
+	  same = std::equal(mesh.vertices[i].pos, mesh.vertices[i].pos + 3, legacyVertices[i].pos) &&
+		mesh.vertices[i].texCoord[0] == legacyVertices[i].texCoord[0] &&
+		1.0f - mesh.vertices[i].texCoord[1] == legacyVertices[i].texCoord[1];
+	}
+
+	size_t numbers;
+	int ulps = checkFloats(file, numbers);
+
+	double oldFill = tableFill(legacyVertices.size(), [&](size_t i) { return LegacyVertexHash()(legacyVertices[i]); });
+	double newFill = tableFill(mesh.vertices.size(), [&](size_t i) { return static_cast<size_t>(hashObjVertex(mesh.vertices[i])); });
+
+	std::printf("%-44s %8.2fms %8.2fms %8.2fms %7.1fx %10d %5.0f%%/%3.0f%%\n", model.c_str(), legacyBest,
+				singleBest + readMs, multiBest + readMs, legacyBest / (multiBest + readMs), ulps,
+				oldFill * 100.0, newFill * 100.0);
+	std::printf("%-44s %zu vertices, %zu triangles, %zu numbers checked%s\n", "", mesh.vertices.size(),
+				mesh.indices.size() / 3, numbers, same ? "" : ", MISMATCH against tinyobj");
+	if (!same || ulps > 1) failures++;
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,350 @@
+/*
+
+SDG                                                                                               JJ
+
+                                     Orc Horde
+
+								  Texture Cooker
+*/
+
+// Offline texture cooking: decodes a png, builds the full mip chain and writes it out
+// block compressed as foo.ktx2 next to foo.png, which Texture::load picks up if it's there.
+//
+//   texture_cooker [--bc1 | --bc7 | --rgba] textures...
+//
+// By default opaque textures get BC1 (8 bytes per 4x4 block) and anything with alpha
+// gets BC7 mode 6 (16 bytes per block). Both encoders are the simple "fit a line through
+// the block" kind, good enough for our flat colored art, not for photos.
+//
+// Before that we try a palette (see buildPaletteTexture). It's lossless, so we take it
+// whenever it's no bigger than the block format: single colors (1x1), 4 bit indices (same
+// size as BC1) and 8 bit indices for textures with alpha (same size as BC7).
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "vendor/stb_image.h"
+
+#include "texture_formats.hh"
+
+/* ============================== Block Helpers ============================== */
+
+struct Block {
+  float 	pixels[16][4]; // RGBA, 0-255
+};
+
+// pulls a 4x4 block out of an RGBA8 mip, clamping at the edges
+static Block loadBlock(const TextureMip &mip, uint32_t blockX, uint32_t blockY) {
+  Block block;
+  for (uint32_t y = 0; y < 4; y++) {
+	for (uint32_t x = 0; x < 4; x++) {
+	  uint32_t px = std::min(blockX * 4 + x, mip.width - 1);
+	  uint32_t py = std::min(blockY * 4 + y, mip.height - 1);
+	  const uint8_t *pixel = &mip.data[(static_cast<size_t>(py) * mip.width + px) * 4];
+	  for (int c = 0; c < 4; c++) block.pixels[y * 4 + x][c] = pixel[c];
+	}
+  }
+  return block;
+}
+
+// principal axis of the block colors (power iteration on the covariance), channels
+// past `channels` are ignored
+static void principalAxis(const Block &block, int channels, float mean[4], float axis[4]) {
+  for (int c = 0; c < 4; c++) mean[c] = 0.0f;
+  for (const auto &pixel : block.pixels) {
+	for (int c = 0; c < channels; c++) mean[c] += pixel[c] / 16.0f;
+  }
+
+  float covariance[4][4] = {};
+  for (const auto &pixel : block.pixels) {
+	for (int i = 0; i < channels; i++) {
+	  for (int j = 0; j < channels; j++) {
+		covariance[i][j] += (pixel[i] - mean[i]) * (pixel[j] - mean[j]);
+	  }
+	}
+  }
+
+  for (int c = 0; c < 4; c++) axis[c] = c < channels ? 1.0f : 0.0f;
+  for (int iteration = 0; iteration < 8; iteration++) {
+	float next[4] = {};
+	for (int i = 0; i < channels; i++) {
+	  for (int j = 0; j < channels; j++) next[i] += covariance[i][j] * axis[j];
+	}
+	float length = 0.0f;
+	for (int c = 0; c < channels; c++) length += next[c] * next[c];
+	length = std::sqrt(length);
+	if (length < 1e-6f) break; // flat block, any axis will do
+	for (int c = 0; c < channels; c++) axis[c] = next[c] / length;
+  }
+}
+
+// endpoints at the extremes of the block along the principal axis
+static void fitEndpoints(const Block &block, int channels, float e0[4], float e1[4]) {
+  float mean[4], axis[4];
+  principalAxis(block, channels, mean, axis);
+
+  float minT = 0.0f, maxT = 0.0f;
+  for (const auto &pixel : block.pixels) {
+	float t = 0.0f;
+	for (int c = 0; c < channels; c++) t += (pixel[c] - mean[c]) * axis[c];
+	minT = std::min(minT, t);
+	maxT = std::max(maxT, t);
+  }
+
+  for (int c = 0; c < 4; c++) {
+	e0[c] = std::clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+	e1[c] = std::clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+  }
+}
+
+static float distanceSquared(const float *a, const float *b, int channels) {
+  float sum = 0.0f;
+  for (int c = 0; c < channels; c++) sum += (a[c] - b[c]) * (a[c] - b[c]);
+  return sum;
+}
+
+/* ================================== BC1 ================================== */
+
+static uint16_t packRGB565(const float color[4]) {
+  auto r = static_cast<uint16_t>(std::lround(color[0] * 31.0f / 255.0f));
+  auto g = static_cast<uint16_t>(std::lround(color[1] * 63.0f / 255.0f));
+  auto b = static_cast<uint16_t>(std::lround(color[2] * 31.0f / 255.0f));
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(uint16_t packed, float color[4]) {
+  color[0] = ((packed >> 11) & 31) * 255.0f / 31.0f;
+  color[1] = ((packed >> 5) & 63) * 255.0f / 63.0f;
+  color[2] = (packed & 31) * 255.0f / 31.0f;
+  color[3] = 255.0f;
+}
+
+// opaque (four color) mode only, alpha is ignored
+static void encodeBC1Block(const Block &block, uint8_t out[8]) {
+  float e0[4], e1[4];
+  fitEndpoints(block, 3, e0, e1);
+
+  uint16_t c0 = packRGB565(e1), c1 = packRGB565(e0);
+  if (c0 < c1) std::swap(c0, c1);
+
+  uint32_t indices = 0;
+  if (c0 != c1) {
+	float palette[4][4];
+	unpackRGB565(c0, palette[0]);
+	unpackRGB565(c1, palette[1]);
+	for (int c = 0; c < 3; c++) {
+	  palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+	  palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+	}
+
+	for (int i = 0; i < 16; i++) {
+	  uint32_t best = 0;
+	  float bestError = distanceSquared(block.pixels[i], palette[0], 3);
+	  for (uint32_t p = 1; p < 4; p++) {
+		float error = distanceSquared(block.pixels[i], palette[p], 3);
+		if (error < bestError) { bestError = error; best = p; }
+	  }
+	  indices |= best << (i * 2);
+	}
+  }
+
+  out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+  out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+  std::memcpy(out + 4, &indices, 4);
+}
+
+/* ============================== BC7 (mode 6) ============================== */
+
+static const int BC7_WEIGHTS_4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct BitWriter {
+  uint8_t 	*bytes;
+  int 		position = 0;
+
+  void write(uint32_t value, int bits) {
+	for (int i = 0; i < bits; i++, position++) {
+	  if (value & (1u << i)) bytes[position / 8] |= static_cast<uint8_t>(1u << (position % 8));
+	}
+  }
+};
+
+// mode 6: one subset, RGBA endpoints as 7 bits + a shared low bit per endpoint, 4 bit indices
+static void encodeBC7Block(const Block &block, uint8_t out[16]) {
+  float e[2][4];
+  fitEndpoints(block, 4, e[0], e[1]);
+
+  // pick the p bit per endpoint that lands closest to the fitted color
+  uint32_t endpoint[2][4], pbit[2];
+  for (int side = 0; side < 2; side++) {
+	float bestError = 0.0f;
+	for (uint32_t p = 0; p < 2; p++) {
+	  uint32_t quantized[4];
+	  float error = 0.0f;
+	  for (int c = 0; c < 4; c++) {
+		quantized[c] = static_cast<uint32_t>(std::clamp(std::lround((e[side][c] - p) / 2.0f), 0l, 127l));
+		float value = static_cast<float>((quantized[c] << 1) | p);
+		error += (value - e[side][c]) * (value - e[side][c]);
+	  }
+	  if (p == 0 || error < bestError) {
+		bestError = error;
+		pbit[side] = p;
+		std::memcpy(endpoint[side], quantized, sizeof(quantized));
+	  }
+	}
+  }
+
+  float palette[16][4];
+  for (int i = 0; i < 16; i++) {
+	for (int c = 0; c < 4; c++) {
+	  int a = static_cast<int>((endpoint[0][c] << 1) | pbit[0]);
+	  int b = static_cast<int>((endpoint[1][c] << 1) | pbit[1]);
+	  palette[i][c] = static_cast<float>(((64 - BC7_WEIGHTS_4[i]) * a + BC7_WEIGHTS_4[i] * b + 32) >> 6);
+	}
+  }
+
+  uint32_t indices[16];
+  for (int i = 0; i < 16; i++) {
+	indices[i] = 0;
+	float bestError = distanceSquared(block.pixels[i], palette[0], 4);
+	for (uint32_t p = 1; p < 16; p++) {
+	  float error = distanceSquared(block.pixels[i], palette[p], 4);
+	  if (error < bestError) { bestError = error; indices[i] = p; }
+	}
+  }
+
+  // the first index only gets 3 bits, so its top bit has to be 0
+  if (indices[0] & 8) {
+	std::swap(endpoint[0], endpoint[1]);
+	std::swap(pbit[0], pbit[1]);
+	for (auto &index : indices) index = 15 - index;
+  }
+
+  std::memset(out, 0, 16);
+  BitWriter writer { out };
+  writer.write(1u << 6, 7); // mode 6
+  for (int c = 0; c < 4; c++) {
+	writer.write(endpoint[0][c], 7);
+	writer.write(endpoint[1][c], 7);
+  }
+  writer.write(pbit[0], 1);
+  writer.write(pbit[1], 1);
+  writer.write(indices[0], 3);
+  for (int i = 1; i < 16; i++) writer.write(indices[i], 4);
+}
+
+/* ================================ Cooking ================================ */
+
+static TextureMip compressMip(const TextureMip &mip, TextureFormat format) {
+  TextureMip compressed { .width = mip.width, .height = mip.height, .data = {} };
+  compressed.data.resize(textureMipBytes(format, mip.width, mip.height));
+
+  size_t blockBytes = format == TextureBC1 ? 8 : 16;
+  uint32_t blocksX = (mip.width + 3) / 4, blocksY = (mip.height + 3) / 4;
+  for (uint32_t by = 0; by < blocksY; by++) {
+	for (uint32_t bx = 0; bx < blocksX; bx++) {
+	  Block block = loadBlock(mip, bx, by);
+	  uint8_t *out = &compressed.data[(static_cast<size_t>(by) * blocksX + bx) * blockBytes];
+	  if (format == TextureBC1) encodeBC1Block(block, out);
+	  else encodeBC7Block(block, out);
+	}
+  }
+  return compressed;
+}
+
+static bool hasAlpha(const TextureMip &mip) {
+  for (size_t i = 3; i < mip.data.size(); i += 4) {
+	if (mip.data[i] != 255) return true;
+  }
+  return false;
+}
+
+static const char *formatName(TextureFormat format) {
+  switch (format) {
+  case TextureRGBA8:	return "RGBA8";
+  case TextureBC1:		return "BC1";
+  case TextureBC7:		return "BC7";
+  case TexturePalette4:	return "palette4";
+  case TexturePalette8:	return "palette8";
+  }
+  return "?";
+}
+
+// 0 means pick per texture
+static int cook(const std::string &path, TextureFormat forcedFormat) {
+  auto start = std::chrono::high_resolution_clock::now();
+
+  int width, height, channels;
+  stbi_uc *pixels = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+  if (!pixels) {
+	std::printf("failed to load %s: %s\n", path.c_str(), stbi_failure_reason());
+	return 1;
+  }
+  std::vector<TextureMip> mips = buildMipChain(pixels, width, height);
+  bool alpha = hasAlpha(mips[0]);
+
+  size_t rgbaBytes = 0;
+  for (auto &mip : mips) rgbaBytes += mip.data.size();
+
+  TextureFormat format = forcedFormat;
+  std::vector<uint8_t> palette;
+  if (format == 0) {
+	TextureFormat paletteFormat;
+	std::vector<TextureMip> paletteMips;
+	if (buildPaletteTexture(pixels, width, height, true, paletteFormat, paletteMips, palette) &&
+		(paletteFormat != TexturePalette8 || alpha)) {
+	  format = paletteFormat;
+	  mips = std::move(paletteMips);
+	} else {
+	  palette.clear();
+	  format = alpha ? TextureBC7 : TextureBC1;
+	}
+  }
+  stbi_image_free(pixels);
+
+  size_t cookedBytes = palette.size();
+  for (auto &mip : mips) {
+	if (format == TextureBC1 || format == TextureBC7) mip = compressMip(mip, format);
+	cookedBytes += mip.data.size();
+  }
+
+  std::string cookedPath = cookedTexturePath(path);
+  writeKTX2(cookedPath, format, mips, palette);
+
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+  std::printf("%s -> %s: %dx%d %s, %zu mips, %zu palette colors, %zu bytes (%zu as RGBA8), %.0f ms\n",
+			  path.c_str(), cookedPath.c_str(), width, height, formatName(format),
+			  mips.size(), palette.size() / 4, cookedBytes, rgbaBytes, elapsed.count());
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  TextureFormat forcedFormat = static_cast<TextureFormat>(0);
+  int failures = 0;
+  int cooked = 0;
+
+  for (int i = 1; i < argc; i++) {
+	std::string arg = argv[i];
+	if (arg == "--bc1") {
+	  forcedFormat = TextureBC1;
+	} else if (arg == "--bc7") {
+	  forcedFormat = TextureBC7;
+	} else if (arg == "--rgba") {
+	  forcedFormat = TextureRGBA8;
+	} else {
+	  failures += cook(arg, forcedFormat);
+	  cooked++;
+	}
+  }
+
+  if (cooked == 0) {
+	std::printf("usage: %s [--bc1 | --bc7 | --rgba] textures...\n", argv[0]);
+	return 1;
+  }
+  return failures == 0 ? 0 : 1;
+}